@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/logging/log.h>
+
+#if defined(CONFIG_ARCH_POSIX)
+#include <nsi_main.h>
+#endif
+
+#include "../../../src/datatypes/datatypes.h"
+#include "../../../src/datatypes/json_writer.h"
+#include "../../../src/mqtt/mqtt_connection.h"
+
+/* Sweep: every payload size (up to CONFIG_BENCH_PAYLOAD_MAX) x QoS x burst length.
+ * A burst is sent back to back, then the PUBACKs are collected before the next one.
+ */
+static const uint16_t payload_sizes[] = {16, 64, 256, 1024};
+static const enum mqtt_qos qos_levels[] = {MQTT_QOS_0_AT_MOST_ONCE, MQTT_QOS_1_AT_LEAST_ONCE};
+static const uint8_t burst_lengths[] = {1, 10, 50};
+
+#define BURST_MAX 50
+#define LATENCY_SAMPLES (CONFIG_BENCH_ROUNDS * BURST_MAX)
+
+/* The client logs every publish on INF, keep that out of the measurement */
+LOG_MODULE_REGISTER(nrf9160_mqtt_gnss, LOG_LEVEL_WRN);
+
+/* mqtt_connection.c stores LED commands here, like on target */
+device_shadow_t g_device_state;
+
+static app_mqtt_client_t client;
+static struct pollfd fds;
+
+static uint8_t payload[CONFIG_BENCH_PAYLOAD_MAX];
+static uint32_t latencies_us[LATENCY_SAMPLES];
+static size_t latency_count;
+
+/* Publishes of the current burst not acked yet. An ack for anything else came in after
+ * its burst timed out and is not counted.
+ */
+static struct
+{
+	uint16_t message_id;
+	uint32_t sent_at;
+} in_flight[BURST_MAX];
+static size_t in_flight_count;
+static uint32_t acked;
+
+static void puback_handler(uint16_t message_id)
+{
+	for (size_t i = 0; i < in_flight_count; i++)
+	{
+		if (in_flight[i].message_id != message_id)
+		{
+			continue;
+		}
+		if (latency_count < ARRAY_SIZE(latencies_us))
+		{
+			latencies_us[latency_count++] = k_cyc_to_us_floor32(k_cycle_get_32() - in_flight[i].sent_at);
+		}
+		in_flight[i] = in_flight[--in_flight_count];
+		acked++;
+		return;
+	}
+}
+
+/* Process whatever arrives within timeout_ms */
+static int service(int timeout_ms)
+{
+	int keepalive_left = client_keepalive_time_left(&client);
+	int err;
+
+	err = poll(&fds, 1, keepalive_left < 0 ? timeout_ms : MIN(timeout_ms, keepalive_left));
+	if (err < 0)
+	{
+		return -errno;
+	}
+
+	if ((fds.revents & POLLIN) == POLLIN)
+	{
+		err = client_input(&client);
+		if (err)
+		{
+			return err;
+		}
+	}
+	if ((fds.revents & (POLLERR | POLLNVAL)) != 0)
+	{
+		return -EIO;
+	}
+
+	err = client_live(&client);
+	return (err == -EAGAIN) ? 0 : err;
+}
+
+static int u32_cmp(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static uint32_t percentile(size_t p)
+{
+	if (latency_count == 0)
+	{
+		return 0;
+	}
+	return latencies_us[MIN(latency_count * p / 100, latency_count - 1)];
+}
+
+static int run_point(size_t size, enum mqtt_qos qos, size_t burst)
+{
+	const struct mqtt_transport_stats *stats = mqtt_transport_stats_get();
+	uint32_t start;
+	uint32_t elapsed_us;
+	char json[256];
+	struct json_writer w;
+	int err;
+
+	latency_count = 0;
+	acked = 0;
+	mqtt_transport_stats_peak_reset();
+	start = k_cycle_get_32();
+
+	for (int round = 0; round < CONFIG_BENCH_ROUNDS; round++)
+	{
+		/* What is still in flight from the last burst timed out */
+		in_flight_count = 0;
+		for (size_t i = 0; i < burst; i++)
+		{
+			uint32_t now = k_cycle_get_32();
+
+			err = data_publish(&client, qos, payload, size);
+			if (err)
+			{
+				return err;
+			}
+			in_flight[in_flight_count].message_id = data_publish_last_id();
+			in_flight[in_flight_count++].sent_at = now;
+		}
+
+		/* MQTT-SN does not report PUBACKs, only throughput is measured there */
+		if (qos == MQTT_QOS_0_AT_MOST_ONCE || !DATA_PUBLISH_PUBACK)
+		{
+			continue;
+		}
+
+		int64_t deadline = k_uptime_get() + CONFIG_BENCH_ACK_TIMEOUT_MS;
+		while (in_flight_count > 0 && k_uptime_get() < deadline)
+		{
+			err = service(deadline - k_uptime_get());
+			if (err)
+			{
+				return err;
+			}
+		}
+	}
+
+	elapsed_us = k_cyc_to_us_floor32(k_cycle_get_32() - start);
+	qsort(latencies_us, latency_count, sizeof(latencies_us[0]), u32_cmp);
+
+	json_writer_init(&w, json, sizeof(json));
+	json_add_int(&w, "payload", size);
+	json_add_int(&w, "qos", qos);
+	json_add_int(&w, "burst", burst);
+	json_add_int(&w, "msgs", CONFIG_BENCH_ROUNDS * burst);
+	json_add_fixed(&w, "msg_per_s", (int32_t)((uint64_t)CONFIG_BENCH_ROUNDS * burst * 10 * USEC_PER_SEC / MAX(elapsed_us, 1)), 1);
+	json_add_int(&w, "acked", acked);
+	json_add_int(&w, "p50_us", percentile(50));
+	json_add_int(&w, "p99_us", percentile(99));
+	json_add_int(&w, "tx_buf_peak", stats->tx_buf_peak);
+	json_add_int(&w, "rx_buf_peak", stats->rx_buf_peak);
+	json_add_int(&w, "buf_size", CONFIG_MQTT_MESSAGE_BUFFER_SIZE);
+	if (json_writer_finish(&w) < 0)
+	{
+		return -ENOMEM;
+	}
+
+	/* One line per point, grep for BENCH to collect the results */
+	printk("BENCH %s\n", json);
+	return 0;
+}
+
+int main(void)
+{
+	int err;
+
+	memset(payload, 'x', sizeof(payload));
+	data_publish_puback_cb_set(puback_handler);
+
+	err = client_init(&client);
+	if (err)
+	{
+		LOG_ERR("Failed to initialize MQTT client: %d", err);
+		goto out;
+	}
+
+	err = client_connect(&client);
+	if (err)
+	{
+		LOG_ERR("Failed to connect to %s: %d", CONFIG_MQTT_BROKER_HOSTNAME, err);
+		goto out;
+	}
+
+	err = fds_init(&client, &fds);
+	if (err)
+	{
+		goto out;
+	}
+
+	while (mqtt_transport_stats_get()->connects_uncached + mqtt_transport_stats_get()->connects_after_cache == 0)
+	{
+		err = service(CONFIG_BENCH_ACK_TIMEOUT_MS);
+		if (err)
+		{
+			LOG_ERR("No CONNACK: %d", err);
+			goto out;
+		}
+	}
+
+	for (size_t s = 0; s < ARRAY_SIZE(payload_sizes) && payload_sizes[s] <= sizeof(payload); s++)
+	{
+		for (size_t q = 0; q < ARRAY_SIZE(qos_levels); q++)
+		{
+			for (size_t b = 0; b < ARRAY_SIZE(burst_lengths); b++)
+			{
+				err = run_point(payload_sizes[s], qos_levels[q], burst_lengths[b]);
+				if (err)
+				{
+					LOG_ERR("Benchmark stopped: %d", err);
+					goto out;
+				}
+			}
+		}
+	}
+
+	client_disconnect(&client);
+
+out:
+#if defined(CONFIG_ARCH_POSIX)
+	nsi_exit(err ? 1 : 0);
+#endif
+	return 0;
+}
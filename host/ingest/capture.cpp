@@ -0,0 +1,150 @@
+#include "capture.h"
+
+namespace ingest
+{
+
+namespace
+{
+
+void put_le(FILE *file, uint32_t value, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+    {
+        fputc((value >> (8 * i)) & 0xff, file);
+    }
+}
+
+uint32_t get_le(const uint8_t *p, int bytes)
+{
+    uint32_t value = 0;
+
+    for (int i = bytes - 1; i >= 0; i--)
+    {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+} // namespace
+
+bool CaptureWriter::open(const std::string &path)
+{
+    close();
+    file = fopen(path.c_str(), "wb");
+    return file != nullptr;
+}
+
+bool CaptureWriter::write(std::string_view topic, const uint8_t *data, size_t len)
+{
+    if (file == nullptr || topic.size() > UINT16_MAX || len > UINT32_MAX)
+    {
+        return false;
+    }
+    put_le(file, topic.size(), 2);
+    fwrite(topic.data(), 1, topic.size(), file);
+    put_le(file, len, 4);
+    fwrite(data, 1, len, file);
+
+    /* Keep a capture usable when the subscriber is interrupted */
+    return fflush(file) == 0;
+}
+
+void CaptureWriter::close()
+{
+    if (file != nullptr)
+    {
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+bool capture_load(const std::string &path, std::vector<uint8_t> &out)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    uint8_t chunk[16384];
+    size_t n;
+
+    if (file == nullptr)
+    {
+        return false;
+    }
+    out.clear();
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0)
+    {
+        out.insert(out.end(), chunk, chunk + n);
+    }
+
+    bool ok = !ferror(file);
+
+    fclose(file);
+    return ok;
+}
+
+long capture_for_each(const std::vector<uint8_t> &capture, const PayloadHandler &handler)
+{
+    const uint8_t *p = capture.data();
+    const uint8_t *end = p + capture.size();
+    long records = 0;
+
+    while (p < end)
+    {
+        if (end - p < 2)
+        {
+            return -1;
+        }
+        size_t topic_len = get_le(p, 2);
+
+        p += 2;
+        if (static_cast<size_t>(end - p) < topic_len + 4)
+        {
+            return -1;
+        }
+        std::string_view topic(reinterpret_cast<const char *>(p), topic_len);
+        size_t len = get_le(p + topic_len, 4);
+
+        p += topic_len + 4;
+        if (static_cast<size_t>(end - p) < len)
+        {
+            return -1;
+        }
+        handler(topic, p, len);
+        p += len;
+        records++;
+    }
+    return records;
+}
+
+long capture_lines_for_each(const std::vector<uint8_t> &capture, bool with_topic, const PayloadHandler &handler)
+{
+    std::string_view text(reinterpret_cast<const char *>(capture.data()), capture.size());
+    long records = 0;
+
+    while (!text.empty())
+    {
+        size_t eol = text.find('\n');
+        std::string_view line = text.substr(0, eol);
+        std::string_view topic;
+
+        text.remove_prefix(eol == std::string_view::npos ? text.size() : eol + 1);
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.remove_suffix(1);
+        }
+        if (with_topic)
+        {
+            size_t space = line.find(' ');
+
+            topic = line.substr(0, space);
+            line.remove_prefix(space == std::string_view::npos ? line.size() : space + 1);
+        }
+        if (line.empty())
+        {
+            continue;
+        }
+        handler(topic, reinterpret_cast<const uint8_t *>(line.data()), line.size());
+        records++;
+    }
+    return records;
+}
+
+} // namespace ingest
@@ -0,0 +1,53 @@
+#ifndef _CAPTURE_H_
+#define _CAPTURE_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* Captured payloads, one record per PUBLISH, all little endian:
+ *   u16 topic length, topic, u32 payload length, payload
+ * Written by `ingest subscribe --record`, binary safe so GNSS summaries survive.
+ * Text captures (`mosquitto_sub -v` or one payload per line) are read with `--lines`.
+ */
+
+namespace ingest
+{
+
+using PayloadHandler = std::function<void(std::string_view topic, const uint8_t *data, size_t len)>;
+
+class CaptureWriter
+{
+public:
+    /**@brief Open path for writing, truncating it.
+     * @return false if it cannot be opened.
+     */
+    bool open(const std::string &path);
+    bool write(std::string_view topic, const uint8_t *data, size_t len);
+    void close();
+    ~CaptureWriter() { close(); }
+
+private:
+    FILE *file = nullptr;
+};
+
+/**@brief Read a whole capture into memory, so decode benchmarks do not time file IO.
+ * @return false if the file cannot be read or a record is truncated.
+ */
+bool capture_load(const std::string &path, std::vector<uint8_t> &out);
+
+/**@brief Call handler for every record of a capture loaded by capture_load().
+ * @return number of records, or -1 if a record is truncated.
+ */
+long capture_for_each(const std::vector<uint8_t> &capture, const PayloadHandler &handler);
+
+/**@brief Same for a text capture: "topic payload" per line with `-v`, else the payload alone.
+ */
+long capture_lines_for_each(const std::vector<uint8_t> &capture, bool with_topic, const PayloadHandler &handler);
+
+} // namespace ingest
+
+#endif /* _CAPTURE_H_ */
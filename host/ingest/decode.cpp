@@ -0,0 +1,525 @@
+#include <algorithm>
+#include <cstring>
+
+#include "ingest.h"
+
+namespace ingest
+{
+
+namespace
+{
+
+#define SHADOW_FIELD_KEY(name, key, decimals) std::string_view(key),
+constexpr std::string_view field_keys[] = {DEVICE_SHADOW_FIELDS(SHADOW_FIELD_KEY)};
+#undef SHADOW_FIELD_KEY
+
+#define SHADOW_FIELD_DECIMALS(name, key, decimals) decimals,
+constexpr uint8_t field_decimals[] = {DEVICE_SHADOW_FIELDS(SHADOW_FIELD_DECIMALS)};
+#undef SHADOW_FIELD_DECIMALS
+
+#define GNSS_STATS_HEADER_BITS(name, bits) bits,
+constexpr uint8_t header_bits[] = {GNSS_STATS_HEADER_FIELDS(GNSS_STATS_HEADER_BITS)};
+#undef GNSS_STATS_HEADER_BITS
+
+#define TRIP_FIELD_SIZE(name, bytes, is_signed) bytes,
+constexpr uint8_t trip_field_bytes[] = {TRIP_SUMMARY_FIELDS(TRIP_FIELD_SIZE)};
+#undef TRIP_FIELD_SIZE
+
+#define TRIP_FIELD_SIGNED(name, bytes, is_signed) is_signed,
+constexpr bool trip_field_signed[] = {TRIP_SUMMARY_FIELDS(TRIP_FIELD_SIGNED)};
+#undef TRIP_FIELD_SIGNED
+
+/* Keys of the first firmware's {"9160": [...]} report, in the order it wrote them */
+struct LegacyKey
+{
+    std::string_view key;
+    shadow_field field;
+};
+
+constexpr LegacyKey legacy_keys[] = {
+    {"lat", SHADOW_FIELD_LAT},
+    {"long", SHADOW_FIELD_LON},
+    {"alt", SHADOW_FIELD_ALT},
+    {"battery", SHADOW_FIELD_BAT},
+    {"led", SHADOW_FIELD_LED},
+    {"temp", SHADOW_FIELD_TEMP},
+    {"pres", SHADOW_FIELD_PRES},
+    {"humid", SHADOW_FIELD_HUM},
+    {"gas", SHADOW_FIELD_GAS},
+};
+
+constexpr int32_t pow10[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
+
+static_assert(sizeof(field_keys) / sizeof(field_keys[0]) == SHADOW_FIELD_COUNT);
+static_assert(SHADOW_FIELD_COUNT <= 32, "present mask is 32 bits");
+static_assert(GNSS_STATS_SUMMARY_BITS <= GNSS_STATS_SUMMARY_LEN * 8, "GNSS summary layout does not fit its length");
+
+/* Cursor over a json text, every step fails by returning false */
+class Reader
+{
+public:
+    explicit Reader(std::string_view text) : s(text) {}
+
+    void skip_ws()
+    {
+        while (pos < s.size() && (s[pos] == ' ' || s[pos] == '\t' || s[pos] == '\n' || s[pos] == '\r'))
+        {
+            pos++;
+        }
+    }
+
+    bool peek(char c)
+    {
+        skip_ws();
+        return pos < s.size() && s[pos] == c;
+    }
+
+    bool expect(char c)
+    {
+        if (!peek(c))
+        {
+            return false;
+        }
+        pos++;
+        return true;
+    }
+
+    /* A string without escapes, which is all the devices write */
+    bool string(std::string_view &out)
+    {
+        if (!expect('"'))
+        {
+            return false;
+        }
+        size_t end = s.find('"', pos);
+
+        if (end == std::string_view::npos || s.substr(pos, end - pos).find('\\') != std::string_view::npos)
+        {
+            return false;
+        }
+        out = s.substr(pos, end - pos);
+        pos = end + 1;
+        return true;
+    }
+
+    /* A bare number, straight to fixed point with `decimals` digits, rounded half away from zero */
+    bool fixed(int32_t &out, uint8_t decimals)
+    {
+        skip_ws();
+        size_t start = pos;
+
+        while (pos < s.size() && (s[pos] == '-' || s[pos] == '.' || (s[pos] >= '0' && s[pos] <= '9')))
+        {
+            pos++;
+        }
+        return parse_fixed(s.substr(start, pos - start), decimals, out);
+    }
+
+    bool at_end()
+    {
+        skip_ws();
+        return pos == s.size();
+    }
+
+    static bool parse_fixed(std::string_view text, uint8_t decimals, int32_t &out)
+    {
+        bool negative = false;
+        bool digits = false;
+        int64_t value = 0;
+        size_t i = 0;
+
+        if (i < text.size() && text[i] == '-')
+        {
+            negative = true;
+            i++;
+        }
+        for (; i < text.size() && text[i] >= '0' && text[i] <= '9'; i++)
+        {
+            value = value * 10 + (text[i] - '0');
+            digits = true;
+            if (value > INT32_MAX)
+            {
+                return false;
+            }
+        }
+
+        uint8_t fraction = 0;
+        bool round_up = false;
+
+        if (i < text.size() && text[i] == '.')
+        {
+            for (i++; i < text.size() && text[i] >= '0' && text[i] <= '9'; i++)
+            {
+                if (fraction < decimals)
+                {
+                    value = value * 10 + (text[i] - '0');
+                    fraction++;
+                }
+                else if (fraction == decimals)
+                {
+                    round_up = text[i] >= '5';
+                    fraction++; // later digits do not matter
+                }
+                digits = true;
+            }
+        }
+        if (!digits || i != text.size())
+        {
+            return false;
+        }
+
+        value = value * pow10[decimals - std::min(fraction, decimals)] + (round_up ? 1 : 0);
+        if (value > INT32_MAX)
+        {
+            return false;
+        }
+        out = static_cast<int32_t>(negative ? -value : value);
+        return true;
+    }
+
+private:
+    std::string_view s;
+    size_t pos = 0;
+};
+
+int field_index(std::string_view key)
+{
+    for (int i = 0; i < SHADOW_FIELD_COUNT; i++)
+    {
+        if (field_keys[i] == key)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void shadow_row_append(ShadowBatch &batch, const int32_t (&values)[SHADOW_FIELD_COUNT], uint32_t present, Encoding encoding)
+{
+    for (int i = 0; i < SHADOW_FIELD_COUNT; i++)
+    {
+        batch.values[i].push_back(values[i]);
+    }
+    batch.present.push_back(present);
+    batch.encoding.push_back(encoding);
+}
+
+/* Legacy values come as 37.77, "-122.42", "80 %", "on" or "21 C" */
+bool legacy_value(Reader &r, shadow_field field, int32_t &out)
+{
+    std::string_view text;
+
+    if (!r.peek('"'))
+    {
+        return r.fixed(out, field_decimals[field]);
+    }
+    if (!r.string(text))
+    {
+        return false;
+    }
+    if (field == SHADOW_FIELD_LED)
+    {
+        out = text == "on" ? 1 : 0;
+        return text == "on" || text == "off";
+    }
+
+    size_t unit = text.find(' ');
+
+    return Reader::parse_fixed(text.substr(0, unit), field_decimals[field], out);
+}
+
+/* MSB first, mirror of bits_put() in gnss_stats.c */
+class BitReader
+{
+public:
+    explicit BitReader(const uint8_t *data) : buf(data) {}
+
+    uint32_t get(uint8_t width)
+    {
+        uint32_t value = 0;
+
+        for (uint8_t i = 0; i < width; i++, pos++)
+        {
+            value = (value << 1) | ((buf[pos / 8] >> (7 - pos % 8)) & 1);
+        }
+        return value;
+    }
+
+private:
+    const uint8_t *buf;
+    size_t pos = 0;
+};
+
+} // namespace
+
+const char *encoding_name(Encoding encoding)
+{
+    switch (encoding)
+    {
+    case Encoding::shadow_json:
+        return "shadow_json";
+    case Encoding::legacy_json:
+        return "legacy_json";
+    case Encoding::gnss_stats:
+        return "gnss_stats";
+    case Encoding::trip:
+        return "trip";
+    default:
+        return "unknown";
+    }
+}
+
+Encoding detect(const uint8_t *data, size_t len)
+{
+    std::string_view text(reinterpret_cast<const char *>(data), len);
+    size_t start = text.find_first_not_of(" \t\r\n");
+
+    if (len == GNSS_STATS_SUMMARY_LEN && (data[0] >> 4) == GNSS_STATS_VERSION)
+    {
+        return Encoding::gnss_stats;
+    }
+    if (len == TRIP_SUMMARY_LEN && data[0] == TRIP_SUMMARY_VERSION)
+    {
+        return Encoding::trip;
+    }
+    if (start == std::string_view::npos || text[start] != '{')
+    {
+        return Encoding::unknown;
+    }
+    size_t key = text.find_first_not_of(" \t\r\n", start + 1);
+
+    if (key != std::string_view::npos && text.compare(key, 6, "\"9160\"") == 0)
+    {
+        return Encoding::legacy_json;
+    }
+    return Encoding::shadow_json;
+}
+
+void ShadowBatch::clear()
+{
+    for (auto &column : values)
+    {
+        column.clear();
+    }
+    present.clear();
+    encoding.clear();
+}
+
+void ShadowBatch::reserve(size_t rows)
+{
+    for (auto &column : values)
+    {
+        column.reserve(rows);
+    }
+    present.reserve(rows);
+    encoding.reserve(rows);
+}
+
+void GnssStatsBatch::clear()
+{
+    for (auto &column : header)
+    {
+        column.clear();
+    }
+    for (int c = 0; c < GNSS_STATS_CONSTELLATIONS; c++)
+    {
+        observations[c].clear();
+        for (auto &column : cn0_share[c])
+        {
+            column.clear();
+        }
+    }
+    for (auto &column : ttf)
+    {
+        column.clear();
+    }
+}
+
+void TripBatch::clear()
+{
+    for (auto &column : values)
+    {
+        column.clear();
+    }
+}
+
+bool decode_shadow_json(std::string_view json, ShadowBatch &batch)
+{
+    Reader r(json);
+    int32_t values[SHADOW_FIELD_COUNT] = {};
+    uint32_t present = 0;
+
+    if (!r.expect('{'))
+    {
+        return false;
+    }
+    if (!r.expect('}'))
+    {
+        do
+        {
+            std::string_view key;
+            int field;
+
+            if (!r.string(key) || !r.expect(':') || (field = field_index(key)) < 0 || (present & (1u << field)) ||
+                !r.fixed(values[field], field_decimals[field]))
+            {
+                return false;
+            }
+            present |= 1u << field;
+        } while (r.expect(','));
+
+        if (!r.expect('}'))
+        {
+            return false;
+        }
+    }
+    if (!r.at_end())
+    {
+        return false;
+    }
+
+    shadow_row_append(batch, values, present, Encoding::shadow_json);
+    return true;
+}
+
+bool decode_legacy_json(std::string_view json, ShadowBatch &batch)
+{
+    Reader r(json);
+    std::string_view key;
+    int32_t values[SHADOW_FIELD_COUNT] = {};
+    uint32_t present = 0;
+
+    if (!r.expect('{') || !r.string(key) || key != "9160" || !r.expect(':') || !r.expect('['))
+    {
+        return false;
+    }
+    do
+    {
+        const LegacyKey *legacy = nullptr;
+
+        if (!r.expect('{') || !r.string(key) || !r.expect(':'))
+        {
+            return false;
+        }
+        for (const auto &candidate : legacy_keys)
+        {
+            if (candidate.key == key)
+            {
+                legacy = &candidate;
+            }
+        }
+        if (legacy == nullptr || !legacy_value(r, legacy->field, values[legacy->field]) || !r.expect('}'))
+        {
+            return false;
+        }
+        present |= 1u << legacy->field;
+    } while (r.expect(','));
+
+    if (!r.expect(']') || !r.expect('}') || !r.at_end())
+    {
+        return false;
+    }
+
+    shadow_row_append(batch, values, present, Encoding::legacy_json);
+    return true;
+}
+
+bool decode_gnss_stats(const uint8_t *data, size_t len, GnssStatsBatch &batch)
+{
+    if (len != GNSS_STATS_SUMMARY_LEN || (data[0] >> 4) != GNSS_STATS_VERSION)
+    {
+        return false;
+    }
+
+    BitReader bits(data);
+
+    for (int i = 0; i < GNSS_STATS_HDR_COUNT; i++)
+    {
+        batch.header[i].push_back(bits.get(header_bits[i]));
+    }
+    for (int c = 0; c < GNSS_STATS_CONSTELLATIONS; c++)
+    {
+        batch.observations[c].push_back(bits.get(GNSS_STATS_OBSERVATIONS_BITS));
+        for (auto &column : batch.cn0_share[c])
+        {
+            column.push_back(static_cast<uint8_t>(bits.get(GNSS_STATS_CN0_BITS)));
+        }
+    }
+    for (auto &column : batch.ttf)
+    {
+        column.push_back(static_cast<uint8_t>(bits.get(GNSS_STATS_TTF_BITS)));
+    }
+    return true;
+}
+
+/* Little endian, mirror of trip_summary_encode() */
+bool decode_trip(const uint8_t *data, size_t len, TripBatch &batch)
+{
+    if (len != TRIP_SUMMARY_LEN || data[0] != TRIP_SUMMARY_VERSION)
+    {
+        return false;
+    }
+
+    for (int i = 0; i < TRIP_FIELD_COUNT; i++)
+    {
+        uint8_t bytes = trip_field_bytes[i];
+        uint64_t value = 0;
+
+        for (uint8_t b = 0; b < bytes; b++)
+        {
+            value |= static_cast<uint64_t>(*data++) << (8 * b);
+        }
+        if (trip_field_signed[i] && (value >> (8 * bytes - 1)) != 0)
+        {
+            value |= ~0ull << (8 * bytes);
+        }
+        batch.values[i].push_back(static_cast<int64_t>(value));
+    }
+    return true;
+}
+
+Encoding Decoder::add(const uint8_t *data, size_t len)
+{
+    std::string_view text(reinterpret_cast<const char *>(data), len);
+    Encoding encoding = detect(data, len);
+    bool ok = false;
+
+    switch (encoding)
+    {
+    case Encoding::shadow_json:
+        ok = decode_shadow_json(text, shadows);
+        break;
+    case Encoding::legacy_json:
+        ok = decode_legacy_json(text, shadows);
+        break;
+    case Encoding::gnss_stats:
+        ok = decode_gnss_stats(data, len, gnss_stats);
+        break;
+    case Encoding::trip:
+        ok = decode_trip(data, len, trips);
+        break;
+    default:
+        break;
+    }
+
+    if (!ok)
+    {
+        rejected += encoding != Encoding::unknown;
+        encoding = Encoding::unknown;
+    }
+    payloads[static_cast<size_t>(encoding)]++;
+    bytes[static_cast<size_t>(encoding)] += len;
+    return encoding;
+}
+
+void Decoder::clear()
+{
+    shadows.clear();
+    gnss_stats.clear();
+    trips.clear();
+    payloads.fill(0);
+    bytes.fill(0);
+    rejected = 0;
+}
+
+} // namespace ingest
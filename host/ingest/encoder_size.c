@@ -0,0 +1,42 @@
+#include <stdint.h>
+
+#include "json_writer.h"
+#include "legacy_json.h"
+#include "shadow_schema.h"
+
+/* Smallest program around one shadow encoder, linked for the nRF9160's Cortex-M33 by the
+ * encoder_size target. ENCODER_LEGACY picks the old snprintf report, ENCODER_WRITER the
+ * json writer loop of shadow_fields_to_json(), neither gives the size of the program itself.
+ */
+
+volatile int32_t values[SHADOW_FIELD_COUNT];
+char json[DEVICE_JSON_MAX_LEN];
+
+int main(void)
+{
+#if defined(ENCODER_LEGACY)
+    legacy_device_shadow_t device = {
+        .latitude = values[SHADOW_FIELD_LAT] / 1e6,
+        .longitude = values[SHADOW_FIELD_LON] / 1e6,
+        .altitude = values[SHADOW_FIELD_ALT] / 1e1,
+        .batt_voltage = values[SHADOW_FIELD_BAT],
+        .led1_state = values[SHADOW_FIELD_LED],
+        .temperature = values[SHADOW_FIELD_TEMP],
+        .pressure = values[SHADOW_FIELD_PRES],
+        .relative_humidity = values[SHADOW_FIELD_HUM],
+        .gas_res = values[SHADOW_FIELD_GAS],
+    };
+
+    return legacy_device_to_json(json, sizeof(json), device);
+#elif defined(ENCODER_WRITER)
+#define SHADOW_FIELD_ADD(name, key, decimals) json_add_fixed(&w, key, values[SHADOW_FIELD_##name], decimals);
+    struct json_writer w;
+
+    json_writer_init(&w, json, sizeof(json));
+    DEVICE_SHADOW_FIELDS(SHADOW_FIELD_ADD)
+    return json_writer_finish(&w);
+#undef SHADOW_FIELD_ADD
+#else
+    return values[0];
+#endif
+}
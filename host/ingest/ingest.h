@@ -0,0 +1,103 @@
+#ifndef _INGEST_H_
+#define _INGEST_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "shadow_schema.h"
+#include "gnss_stats_schema.h"
+#include "trip_schema.h"
+
+/* Decoding of everything the devices publish into columnar batches.
+ * The layouts come from the firmware headers (shadow_schema.h, gnss_stats_schema.h,
+ * trip_schema.h),
+ * so a schema change on the device is a compile-time change here.
+ */
+
+namespace ingest
+{
+
+enum class Encoding : uint8_t
+{
+    unknown,
+    shadow_json, // flat object from device_to_json()/shadow_report_build(), full or delta
+    legacy_json, // {"9160": [{"lat": ..}, {"long": ".."}, ..]} of the first firmware
+    gnss_stats,  // binary summary from gnss_stats_summary_build()
+    trip,        // binary summary from trip_summary_encode()
+    count
+};
+
+const char *encoding_name(Encoding encoding);
+
+/**@brief Guess the encoding of a payload from its first bytes and length.
+ */
+Encoding detect(const uint8_t *data, size_t len);
+
+/* One row per shadow report. Values are the fixed-point integers of shadow_schema.h,
+ * 0 where the report did not carry the field (delta reports).
+ */
+struct ShadowBatch
+{
+    std::array<std::vector<int32_t>, SHADOW_FIELD_COUNT> values;
+    std::vector<uint32_t> present; // bit n = enum shadow_field n
+    std::vector<Encoding> encoding;
+
+    size_t size() const { return present.size(); }
+    void clear();
+    void reserve(size_t rows);
+};
+
+/* One row per GNSS signal quality summary */
+struct GnssStatsBatch
+{
+    std::array<std::vector<uint32_t>, GNSS_STATS_HDR_COUNT> header;
+    std::array<std::vector<uint32_t>, GNSS_STATS_CONSTELLATIONS> observations;
+    std::array<std::array<std::vector<uint8_t>, GNSS_STATS_CN0_BINS>, GNSS_STATS_CONSTELLATIONS> cn0_share;
+    std::array<std::vector<uint8_t>, GNSS_STATS_TTF_BINS> ttf;
+
+    size_t size() const { return header[0].size(); }
+    void clear();
+};
+
+/* One row per trip summary, values as in trip_schema.h */
+struct TripBatch
+{
+    std::array<std::vector<int64_t>, TRIP_FIELD_COUNT> values;
+
+    size_t size() const { return values[0].size(); }
+    void clear();
+};
+
+/**@brief Append one payload of the given encoding. On failure nothing is appended.
+ * @return false if the payload is malformed or carries a key the schema does not know.
+ */
+bool decode_shadow_json(std::string_view json, ShadowBatch &batch);
+bool decode_legacy_json(std::string_view json, ShadowBatch &batch);
+bool decode_gnss_stats(const uint8_t *data, size_t len, GnssStatsBatch &batch);
+bool decode_trip(const uint8_t *data, size_t len, TripBatch &batch);
+
+/* Decodes whatever comes in into the batches and counts per encoding */
+class Decoder
+{
+public:
+    /**@brief Detect the encoding and decode.
+     * @return the encoding, Encoding::unknown if it was not recognized or failed to decode.
+     */
+    Encoding add(const uint8_t *data, size_t len);
+
+    void clear();
+
+    ShadowBatch shadows;
+    GnssStatsBatch gnss_stats;
+    TripBatch trips;
+    std::array<uint64_t, static_cast<size_t>(Encoding::count)> payloads{};
+    std::array<uint64_t, static_cast<size_t>(Encoding::count)> bytes{};
+    uint64_t rejected = 0; // recognized but malformed
+};
+
+} // namespace ingest
+
+#endif /* _INGEST_H_ */
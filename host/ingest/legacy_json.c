@@ -0,0 +1,12 @@
+#include <stdio.h>
+
+#include "legacy_json.h"
+
+int legacy_device_to_json(char *json_payload, uint8_t payload_len, legacy_device_shadow_t device)
+{
+    return snprintf(json_payload, payload_len,
+                    "{\"9160\": [{\"lat\": %.2f},{\"long\": \"%.2f\"},{\"alt\": \"%.2f\"},{\"battery\": \"%d %%\"},{\"led\": \"%s\"},{\"temp\":\"%d C\"},{\"pres\":\"%d kPa\"},{\"humid\":\"%d %%\"},{\"gas\":\"%d ohm\"}]}",
+                    device.latitude, device.longitude, device.altitude, device.batt_voltage,
+                    device.led1_state ? "on" : "off", device.temperature, device.pressure,
+                    device.relative_humidity, device.gas_res);
+}
@@ -0,0 +1,29 @@
+#ifndef _LEGACY_JSON_H_
+#define _LEGACY_JSON_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* The shadow and device_to_json() of the first firmware, kept as they were so
+ * `ingest bench` and the encoder_size target can measure the json writer against them.
+ */
+
+typedef struct legacy_device_shadow
+{
+    double latitude;
+    double longitude;
+    double altitude;
+    int batt_voltage;
+    bool led1_state;
+    int temperature;
+    int pressure;
+    int relative_humidity;
+    int gas_res;
+} legacy_device_shadow_t;
+
+/**@brief The old snprintf based report, {"9160": [{"lat": ..},{"long": ".."},..]}.
+ * @return What snprintf returned.
+ */
+int legacy_device_to_json(char *json_payload, uint8_t payload_len, legacy_device_shadow_t device);
+
+#endif /* _LEGACY_JSON_H_ */
@@ -0,0 +1,613 @@
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+extern "C" {
+#include "json_writer.h"
+#include "legacy_json.h"
+}
+
+#include "capture.h"
+#include "ingest.h"
+#include "mqtt_subscriber.h"
+
+using namespace ingest;
+
+namespace
+{
+
+#define SHADOW_FIELD_KEY(name, key, decimals) key,
+const char *const field_keys[] = {DEVICE_SHADOW_FIELDS(SHADOW_FIELD_KEY)};
+#undef SHADOW_FIELD_KEY
+
+#define SHADOW_FIELD_DECIMALS(name, key, decimals) decimals,
+const uint8_t field_decimals[] = {DEVICE_SHADOW_FIELDS(SHADOW_FIELD_DECIMALS)};
+#undef SHADOW_FIELD_DECIMALS
+
+#define GNSS_STATS_HEADER_BITS(name, bits) bits,
+const uint8_t header_bits[] = {GNSS_STATS_HEADER_FIELDS(GNSS_STATS_HEADER_BITS)};
+#undef GNSS_STATS_HEADER_BITS
+
+MqttSubscriber *active_subscriber;
+
+void usage()
+{
+    fprintf(stderr,
+            "usage: ingest subscribe [-h host] [-p port] [-t topic] [--record file]\n"
+            "       ingest decode <file> [--lines] [-v] [--csv]\n"
+            "       ingest bench [-n payloads] [capture [--lines] [-v]]\n");
+}
+
+void on_signal(int)
+{
+    if (active_subscriber != nullptr)
+    {
+        active_subscriber->stop();
+    }
+}
+
+/* One payload as a device would publish it */
+struct Sample
+{
+    Encoding encoding;
+    std::vector<uint8_t> data;
+};
+
+/* Full and delta reports through the firmware's own json writer (shadow_fields_to_json) */
+std::vector<uint8_t> shadow_payload(const int32_t (&values)[SHADOW_FIELD_COUNT], uint32_t mask)
+{
+    char json[DEVICE_JSON_MAX_LEN];
+    struct json_writer w;
+
+    json_writer_init(&w, json, sizeof(json));
+    for (int i = 0; i < SHADOW_FIELD_COUNT; i++)
+    {
+        if (mask & (1u << i))
+        {
+            json_add_fixed(&w, field_keys[i], values[i], field_decimals[i]);
+        }
+    }
+
+    int len = json_writer_finish(&w);
+
+    return std::vector<uint8_t>(json, json + (len < 0 ? 0 : len));
+}
+
+legacy_device_shadow_t legacy_shadow(const int32_t (&values)[SHADOW_FIELD_COUNT])
+{
+    legacy_device_shadow_t device = {};
+
+    device.latitude = values[SHADOW_FIELD_LAT] / 1e6;
+    device.longitude = values[SHADOW_FIELD_LON] / 1e6;
+    device.altitude = values[SHADOW_FIELD_ALT] / 1e1;
+    device.batt_voltage = values[SHADOW_FIELD_BAT];
+    device.led1_state = values[SHADOW_FIELD_LED] != 0;
+    device.temperature = values[SHADOW_FIELD_TEMP];
+    device.pressure = values[SHADOW_FIELD_PRES];
+    device.relative_humidity = values[SHADOW_FIELD_HUM];
+    device.gas_res = values[SHADOW_FIELD_GAS];
+    return device;
+}
+
+/* The first firmware's device_to_json(), with the buffer it had */
+std::vector<uint8_t> legacy_payload(const int32_t (&values)[SHADOW_FIELD_COUNT])
+{
+    char json[200];
+    int len = legacy_device_to_json(json, sizeof(json), legacy_shadow(values));
+
+    return std::vector<uint8_t>(json, json + std::clamp(len, 0, static_cast<int>(sizeof(json)) - 1));
+}
+
+/* Same packing as gnss_stats_summary_build() */
+std::vector<uint8_t> gnss_stats_payload(std::mt19937 &rng)
+{
+    std::vector<uint8_t> buf(GNSS_STATS_SUMMARY_LEN);
+    size_t pos = 0;
+    auto put = [&](uint32_t value, uint8_t width) {
+        value = std::min<uint32_t>(value, (1u << width) - 1);
+        for (int i = width - 1; i >= 0; i--, pos++)
+        {
+            if (value & (1u << i))
+            {
+                buf[pos / 8] |= 0x80 >> (pos % 8);
+            }
+        }
+    };
+
+    for (int i = 0; i < GNSS_STATS_HDR_COUNT; i++)
+    {
+        put(i == GNSS_STATS_HDR_VERSION ? GNSS_STATS_VERSION : rng(), header_bits[i]);
+    }
+    for (int c = 0; c < GNSS_STATS_CONSTELLATIONS; c++)
+    {
+        put(rng(), GNSS_STATS_OBSERVATIONS_BITS);
+        for (int b = 0; b < GNSS_STATS_CN0_BINS; b++)
+        {
+            put(rng() % (GNSS_STATS_CN0_SHARE_MAX + 1), GNSS_STATS_CN0_BITS);
+        }
+    }
+    for (int b = 0; b < GNSS_STATS_TTF_BINS; b++)
+    {
+        put(rng(), GNSS_STATS_TTF_BITS);
+    }
+    return buf;
+}
+
+/* A device wandering around San Francisco, the same mix a fleet would send */
+std::vector<Sample> samples_generate(size_t count, std::mt19937 &rng)
+{
+    std::vector<Sample> samples;
+    int32_t values[SHADOW_FIELD_COUNT] = {};
+
+    values[SHADOW_FIELD_LAT] = 37774929;
+    values[SHADOW_FIELD_LON] = -122419416;
+    values[SHADOW_FIELD_TS] = 1735689600;
+    samples.reserve(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        values[SHADOW_FIELD_LAT] += static_cast<int32_t>(rng() % 201) - 100;
+        values[SHADOW_FIELD_LON] += static_cast<int32_t>(rng() % 201) - 100;
+        values[SHADOW_FIELD_ALT] = rng() % 1000;
+        values[SHADOW_FIELD_BAT] = rng() % 101;
+        values[SHADOW_FIELD_LED] = rng() % 2;
+        values[SHADOW_FIELD_TEMP] = static_cast<int32_t>(rng() % 50) - 10;
+        values[SHADOW_FIELD_PRES] = 95 + rng() % 10;
+        values[SHADOW_FIELD_HUM] = rng() % 101;
+        values[SHADOW_FIELD_GAS] = rng() % 200000;
+        values[SHADOW_FIELD_TS] += 60;
+
+        switch (i % 4)
+        {
+        case 0:
+            samples.push_back({Encoding::shadow_json, shadow_payload(values, (1u << SHADOW_FIELD_COUNT) - 1)});
+            break;
+        case 1:
+            samples.push_back({Encoding::shadow_json, shadow_payload(values, rng() & ((1u << SHADOW_FIELD_COUNT) - 1))});
+            break;
+        case 2:
+            samples.push_back({Encoding::legacy_json, legacy_payload(values)});
+            break;
+        default:
+            samples.push_back({Encoding::gnss_stats, gnss_stats_payload(rng)});
+            break;
+        }
+    }
+    return samples;
+}
+
+/* Decode everything in samples, restricted to one encoding unless Encoding::unknown */
+double decode_seconds(const std::vector<Sample> &samples, Encoding only, Decoder &decoder, size_t &payloads, size_t &bytes)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    payloads = 0;
+    bytes = 0;
+    decoder.clear();
+    for (const auto &sample : samples)
+    {
+        if (only != Encoding::unknown && sample.encoding != only)
+        {
+            continue;
+        }
+        decoder.add(sample.data.data(), sample.data.size());
+        payloads++;
+        bytes += sample.data.size();
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return elapsed.count();
+}
+
+void bench_report(const char *name, const std::vector<Sample> &samples, Encoding only)
+{
+    Decoder decoder;
+    size_t payloads = 0;
+    size_t bytes = 0;
+    double best = 1e9;
+
+    /* Best of a few runs, the first one also pays for growing the columns */
+    for (int run = 0; run < 5; run++)
+    {
+        best = std::min(best, decode_seconds(samples, only, decoder, payloads, bytes));
+    }
+    if (payloads == 0)
+    {
+        return;
+    }
+
+    uint64_t rejected = decoder.rejected + decoder.payloads[static_cast<size_t>(Encoding::unknown)];
+    char json[256];
+    struct json_writer w;
+
+    json_writer_init(&w, json, sizeof(json));
+    json_add_str(&w, "encoding", name);
+    json_add_int(&w, "payloads", static_cast<int32_t>(payloads));
+    json_add_int(&w, "avg_len", static_cast<int32_t>(bytes / payloads));
+    json_add_int(&w, "rejected", static_cast<int32_t>(rejected));
+    json_add_int(&w, "payload_per_s", static_cast<int32_t>(std::min(payloads / best, 2e9)));
+    json_add_fixed(&w, "mb_per_s", static_cast<int32_t>(std::min(bytes / best / 1e4, 2e9)), 2);
+    json_add_fixed(&w, "ns_per_payload", static_cast<int32_t>(best * 1e10 / payloads), 1);
+    json_writer_finish(&w);
+
+    /* One line per encoding, grep for INGEST to collect the results */
+    printf("INGEST %s\n", json);
+}
+
+/* Encode the same readings with the old snprintf report and the json writer, as the
+ * device does for a full report. Flash is measured by the encoder_size target.
+ */
+void encode_report(size_t count)
+{
+    std::mt19937 rng(1);
+    struct Reading
+    {
+        int32_t values[SHADOW_FIELD_COUNT];
+    };
+    std::vector<Reading> readings(std::max<size_t>(count, 1));
+    char json[200];
+
+    for (auto &reading : readings)
+    {
+        auto &values = reading.values;
+
+        values[SHADOW_FIELD_LAT] = 37774929 + static_cast<int32_t>(rng() % 20001) - 10000;
+        values[SHADOW_FIELD_LON] = -122419416 + static_cast<int32_t>(rng() % 20001) - 10000;
+        values[SHADOW_FIELD_ALT] = rng() % 1000;
+        values[SHADOW_FIELD_BAT] = rng() % 101;
+        values[SHADOW_FIELD_LED] = rng() % 2;
+        values[SHADOW_FIELD_TEMP] = static_cast<int32_t>(rng() % 50) - 10;
+        values[SHADOW_FIELD_PRES] = 95 + rng() % 10;
+        values[SHADOW_FIELD_HUM] = rng() % 101;
+        values[SHADOW_FIELD_GAS] = rng() % 200000;
+        values[SHADOW_FIELD_TS] = 1735689600 + static_cast<int32_t>(rng() % 86400);
+    }
+
+    auto legacy = [&](const int32_t(&values)[SHADOW_FIELD_COUNT]) {
+        return legacy_device_to_json(json, sizeof(json), legacy_shadow(values));
+    };
+    auto writer = [&](const int32_t(&values)[SHADOW_FIELD_COUNT]) {
+        struct json_writer w;
+
+        json_writer_init(&w, json, sizeof(json));
+        for (int i = 0; i < SHADOW_FIELD_COUNT; i++)
+        {
+            json_add_fixed(&w, field_keys[i], values[i], field_decimals[i]);
+        }
+        return json_writer_finish(&w);
+    };
+    auto report = [&](const char *name, auto &&encode) {
+        double best = 1e9;
+        size_t bytes = 0;
+
+        for (int run = 0; run < 5; run++)
+        {
+            auto start = std::chrono::steady_clock::now();
+
+            bytes = 0;
+            for (const auto &reading : readings)
+            {
+                bytes += encode(reading.values);
+            }
+
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            best = std::min(best, elapsed.count());
+        }
+
+        char line[256];
+        struct json_writer w;
+
+        json_writer_init(&w, line, sizeof(line));
+        json_add_str(&w, "encoder", name);
+        json_add_int(&w, "payloads", static_cast<int32_t>(readings.size()));
+        json_add_int(&w, "avg_len", static_cast<int32_t>(bytes / readings.size()));
+        json_add_fixed(&w, "ns_per_payload", static_cast<int32_t>(best * 1e10 / readings.size()), 1);
+        json_writer_finish(&w);
+
+        /* grep for ENCODE to collect the results */
+        printf("ENCODE %s\n", line);
+    };
+
+    report("legacy_snprintf", legacy);
+    report("json_writer", writer);
+}
+
+bool samples_from_capture(const std::string &path, bool lines, bool with_topic, std::vector<Sample> &samples)
+{
+    std::vector<uint8_t> capture;
+    long records;
+
+    if (!capture_load(path, capture))
+    {
+        fprintf(stderr, "cannot read %s\n", path.c_str());
+        return false;
+    }
+
+    auto handler = [&](std::string_view, const uint8_t *data, size_t len) {
+        samples.push_back({detect(data, len), std::vector<uint8_t>(data, data + len)});
+    };
+
+    records = lines ? capture_lines_for_each(capture, with_topic, handler) : capture_for_each(capture, handler);
+    if (records < 0)
+    {
+        fprintf(stderr, "%s: truncated record\n", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+int cmd_bench(int argc, char **argv)
+{
+    size_t count = 100000;
+    std::string capture;
+    bool lines = false;
+    bool with_topic = false;
+    std::vector<Sample> samples;
+
+    for (int i = 0; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+        {
+            count = strtoul(argv[++i], nullptr, 0);
+        }
+        else if (strcmp(argv[i], "--lines") == 0)
+        {
+            lines = true;
+        }
+        else if (strcmp(argv[i], "-v") == 0)
+        {
+            with_topic = true;
+        }
+        else if (argv[i][0] != '-')
+        {
+            capture = argv[i];
+        }
+        else
+        {
+            usage();
+            return 2;
+        }
+    }
+
+    if (!capture.empty())
+    {
+        if (!samples_from_capture(capture, lines, with_topic, samples))
+        {
+            return 1;
+        }
+    }
+    else
+    {
+        std::mt19937 rng(1);
+
+        samples = samples_generate(count, rng);
+        encode_report(count);
+    }
+
+    for (auto encoding : {Encoding::shadow_json, Encoding::legacy_json, Encoding::gnss_stats})
+    {
+        bench_report(encoding_name(encoding), samples, encoding);
+    }
+    bench_report("mixed", samples, Encoding::unknown);
+    return 0;
+}
+
+void csv_print(const Decoder &decoder)
+{
+    const ShadowBatch &s = decoder.shadows;
+
+    printf("encoding");
+    for (const char *key : field_keys)
+    {
+        printf(",%s", key);
+    }
+    printf("\n");
+    for (size_t row = 0; row < s.size(); row++)
+    {
+        printf("%s", encoding_name(s.encoding[row]));
+        for (int i = 0; i < SHADOW_FIELD_COUNT; i++)
+        {
+            if (!(s.present[row] & (1u << i)))
+            {
+                printf(",");
+                continue;
+            }
+
+            int32_t v = s.values[i][row];
+            int32_t scale = 1;
+
+            for (int d = 0; d < field_decimals[i]; d++)
+            {
+                scale *= 10;
+            }
+            if (scale == 1)
+            {
+                printf(",%d", v);
+            }
+            else
+            {
+                printf(",%s%d.%0*d", v < 0 ? "-" : "", abs(v / scale), field_decimals[i], abs(v % scale));
+            }
+        }
+        printf("\n");
+    }
+}
+
+int cmd_decode(int argc, char **argv)
+{
+    std::string path;
+    bool lines = false;
+    bool with_topic = false;
+    bool csv = false;
+    std::vector<Sample> samples;
+    Decoder decoder;
+
+    for (int i = 0; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--lines") == 0)
+        {
+            lines = true;
+        }
+        else if (strcmp(argv[i], "-v") == 0)
+        {
+            with_topic = true;
+        }
+        else if (strcmp(argv[i], "--csv") == 0)
+        {
+            csv = true;
+        }
+        else if (argv[i][0] != '-')
+        {
+            path = argv[i];
+        }
+        else
+        {
+            usage();
+            return 2;
+        }
+    }
+    if (path.empty())
+    {
+        usage();
+        return 2;
+    }
+    if (!samples_from_capture(path, lines, with_topic, samples))
+    {
+        return 1;
+    }
+
+    for (const auto &sample : samples)
+    {
+        decoder.add(sample.data.data(), sample.data.size());
+    }
+
+    if (csv)
+    {
+        csv_print(decoder);
+        return 0;
+    }
+    for (int e = 0; e < static_cast<int>(Encoding::count); e++)
+    {
+        printf("%-12s %8llu payloads %10llu bytes\n", encoding_name(static_cast<Encoding>(e)),
+               static_cast<unsigned long long>(decoder.payloads[e]), static_cast<unsigned long long>(decoder.bytes[e]));
+    }
+    printf("rejected     %8llu\n", static_cast<unsigned long long>(decoder.rejected));
+    return 0;
+}
+
+int cmd_subscribe(int argc, char **argv)
+{
+    std::string host = "localhost";
+    uint16_t port = 1883;
+    std::string topic = "nrf9160_mqtt_simple/publish/#";
+    std::string record;
+    CaptureWriter writer;
+    MqttSubscriber subscriber;
+    Decoder decoder;
+    int err;
+
+    for (int i = 0; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+        {
+            usage();
+            return 2;
+        }
+        if (strcmp(argv[i], "-h") == 0)
+        {
+            host = argv[++i];
+        }
+        else if (strcmp(argv[i], "-p") == 0)
+        {
+            port = static_cast<uint16_t>(strtoul(argv[++i], nullptr, 0));
+        }
+        else if (strcmp(argv[i], "-t") == 0)
+        {
+            topic = argv[++i];
+        }
+        else if (strcmp(argv[i], "--record") == 0)
+        {
+            record = argv[++i];
+        }
+        else
+        {
+            usage();
+            return 2;
+        }
+    }
+
+    if (!record.empty() && !writer.open(record))
+    {
+        fprintf(stderr, "cannot write %s\n", record.c_str());
+        return 1;
+    }
+
+    err = subscriber.connect(host, port, "ingest-" + std::to_string(getpid()), topic);
+    if (err)
+    {
+        fprintf(stderr, "%s:%u: %s\n", host.c_str(), port, strerror(-err));
+        return 1;
+    }
+
+    active_subscriber = &subscriber;
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    err = subscriber.run([&](std::string_view t, const uint8_t *data, size_t len) {
+        Encoding encoding = decoder.add(data, len);
+
+        if (!record.empty())
+        {
+            writer.write(t, data, len);
+        }
+        printf("%.*s %s %zu\n", static_cast<int>(t.size()), t.data(), encoding_name(encoding), len);
+        fflush(stdout);
+    });
+    active_subscriber = nullptr;
+
+    for (int e = 0; e < static_cast<int>(Encoding::count); e++)
+    {
+        fprintf(stderr, "%s: %llu\n", encoding_name(static_cast<Encoding>(e)),
+                static_cast<unsigned long long>(decoder.payloads[e]));
+    }
+    if (err)
+    {
+        fprintf(stderr, "connection lost: %s\n", strerror(-err));
+        return 1;
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        usage();
+        return 2;
+    }
+    if (strcmp(argv[1], "subscribe") == 0)
+    {
+        return cmd_subscribe(argc - 2, argv + 2);
+    }
+    if (strcmp(argv[1], "decode") == 0)
+    {
+        return cmd_decode(argc - 2, argv + 2);
+    }
+    if (strcmp(argv[1], "bench") == 0)
+    {
+        return cmd_bench(argc - 2, argv + 2);
+    }
+    usage();
+    return 2;
+}
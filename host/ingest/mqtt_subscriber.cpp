@@ -0,0 +1,307 @@
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "mqtt_subscriber.h"
+
+namespace ingest
+{
+
+namespace
+{
+
+enum PacketType : uint8_t
+{
+    CONNECT = 1,
+    CONNACK = 2,
+    PUBLISH = 3,
+    SUBSCRIBE = 8,
+    SUBACK = 9,
+    PINGREQ = 12,
+    PINGRESP = 13,
+    DISCONNECT = 14,
+};
+
+/* Largest remaining length MQTT can encode in four bytes */
+constexpr size_t REMAINING_LEN_MAX = 268435455;
+
+void put_u16(std::vector<uint8_t> &out, uint16_t value)
+{
+    out.push_back(value >> 8);
+    out.push_back(value & 0xff);
+}
+
+void put_string(std::vector<uint8_t> &out, const std::string &s)
+{
+    put_u16(out, s.size());
+    out.insert(out.end(), s.begin(), s.end());
+}
+
+std::vector<uint8_t> packet_build(uint8_t first, const std::vector<uint8_t> &body)
+{
+    std::vector<uint8_t> packet{first};
+    size_t len = body.size();
+
+    do
+    {
+        uint8_t byte = len % 128;
+
+        len /= 128;
+        packet.push_back(len > 0 ? byte | 0x80 : byte);
+    } while (len > 0);
+    packet.insert(packet.end(), body.begin(), body.end());
+    return packet;
+}
+
+} // namespace
+
+int MqttSubscriber::connect(const std::string &host, uint16_t port, const std::string &client_id, const std::string &topic)
+{
+    struct addrinfo hints = {};
+    struct addrinfo *res;
+    std::vector<uint8_t> body;
+    uint8_t type;
+    int err;
+
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    err = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &res);
+    if (err != 0)
+    {
+        return -EHOSTUNREACH;
+    }
+
+    err = -ECONNREFUSED;
+    for (struct addrinfo *ai = res; ai != nullptr; ai = ai->ai_next)
+    {
+        sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (sock < 0)
+        {
+            err = -errno;
+            continue;
+        }
+        if (::connect(sock, ai->ai_addr, ai->ai_addrlen) == 0)
+        {
+            err = 0;
+            break;
+        }
+        err = -errno;
+        ::close(sock);
+        sock = -1;
+    }
+    freeaddrinfo(res);
+    if (err)
+    {
+        return err;
+    }
+
+    /* Clean session, no will, no credentials */
+    put_string(body, "MQTT");
+    body.push_back(4);
+    body.push_back(0x02);
+    put_u16(body, keepalive_s);
+    put_string(body, client_id);
+    err = send_all(packet_build(CONNECT << 4, body));
+    if (err)
+    {
+        return err;
+    }
+    err = read_packet(type, body);
+    if (err)
+    {
+        return err;
+    }
+    if (type != CONNACK || body.size() != 2 || body[1] != 0)
+    {
+        return -EPROTO;
+    }
+
+    body.clear();
+    put_u16(body, 1);
+    put_string(body, topic);
+    body.push_back(0);
+    err = send_all(packet_build(SUBSCRIBE << 4 | 0x02, body));
+    if (err)
+    {
+        return err;
+    }
+    err = read_packet(type, body);
+    if (err)
+    {
+        return err;
+    }
+    if (type != SUBACK || body.size() != 3 || body[2] == 0x80)
+    {
+        return -EPROTO;
+    }
+    return 0;
+}
+
+int MqttSubscriber::run(const PayloadHandler &handler)
+{
+    using clock = std::chrono::steady_clock;
+    auto last_tx = clock::now();
+    std::vector<uint8_t> body;
+
+    while (!stopping)
+    {
+        struct pollfd fds = {sock, POLLIN, 0};
+        auto keepalive = std::chrono::seconds(keepalive_s / 2);
+        int ret;
+
+        if (clock::now() - last_tx >= keepalive)
+        {
+            ret = send_all(packet_build(PINGREQ << 4, {}));
+            if (ret)
+            {
+                return ret;
+            }
+            last_tx = clock::now();
+        }
+
+        ret = poll(&fds, 1, 1000);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -errno;
+        }
+        if (ret == 0)
+        {
+            continue;
+        }
+
+        uint8_t type;
+
+        ret = read_packet(type, body);
+        if (ret)
+        {
+            return ret;
+        }
+        if (type != PUBLISH)
+        {
+            continue; // PINGRESP
+        }
+        if (body.size() < 2)
+        {
+            return -EPROTO;
+        }
+
+        size_t topic_len = body[0] << 8 | body[1];
+
+        if (body.size() < 2 + topic_len)
+        {
+            return -EPROTO;
+        }
+        std::string_view topic(reinterpret_cast<const char *>(&body[2]), topic_len);
+
+        /* QoS 0 subscription, so there is no packet identifier */
+        handler(topic, body.data() + 2 + topic_len, body.size() - 2 - topic_len);
+    }
+    return 0;
+}
+
+void MqttSubscriber::close()
+{
+    if (sock >= 0)
+    {
+        send_all(packet_build(DISCONNECT << 4, {}));
+        ::close(sock);
+        sock = -1;
+    }
+}
+
+int MqttSubscriber::send_all(const std::vector<uint8_t> &packet)
+{
+    size_t sent = 0;
+
+    while (sent < packet.size())
+    {
+        ssize_t n = send(sock, packet.data() + sent, packet.size() - sent, MSG_NOSIGNAL);
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -errno;
+        }
+        sent += n;
+    }
+    return 0;
+}
+
+int MqttSubscriber::recv_exact(uint8_t *buf, size_t len)
+{
+    size_t got = 0;
+
+    while (got < len)
+    {
+        ssize_t n = recv(sock, buf + got, len - got, 0);
+
+        if (n == 0)
+        {
+            return -ECONNRESET;
+        }
+        if (n < 0)
+        {
+            if (errno == EINTR && !stopping)
+            {
+                continue;
+            }
+            return -errno;
+        }
+        got += n;
+    }
+    return 0;
+}
+
+int MqttSubscriber::read_packet(uint8_t &type, std::vector<uint8_t> &body)
+{
+    uint8_t first;
+    size_t len = 0;
+    int err;
+
+    err = recv_exact(&first, 1);
+    if (err)
+    {
+        return err;
+    }
+    for (int shift = 0;; shift += 7)
+    {
+        uint8_t byte;
+
+        err = recv_exact(&byte, 1);
+        if (err)
+        {
+            return err;
+        }
+        len |= static_cast<size_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+        {
+            break;
+        }
+        if (shift == 21)
+        {
+            return -EPROTO;
+        }
+    }
+    if (len > REMAINING_LEN_MAX)
+    {
+        return -EMSGSIZE;
+    }
+
+    type = first >> 4;
+    body.resize(len);
+    return recv_exact(body.data(), len);
+}
+
+} // namespace ingest
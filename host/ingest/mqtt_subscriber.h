@@ -0,0 +1,49 @@
+#ifndef _MQTT_SUBSCRIBER_H_
+#define _MQTT_SUBSCRIBER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "capture.h"
+
+/* Minimal MQTT 3.1.1 subscriber over a plain TCP socket, QoS 0 only. Enough to tap a
+ * local broker the devices publish to, without pulling a client library into the build.
+ */
+
+namespace ingest
+{
+
+class MqttSubscriber
+{
+public:
+    /**@brief Connect and subscribe.
+     * @return 0, or a negative errno / -EPROTO if the broker refused.
+     */
+    int connect(const std::string &host, uint16_t port, const std::string &client_id, const std::string &topic);
+
+    /**@brief Deliver PUBLISH packets to handler until the connection drops or stop() is called.
+     * @return 0 after stop(), or a negative errno.
+     */
+    int run(const PayloadHandler &handler);
+
+    /**@brief Make run() return. Safe from a signal handler.
+     */
+    void stop() { stopping = true; }
+
+    void close();
+    ~MqttSubscriber() { close(); }
+
+private:
+    int send_all(const std::vector<uint8_t> &packet);
+    int read_packet(uint8_t &type, std::vector<uint8_t> &body);
+    int recv_exact(uint8_t *buf, size_t len);
+
+    int sock = -1;
+    uint16_t keepalive_s = 60;
+    volatile bool stopping = false;
+};
+
+} // namespace ingest
+
+#endif /* _MQTT_SUBSCRIBER_H_ */
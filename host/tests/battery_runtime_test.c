@@ -0,0 +1,180 @@
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+
+#include "check.h"
+#include "pmic/battery_runtime.h"
+
+/* A battery drained at a known rate through the fuel gauge's whole percent, sampled at
+ * the interval the module asks for, with the Kconfig defaults: 32 readings, at most
+ * 600 s apart, a drain reported once the fit spans 1800 s
+ */
+
+#define BASE_INTERVAL_MS 10000
+
+static const struct battery_duty_cycle duty = {
+    .gnss_interval_s = 120,
+    .sensor_interval_ms = 20000,
+    .psm = true,
+};
+
+/* SoC in 1/1000 %, and what the gauge last read */
+static int64_t soc_m;
+static uint8_t soc_read;
+static char report[256];
+
+static uint8_t soc_pct(void)
+{
+    return (uint8_t)(soc_m / 1000);
+}
+
+/* The fuel gauge reading at the current uptime, then wait as long as the module asks */
+static uint32_t sample(int32_t drain_mpct_h)
+{
+    uint32_t interval_ms;
+
+    soc_read = soc_pct();
+    battery_runtime_sample(soc_read, 3600 + soc_read * 6);
+    interval_ms = battery_runtime_interval_ms(BASE_INTERVAL_MS);
+    host_uptime_ms += interval_ms;
+    soc_m -= (int64_t)drain_mpct_h * interval_ms / (3600 * MSEC_PER_SEC);
+    return interval_ms;
+}
+
+static void run(int32_t drain_mpct_h, int64_t duration_s)
+{
+    int64_t end_ms = host_uptime_ms + duration_s * MSEC_PER_SEC;
+
+    while (host_uptime_ms < end_ms)
+    {
+        sample(drain_mpct_h);
+    }
+}
+
+static bool report_has(const char *key)
+{
+    char quoted[32];
+
+    snprintf(quoted, sizeof(quoted), "\"%s\":", key);
+    return strstr(report, quoted) != NULL;
+}
+
+/* The number after "key": in the last report, in 1/100 for drain_pct_h */
+static long report_value(const char *key)
+{
+    char quoted[32];
+    const char *at;
+    char *end;
+    long value;
+
+    snprintf(quoted, sizeof(quoted), "\"%s\":", key);
+    at = strstr(report, quoted);
+    if (!CHECK(at != NULL))
+    {
+        fprintf(stderr, "  %s missing in %s\n", key, report);
+        return -1;
+    }
+    value = strtol(at + strlen(quoted), &end, 10);
+    if (*end == '.')
+    {
+        value = value * 100 + strtol(end + 1, NULL, 10);
+    }
+    return value;
+}
+
+static void report_build(void)
+{
+    CHECK(battery_runtime_report_build(report, sizeof(report)) > 0);
+}
+
+/* SoC moves in whole percent, so the fit can be off by a percent over its span */
+static void check_drain(int32_t drain_mpct_h)
+{
+    long span_s = report_value("span_s");
+    long drain_cpct_h = report_value("drain_pct_h");
+    long slack_cpct_h = 100L * 3600 / MAX(span_s, 1);
+
+    if (!CHECK(labs(drain_cpct_h - drain_mpct_h / 10) <= slack_cpct_h))
+    {
+        fprintf(stderr, "  drain %ld, expected %d +- %ld in %s\n", drain_cpct_h, drain_mpct_h / 10,
+                slack_cpct_h, report);
+    }
+    CHECK_EQ(report_value("runtime_min"), soc_read * 100L * 60 / drain_cpct_h);
+}
+
+int main(void)
+{
+    uint32_t interval_ms;
+
+    soc_m = 90400;
+    battery_runtime_duty_cycle_set(&duty);
+
+    /* Nothing to fit yet */
+    report_build();
+    CHECK(!report_has("drain_pct_h"));
+    CHECK_EQ(report_value("samples"), 0);
+
+    /* While SoC stands, the interval doubles per reading up to the maximum */
+    CHECK_EQ(sample(0), BASE_INTERVAL_MS);
+    CHECK_EQ(sample(0), 2 * BASE_INTERVAL_MS);
+    CHECK_EQ(sample(0), 4 * BASE_INTERVAL_MS);
+    run(0, 3600);
+    CHECK_EQ(battery_runtime_interval_ms(BASE_INTERVAL_MS), CONFIG_BATTERY_SAMPLE_MAX_INTERVAL_S * MSEC_PER_SEC);
+    /* and a flat SoC is no drain */
+    report_build();
+    CHECK(!report_has("drain_pct_h"));
+
+    /* A percent lost: back to the configured interval */
+    soc_m -= 1000;
+    interval_ms = sample(0);
+    CHECK_EQ(interval_ms, BASE_INTERVAL_MS);
+
+    /* 1.5 %/h, over a fit shorter and longer than CONFIG_BATTERY_FIT_MIN_SPAN_S */
+    battery_runtime_duty_cycle_set(&(struct battery_duty_cycle){
+        .gnss_interval_s = 60,
+        .sensor_interval_ms = 20000,
+    });
+    CHECK_EQ(battery_runtime_interval_ms(BASE_INTERVAL_MS), BASE_INTERVAL_MS);
+    run(1500, CONFIG_BATTERY_FIT_MIN_SPAN_S / 2);
+    report_build();
+    CHECK(!report_has("drain_pct_h"));
+    CHECK_EQ(report_value("gnss_s"), 60);
+    CHECK_EQ(report_value("psm"), 0);
+    run(1500, 4 * 3600);
+    report_build();
+    check_drain(1500);
+    CHECK(report_value("span_s") >= CONFIG_BATTERY_FIT_MIN_SPAN_S);
+
+    /* Far more readings than the history holds: the oldest leave the fit */
+    run(1500, 24 * 3600);
+    report_build();
+    CHECK_EQ(report_value("samples"), CONFIG_BATTERY_HISTORY_SIZE);
+    check_drain(1500);
+
+    /* A duty cycle change starts a fit of its own, at the new drain */
+    battery_runtime_duty_cycle_set(&duty);
+    report_build();
+    CHECK_EQ(report_value("samples"), 0);
+    CHECK_EQ(report_value("gnss_s"), 120);
+    CHECK_EQ(report_value("psm"), 1);
+    soc_m = 80000;
+    run(4000, 3 * 3600);
+    report_build();
+    check_drain(4000);
+
+    /* Charging restarts the fit, a one percent step up is still gauge noise */
+    soc_m += 1000;
+    sample(0);
+    report_build();
+    CHECK(report_value("samples") > 1);
+    soc_m += 5000;
+    sample(0);
+    report_build();
+    CHECK_EQ(report_value("samples"), 1);
+    CHECK(!report_has("drain_pct_h"));
+
+    /* A report that does not fit */
+    CHECK_EQ(battery_runtime_report_build(report, 16), -ENOMEM);
+
+    return check_result();
+}
@@ -0,0 +1,45 @@
+#ifndef _CHECK_H_
+#define _CHECK_H_
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/* Smallest possible test harness: failed checks are printed and counted, the test
+ * returns check_result() from main so ctest sees the failure.
+ */
+
+extern int check_failures;
+
+#define CHECK(cond) check_true((cond), #cond, __FILE__, __LINE__)
+#define CHECK_EQ(a, b) check_eq((long long)(a), (long long)(b), #a, #b, __FILE__, __LINE__)
+
+static inline bool check_true(bool ok, const char *expr, const char *file, int line)
+{
+    if (!ok)
+    {
+        fprintf(stderr, "%s:%d: CHECK(%s) failed\n", file, line, expr);
+        check_failures++;
+    }
+    return ok;
+}
+
+static inline bool check_eq(long long a, long long b, const char *expr_a, const char *expr_b, const char *file, int line)
+{
+    if (a != b)
+    {
+        fprintf(stderr, "%s:%d: %s == %s failed: %lld != %lld\n", file, line, expr_a, expr_b, a, b);
+        check_failures++;
+    }
+    return a == b;
+}
+
+static inline int check_result(void)
+{
+    if (check_failures != 0)
+    {
+        fprintf(stderr, "%d checks failed\n", check_failures);
+    }
+    return check_failures != 0;
+}
+
+#endif /* _CHECK_H_ */
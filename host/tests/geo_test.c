@@ -0,0 +1,88 @@
+#include <math.h>
+#include <stdlib.h>
+#include <zephyr/sys/util.h>
+
+#include "check.h"
+#include "geo/geo.h"
+
+/* The fixed-point distance against the haversine formula in doubles, within the 1% geo.h
+ * promises for distances between fixes and across geofences
+ */
+
+#define EARTH_RADIUS_M 6371000.0
+#define DEG_TO_RAD (M_PI / 180.0)
+
+static double haversine_m(double lat1, double lon1, double lat2, double lon2)
+{
+    double dlat = (lat2 - lat1) * DEG_TO_RAD;
+    double dlon = (lon2 - lon1) * DEG_TO_RAD;
+    double a = sin(dlat / 2) * sin(dlat / 2) +
+               cos(lat1 * DEG_TO_RAD) * cos(lat2 * DEG_TO_RAD) * sin(dlon / 2) * sin(dlon / 2);
+
+    return 2 * EARTH_RADIUS_M * asin(sqrt(a));
+}
+
+static int32_t udeg(double deg)
+{
+    return (int32_t)lround(deg * GEO_UDEG_PER_DEG);
+}
+
+/* distance_m from (lat, lon) on a bearing, compared on the positions rounded to micro-degrees */
+static void check_distance(double lat, double lon, double distance_m, double bearing_deg)
+{
+    double lat2 = lat + distance_m * cos(bearing_deg * DEG_TO_RAD) / (EARTH_RADIUS_M * DEG_TO_RAD);
+    double lon2 = lon + distance_m * sin(bearing_deg * DEG_TO_RAD) /
+                            (EARTH_RADIUS_M * DEG_TO_RAD * cos((lat + lat2) / 2 * DEG_TO_RAD));
+    double expected;
+    uint32_t got;
+
+    if (lon2 >= 180.0)
+    {
+        lon2 -= 360.0;
+    }
+    expected = haversine_m(lat, lon, lat2, lon2);
+    got = geo_distance_m(udeg(lat), udeg(lon), udeg(lat2), udeg(lon2));
+    if (!CHECK(fabs(got - expected) <= expected / 100))
+    {
+        fprintf(stderr, "  %.0f m at %.0f deg from %.6f,%.6f: got %u m, expected %.1f m\n", distance_m,
+                bearing_deg, lat, lon, got, expected);
+    }
+}
+
+int main(void)
+{
+    static const double latitudes[] = {0.0, 30.0, 45.0, -45.0, 60.0, 70.0};
+    static const double distances_m[] = {200.0, 1000.0, 5000.0, 20000.0};
+    static const double bearings_deg[] = {0.0, 45.0, 90.0, 135.0};
+
+    for (size_t i = 0; i < ARRAY_SIZE(latitudes); i++)
+    {
+        for (size_t d = 0; d < ARRAY_SIZE(distances_m); d++)
+        {
+            for (size_t b = 0; b < ARRAY_SIZE(bearings_deg); b++)
+            {
+                check_distance(latitudes[i], 10.7, distances_m[d], bearings_deg[b]);
+            }
+        }
+    }
+
+    /* Across the antimeridian, the short way round */
+    check_distance(-17.8, 179.999, 1000.0, 90.0);
+    check_distance(65.0, 179.99, 5000.0, 45.0);
+    CHECK_EQ(geo_distance_m(0, udeg(179.9995), 0, udeg(-179.9995)), 111);
+    CHECK_EQ(geo_distance_m(0, udeg(-179.9995), 0, udeg(179.9995)), 111);
+
+    /* Symmetric in latitude, flat at the poles */
+    CHECK_EQ(geo_cos_q15(0), 32767);
+    CHECK_EQ(geo_cos_q15(udeg(60.0)), 16384);
+    CHECK_EQ(geo_cos_q15(udeg(-60.0)), 16384);
+    CHECK_EQ(geo_cos_q15(udeg(90.0)), 0);
+    CHECK(abs(geo_cos_q15(udeg(37.5)) - (int32_t)lround(cos(37.5 * DEG_TO_RAD) * 32768)) <= 8);
+
+    CHECK_EQ(geo_isqrt64(0), 0);
+    CHECK_EQ(geo_isqrt64(99), 9);
+    CHECK_EQ(geo_isqrt64(100), 10);
+    CHECK_EQ(geo_isqrt64((uint64_t)UINT32_MAX * UINT32_MAX), UINT32_MAX);
+
+    return check_result();
+}
@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <zephyr/kernel.h>
+
+#include "check.h"
+#include "geofence_cmd.h"
+#include "geo/geo.h"
+
+/* Per-fix cost of the geofence engine with hundreds of fences, 4 in 5 circles and the rest
+ * hexagons, scattered over 20 km around San Francisco, and a vehicle driving through them.
+ * Built twice, with the grid index and with every fence on the linear list
+ * (CONFIG_GEOFENCE_MAX_CELLS_PER_FENCE=0), and both must raise the same events:
+ *   geofence_bench [-n fences] [-f fixes]
+ */
+
+#define AREA_UDEG 180000
+#define ORIGIN_LAT 37700000
+#define ORIGIN_LON -122500000
+
+static uint32_t event_count;
+static uint32_t event_digest = 2166136261u;
+
+static void event_handler(const struct geofence_event *evt)
+{
+    const uint32_t words[] = {evt->fence_id, evt->type, (uint32_t)evt->lat, (uint32_t)evt->lon};
+
+    /* FNV-1a over everything the event carries */
+    for (size_t i = 0; i < ARRAY_SIZE(words); i++)
+    {
+        event_digest = (event_digest ^ words[i]) * 16777619u;
+    }
+    event_count++;
+}
+
+static uint32_t rng_state = 1;
+
+static uint32_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static int fences_configure(int count)
+{
+    static uint8_t buf[CONFIG_GEOFENCE_MAX_FENCES * (4 + 8 * CONFIG_GEOFENCE_MAX_VERTICES)];
+    size_t len = 0;
+
+    for (int id = 1; id <= count; id++)
+    {
+        int32_t lat = ORIGIN_LAT + (int32_t)(rng() % AREA_UDEG);
+        int32_t lon = ORIGIN_LON + (int32_t)(rng() % AREA_UDEG);
+
+        if (id % 5 != 0)
+        {
+            len += geofence_cmd_circle(&buf[len], id, lat, lon, 50 + rng() % 450);
+        }
+        else
+        {
+            /* Hexagon, udeg offsets of cos(k * 60 deg) in Q10 */
+            static const int16_t cos_q10[6] = {1024, 512, -512, -1024, -512, 512};
+            static const int16_t sin_q10[6] = {0, 887, 887, 0, -887, -887};
+            int32_t radius = 1000 + rng() % 6000;
+            int32_t vlat[6];
+            int32_t vlon[6];
+
+            for (int k = 0; k < 6; k++)
+            {
+                vlat[k] = lat + radius * sin_q10[k] / 1024;
+                vlon[k] = lon + radius * cos_q10[k] / 1024;
+            }
+            len += geofence_cmd_polygon(&buf[len], id, 6, vlat, vlon);
+        }
+    }
+    return geofence_config_apply(buf, len);
+}
+
+int main(int argc, char **argv)
+{
+    int fences = 500;
+    int fixes = 20000;
+    int32_t lat = ORIGIN_LAT + AREA_UDEG / 2;
+    int32_t lon = ORIGIN_LON + AREA_UDEG / 2;
+    int32_t dlat = 90;
+    int32_t dlon = 70;
+    uint64_t total_ns = 0;
+    uint32_t max_ns = 0;
+    int err;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+        {
+            fences = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+        {
+            fixes = atoi(argv[++i]);
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [-n fences] [-f fixes]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (fences < 1 || fences > CONFIG_GEOFENCE_MAX_FENCES || fixes < 1)
+    {
+        fprintf(stderr, "1 to %d fences and at least one fix\n", CONFIG_GEOFENCE_MAX_FENCES);
+        return 2;
+    }
+
+    geofence_init(event_handler);
+    err = fences_configure(fences);
+    CHECK_EQ(err, 0);
+
+    /* About 10 m/s, turning now and then and bouncing off the edges of the area */
+    for (int i = 0; i < fixes; i++)
+    {
+        uint32_t start;
+        uint32_t elapsed_ns;
+
+        if (rng() % 60 == 0)
+        {
+            dlat = (int32_t)(rng() % 181) - 90;
+            dlon = (int32_t)(rng() % 181) - 90;
+        }
+        if (lat + dlat < ORIGIN_LAT || lat + dlat > ORIGIN_LAT + AREA_UDEG)
+        {
+            dlat = -dlat;
+        }
+        if (lon + dlon < ORIGIN_LON || lon + dlon > ORIGIN_LON + AREA_UDEG)
+        {
+            dlon = -dlon;
+        }
+        lat += dlat;
+        lon += dlon;
+        host_uptime_ms += 1000;
+
+        /* Work items run when submitted here, so this is the whole evaluation */
+        start = k_cycle_get_32();
+        geofence_position_update(lat, lon);
+        elapsed_ns = k_cycle_get_32() - start;
+        total_ns += elapsed_ns;
+        max_ns = MAX(max_ns, elapsed_ns);
+    }
+
+    /* A walk through this many fences that raises nothing measures nothing */
+    CHECK(event_count > 0);
+
+    printf("GEOFENCE {\"index\":\"%s\",\"fences\":%d,\"fixes\":%d,\"events\":%u,\"ns_per_fix\":%llu,"
+           "\"ns_per_fix_max\":%u}\n",
+           CONFIG_GEOFENCE_MAX_CELLS_PER_FENCE > 0 ? "grid" : "linear", fences, fixes, event_count,
+           (unsigned long long)(total_ns / fixes), max_ns);
+    /* Compared between the grid and linear builds */
+    printf("GEOFENCE_EVENTS %u %08x\n", event_count, event_digest);
+    return check_result();
+}
@@ -0,0 +1,43 @@
+#ifndef _GEOFENCE_CMD_H_
+#define _GEOFENCE_CMD_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/sys/byteorder.h>
+
+#include "geofence/geofence.h"
+
+/* Builders for the fence configuration payload of geofence.h, each returns its length */
+
+static inline size_t geofence_cmd_circle(uint8_t *buf, uint16_t id, int32_t lat, int32_t lon, uint32_t radius_m)
+{
+    buf[0] = GEOFENCE_CMD_CIRCLE;
+    sys_put_le16(id, &buf[1]);
+    sys_put_le32((uint32_t)lat, &buf[3]);
+    sys_put_le32((uint32_t)lon, &buf[7]);
+    sys_put_le32(radius_m, &buf[11]);
+    return 15;
+}
+
+static inline size_t geofence_cmd_polygon(uint8_t *buf, uint16_t id, uint8_t n, const int32_t *lat, const int32_t *lon)
+{
+    buf[0] = GEOFENCE_CMD_POLYGON;
+    sys_put_le16(id, &buf[1]);
+    buf[3] = n;
+    for (int i = 0; i < n; i++)
+    {
+        sys_put_le32((uint32_t)lat[i], &buf[4 + 8 * i]);
+        sys_put_le32((uint32_t)lon[i], &buf[8 + 8 * i]);
+    }
+    return 4 + 8 * n;
+}
+
+static inline size_t geofence_cmd_delete(uint8_t *buf, uint16_t id)
+{
+    buf[0] = GEOFENCE_CMD_DELETE;
+    sys_put_le16(id, &buf[1]);
+    return 3;
+}
+
+#endif /* _GEOFENCE_CMD_H_ */
@@ -0,0 +1,110 @@
+#include <zephyr/kernel.h>
+#include <zephyr/settings/settings.h>
+
+#include "check.h"
+#include "geofence_cmd.h"
+
+/* A configuration update is applied whole or not at all */
+
+#define EVENTS_MAX 16
+
+static struct geofence_event events[EVENTS_MAX];
+static int event_count;
+
+static void event_handler(const struct geofence_event *evt)
+{
+    if (event_count < EVENTS_MAX)
+    {
+        events[event_count] = *evt;
+    }
+    event_count++;
+}
+
+/* Move to a fix and return how many events it raised, the first one in events[0] */
+static int fix(int32_t lat, int32_t lon)
+{
+    event_count = 0;
+    host_uptime_ms += 1000;
+    geofence_position_update(lat, lon);
+    return event_count;
+}
+
+/* Two spots 5 km apart in San Francisco */
+#define P_LAT 37774929
+#define P_LON -122419416
+#define Q_LAT 37819929
+#define Q_LON -122419416
+
+int main(void)
+{
+    uint8_t buf[128];
+    size_t len;
+    unsigned int saves;
+    unsigned int deletes;
+
+    geofence_init(event_handler);
+
+    /* A valid update */
+    len = geofence_cmd_circle(buf, 1, P_LAT, P_LON, 100);
+    CHECK_EQ(geofence_config_apply(buf, len), 0);
+    CHECK_EQ(host_settings_saves, 1);
+    CHECK_EQ(fix(P_LAT, P_LON), 1);
+    CHECK_EQ(events[0].fence_id, 1);
+    CHECK_EQ(events[0].type, GEOFENCE_EVT_ENTER);
+
+    /* A good circle followed by a truncated polygon: neither is applied or stored */
+    saves = host_settings_saves;
+    len = geofence_cmd_circle(buf, 2, Q_LAT, Q_LON, 100);
+    buf[len++] = GEOFENCE_CMD_POLYGON;
+    buf[len++] = 3;
+    CHECK(geofence_config_apply(buf, len) < 0);
+    CHECK_EQ(host_settings_saves, saves);
+    CHECK_EQ(fix(Q_LAT, Q_LON), 1);
+    CHECK_EQ(events[0].fence_id, 1);
+    CHECK_EQ(events[0].type, GEOFENCE_EVT_EXIT);
+
+    /* A delete followed by an unknown command: fence 1 stays */
+    deletes = host_settings_deletes;
+    len = geofence_cmd_delete(buf, 1);
+    buf[len++] = 0x7f;
+    CHECK(geofence_config_apply(buf, len) < 0);
+    CHECK_EQ(host_settings_deletes, deletes);
+    CHECK_EQ(fix(P_LAT, P_LON), 1);
+    CHECK_EQ(events[0].type, GEOFENCE_EVT_ENTER);
+
+    /* Polygon with a bad vertex count after a good circle */
+    {
+        int32_t lat[2] = {Q_LAT, Q_LAT + 1000};
+        int32_t lon[2] = {Q_LON, Q_LON + 1000};
+
+        len = geofence_cmd_circle(buf, 3, Q_LAT, Q_LON, 100);
+        len += geofence_cmd_polygon(&buf[len], 4, 2, lat, lon);
+        CHECK(geofence_config_apply(buf, len) < 0);
+        CHECK_EQ(fix(Q_LAT, Q_LON), 1);
+        CHECK_EQ(events[0].type, GEOFENCE_EVT_EXIT);
+    }
+
+    /* Replacing a fence in place keeps the others and resets only its state */
+    len = geofence_cmd_circle(buf, 2, Q_LAT, Q_LON, 200);
+    CHECK_EQ(geofence_config_apply(buf, len), 0);
+    CHECK_EQ(fix(Q_LAT, Q_LON), 1);
+    CHECK_EQ(events[0].fence_id, 2);
+    CHECK_EQ(fix(P_LAT, P_LON), 2);
+
+    /* The same config pushed again while inside: nothing stored, no second enter */
+    saves = host_settings_saves;
+    len = geofence_cmd_circle(buf, 1, P_LAT, P_LON, 100);
+    len += geofence_cmd_circle(&buf[len], 2, Q_LAT, Q_LON, 200);
+    CHECK_EQ(geofence_config_apply(buf, len), 0);
+    CHECK_EQ(host_settings_saves, saves);
+    CHECK_EQ(fix(P_LAT, P_LON), 0);
+
+    /* A valid delete is applied and removed from settings */
+    deletes = host_settings_deletes;
+    len = geofence_cmd_delete(buf, 1);
+    CHECK_EQ(geofence_config_apply(buf, len), 0);
+    CHECK_EQ(host_settings_deletes, deletes + 1);
+    CHECK_EQ(fix(P_LAT + 10, P_LON), 0);
+
+    return check_result();
+}
@@ -0,0 +1,242 @@
+#include <zephyr/kernel.h>
+
+#include <nrf_modem_gnss.h>
+
+#include "check.h"
+#include "mqtt/mqtt_liveness.h"
+#include "radio/radio_arbiter.h"
+
+/* Dead link detection from the broker's answers, and how it goes along with the radio
+ * arbiter holding uplinks while GNSS has the radio, with the Kconfig defaults: a 20 s
+ * timeout until the first RTT sample, 3 s to 60 s after, 30 s GNSS windows ending
+ * early after an uplink waited 10 s.
+ */
+
+#define INITIAL_TIMEOUT_MS (CONFIG_MQTT_LIVENESS_INITIAL_TIMEOUT_S * MSEC_PER_SEC)
+#define UPLINK_DELAY_MS (CONFIG_RADIO_ARBITER_UPLINK_DELAY_S * MSEC_PER_SEC)
+
+static bool gnss_priority;
+
+int nrf_modem_gnss_prio_mode_enable(void)
+{
+    gnss_priority = true;
+    return 0;
+}
+
+int nrf_modem_gnss_prio_mode_disable(void)
+{
+    gnss_priority = false;
+    return 0;
+}
+
+static void wait_ms(int64_t ms)
+{
+    host_uptime_ms += ms;
+    host_work_run_due();
+}
+
+/* A request answered after rtt_ms */
+static void round_trip(enum mqtt_liveness_request type, uint16_t message_id, int64_t rtt_ms)
+{
+    mqtt_liveness_sent(type, message_id);
+    wait_ms(rtt_ms);
+    mqtt_liveness_rx();
+    mqtt_liveness_answered(type, message_id);
+}
+
+/* What mqtt_connection() in main.c does about the arbiter on every iteration, with no
+ * publishes queued and the next ping keepalive_ms away, -1 for none. Returns the hold.
+ */
+static int loop_iteration_keepalive(int keepalive_ms)
+{
+    int hold_ms = radio_arbiter_uplink_hold_ms(mqtt_liveness_waiting(), keepalive_ms);
+
+    if (hold_ms > 0)
+    {
+        mqtt_liveness_hold();
+    }
+    return hold_ms;
+}
+
+static int loop_iteration(void)
+{
+    return loop_iteration_keepalive(-1);
+}
+
+/* GNSS searching and blocked by LTE, the arbiter opens a window right away */
+static void gnss_blocked(void)
+{
+    struct nrf_modem_gnss_pvt_data_frame pvt = {.flags = NRF_MODEM_GNSS_PVT_FLAG_NOT_ENOUGH_WINDOW_TIME};
+
+    radio_arbiter_gnss_search();
+    radio_arbiter_gnss_pvt(&pvt);
+    host_work_run_due();
+}
+
+int main(void)
+{
+    const struct mqtt_liveness_stats *s = mqtt_liveness_stats_get();
+    char buf[256];
+    uint32_t samples;
+    int64_t sent_ms;
+    int64_t held_ms;
+    int hold_ms;
+
+    host_uptime_ms = 1000;
+    radio_arbiter_lte_update(false, false);
+
+    /* Nothing unanswered, nothing to time */
+    mqtt_liveness_reset();
+    CHECK(!mqtt_liveness_waiting());
+    CHECK_EQ(mqtt_liveness_time_left(), -1);
+
+    /* The initial timeout until the first answer */
+    mqtt_liveness_sent(MQTT_LIVENESS_CONNECT, 0);
+    CHECK(mqtt_liveness_waiting());
+    CHECK_EQ(mqtt_liveness_time_left(), INITIAL_TIMEOUT_MS);
+    wait_ms(400);
+    mqtt_liveness_rx();
+    mqtt_liveness_answered(MQTT_LIVENESS_CONNECT, 0);
+    CHECK(!mqtt_liveness_waiting());
+    CHECK_EQ(s->rtt_samples, 1);
+    CHECK_EQ(s->rtt_last_ms, 400);
+
+    /* Steady answers pull the timeout down to the minimum */
+    for (int i = 0; i < 20; i++)
+    {
+        round_trip(MQTT_LIVENESS_PUBLISH, i + 1, 400 + (i % 3) * 50);
+        wait_ms(5000);
+    }
+    CHECK_EQ(s->rtt_samples, 21);
+    CHECK(s->srtt_ms >= 400 && s->srtt_ms <= 500);
+    CHECK_EQ(s->timeout_ms, CONFIG_MQTT_LIVENESS_MIN_TIMEOUT_MS);
+
+    /* Only the publish with the right id is answered */
+    mqtt_liveness_sent(MQTT_LIVENESS_PUBLISH, 100);
+    mqtt_liveness_answered(MQTT_LIVENESS_PUBLISH, 101);
+    CHECK(mqtt_liveness_waiting());
+    mqtt_liveness_answered(MQTT_LIVENESS_PUBLISH, 100);
+    CHECK(!mqtt_liveness_waiting());
+
+    /* Anything heard from the broker restarts the wait */
+    mqtt_liveness_sent(MQTT_LIVENESS_PING, 0);
+    wait_ms(2000);
+    CHECK_EQ(mqtt_liveness_time_left(), s->timeout_ms - 2000);
+    mqtt_liveness_rx();
+    wait_ms(1000);
+    CHECK_EQ(mqtt_liveness_time_left(), s->timeout_ms - 1000);
+
+    /* An unanswered ping is a dead link once the timeout passed */
+    wait_ms(s->timeout_ms - 1000);
+    CHECK_EQ(mqtt_liveness_time_left(), 0);
+    mqtt_liveness_dead();
+    CHECK_EQ(s->dead_links, 1);
+    CHECK_EQ(s->detect_last_ms, s->timeout_ms);
+    CHECK(!mqtt_liveness_waiting());
+
+    /* Slow answers raise the timeout again, up to the maximum */
+    for (int i = 0; i < 10; i++)
+    {
+        round_trip(MQTT_LIVENESS_PING, 0, 8000 + i * 500);
+    }
+    CHECK(s->timeout_ms > 8000);
+    CHECK(s->timeout_ms <= CONFIG_MQTT_LIVENESS_MAX_TIMEOUT_S * MSEC_PER_SEC);
+
+    /* An answer that waited out a hold says nothing about the link */
+    samples = s->rtt_samples;
+    mqtt_liveness_sent(MQTT_LIVENESS_PING, 0);
+    wait_ms(10);
+    mqtt_liveness_hold();
+    wait_ms(30000);
+    mqtt_liveness_rx();
+    mqtt_liveness_answered(MQTT_LIVENESS_PING, 0);
+    CHECK_EQ(s->rtt_samples, samples);
+    CHECK(!mqtt_liveness_waiting());
+
+    /* Back to fast answers and the shortest timeout */
+    for (int i = 0; i < 30; i++)
+    {
+        round_trip(MQTT_LIVENESS_PING, 0, 400);
+    }
+    CHECK_EQ(s->timeout_ms, CONFIG_MQTT_LIVENESS_MIN_TIMEOUT_MS);
+
+    /* With nothing unanswered, a GNSS window does not hold the loop */
+    gnss_blocked();
+    CHECK(gnss_priority);
+    CHECK_EQ(loop_iteration(), 0);
+
+    /* A ping sent in the window: waiting for its answer counts as a pending uplink, the
+     * loop is held, and every held iteration gives the request a full timeout again
+     */
+    mqtt_liveness_sent(MQTT_LIVENESS_PING, 0);
+    sent_ms = host_uptime_ms;
+    hold_ms = loop_iteration();
+    CHECK(hold_ms > 0);
+    held_ms = host_uptime_ms;
+    while (hold_ms > 0)
+    {
+        CHECK_EQ(mqtt_liveness_time_left(), s->timeout_ms);
+        wait_ms(hold_ms);
+        hold_ms = loop_iteration();
+        if (hold_ms > 0)
+        {
+            held_ms = host_uptime_ms;
+        }
+    }
+    /* The arbiter ended the window for it once the uplink delay was up */
+    CHECK(!gnss_priority);
+    CHECK_EQ(host_uptime_ms - sent_ms, UPLINK_DELAY_MS);
+    CHECK_EQ(radio_arbiter_stats_get()->uplinks_delayed, 1);
+
+    /* Counted from the send, the link would be dead by now. The deadline counts from the
+     * last held iteration instead, and passes without an answer.
+     */
+    CHECK(host_uptime_ms - sent_ms > s->timeout_ms);
+    CHECK_EQ(mqtt_liveness_time_left(), held_ms + s->timeout_ms - host_uptime_ms);
+    wait_ms(held_ms + s->timeout_ms - host_uptime_ms - 1);
+    CHECK_EQ(loop_iteration(), 0);
+    CHECK_EQ(mqtt_liveness_time_left(), 1);
+    wait_ms(1);
+    CHECK_EQ(mqtt_liveness_time_left(), 0);
+    mqtt_liveness_dead();
+    CHECK_EQ(s->dead_links, 2);
+
+    /* GNSS blocked while a request is unanswered: the window waits for the answer, and
+     * opens as soon as it came, not once GNSS starved
+     */
+    wait_ms(CONFIG_RADIO_ARBITER_GAP_S * MSEC_PER_SEC);
+    mqtt_liveness_sent(MQTT_LIVENESS_PING, 0);
+    CHECK_EQ(loop_iteration(), 0);
+    gnss_blocked();
+    CHECK(!gnss_priority);
+    wait_ms(400);
+    mqtt_liveness_rx();
+    mqtt_liveness_answered(MQTT_LIVENESS_PING, 0);
+    CHECK_EQ(loop_iteration(), 0);
+    host_work_run_due();
+    CHECK(gnss_priority);
+
+    /* The window ends with the search, and the next one waits for a keepalive due within
+     * a window's length: it opens once the ping went out and the next one is far away
+     */
+    radio_arbiter_gnss_sleep();
+    host_work_run_due();
+    CHECK(!gnss_priority);
+    wait_ms(CONFIG_RADIO_ARBITER_GAP_S * MSEC_PER_SEC);
+    CHECK_EQ(loop_iteration_keepalive(5000), 0);
+    gnss_blocked();
+    CHECK(!gnss_priority);
+    wait_ms(4000);
+    CHECK_EQ(loop_iteration_keepalive(1000), 0);
+    CHECK(!gnss_priority);
+    wait_ms(1000);
+    CHECK_EQ(loop_iteration_keepalive(60000), 0);
+    host_work_run_due();
+    CHECK(gnss_priority);
+    CHECK_EQ(radio_arbiter_stats_get()->windows_forced, 0);
+
+    CHECK(mqtt_liveness_report_build(buf, sizeof(buf)) > 0);
+    CHECK_EQ(mqtt_liveness_report_build(buf, 16), -ENOMEM);
+
+    return check_result();
+}
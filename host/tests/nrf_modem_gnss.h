@@ -0,0 +1,20 @@
+#ifndef _HOST_NRF_MODEM_GNSS_H_
+#define _HOST_NRF_MODEM_GNSS_H_
+
+#include <stdint.h>
+
+/* The PVT flags and priority calls the radio arbiter uses, the test defines the calls */
+
+#define NRF_MODEM_GNSS_PVT_FLAG_FIX_VALID 0x01
+#define NRF_MODEM_GNSS_PVT_FLAG_DEADLINE_MISSED 0x08
+#define NRF_MODEM_GNSS_PVT_FLAG_NOT_ENOUGH_WINDOW_TIME 0x10
+
+struct nrf_modem_gnss_pvt_data_frame
+{
+    uint8_t flags;
+};
+
+int nrf_modem_gnss_prio_mode_enable(void);
+int nrf_modem_gnss_prio_mode_disable(void);
+
+#endif /* _HOST_NRF_MODEM_GNSS_H_ */
@@ -0,0 +1,13 @@
+# Run FIRST and SECOND and compare their output lines starting with MATCH:
+#   cmake -DFIRST=a -DSECOND=b -DMATCH=prefix -P same_lines.cmake
+foreach(program FIRST SECOND)
+  execute_process(COMMAND ${${program}} RESULT_VARIABLE result OUTPUT_VARIABLE output)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${${program}} failed (${result}):\n${output}")
+  endif()
+  string(REGEX MATCHALL "${MATCH}[^\n]*" ${program}_lines "${output}")
+  message(STATUS "${${program}}: ${output}")
+endforeach()
+if(NOT FIRST_lines OR NOT FIRST_lines STREQUAL SECOND_lines)
+  message(FATAL_ERROR "Outputs differ: '${FIRST_lines}' and '${SECOND_lines}'")
+endif()
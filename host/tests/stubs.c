@@ -0,0 +1,67 @@
+#include <stdlib.h>
+#include <time.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/settings/settings.h>
+
+#include "check.h"
+
+int64_t host_uptime_ms;
+unsigned int host_settings_saves;
+unsigned int host_settings_deletes;
+int check_failures;
+
+uint32_t k_cycle_get_32(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec);
+}
+
+/* Every delayed work item ever scheduled, so host_work_run_due() can find them */
+#define HOST_DELAYABLE_MAX 8
+
+static struct k_work_delayable *delayables[HOST_DELAYABLE_MAX];
+static size_t delayable_count;
+
+int k_work_reschedule(struct k_work_delayable *dwork, k_timeout_t delay)
+{
+    size_t i;
+
+    for (i = 0; i < delayable_count && delayables[i] != dwork; i++)
+    {
+    }
+    if (i == delayable_count)
+    {
+        if (delayable_count == HOST_DELAYABLE_MAX)
+        {
+            fprintf(stderr, "More than %d delayed work items\n", HOST_DELAYABLE_MAX);
+            abort();
+        }
+        delayables[delayable_count++] = dwork;
+    }
+
+    dwork->due_ms = host_uptime_ms + delay;
+    dwork->scheduled = true;
+    return 1;
+}
+
+void host_work_run_due(void)
+{
+    bool ran = true;
+
+    while (ran)
+    {
+        ran = false;
+        for (size_t i = 0; i < delayable_count; i++)
+        {
+            if (delayables[i]->scheduled && delayables[i]->due_ms <= host_uptime_ms)
+            {
+                delayables[i]->scheduled = false;
+                delayables[i]->work.handler(&delayables[i]->work);
+                ran = true;
+            }
+        }
+    }
+}
@@ -0,0 +1,168 @@
+#include <math.h>
+#include <stdlib.h>
+#include <zephyr/kernel.h>
+
+#include "check.h"
+#include "geo/geo.h"
+#include "trip/trip.h"
+
+/* Trips driven through trip_fix_update() one fix at a time, with the Kconfig defaults:
+ * moving from 150 cm/s, stops within 50 m, counted from 60 s, ending the trip at 300 s
+ */
+
+#define EARTH_RADIUS_M 6371000.0
+#define DEG_TO_RAD (M_PI / 180.0)
+
+static int summaries;
+static struct trip_summary summary;
+
+static void summary_cb(const struct trip_summary *s)
+{
+    summaries++;
+    summary = *s;
+}
+
+/* The simulated device, moved in metres and reported in micro-degrees. It starts
+ * near Fiji, 1 km west of the antimeridian, and drives north until the last trip.
+ */
+static int64_t utc_ms = 1700000000000LL;
+static double lat_deg = -17.8;
+static double lon_deg = 179.99;
+
+static void fix(int dt_s, double north_m, double east_m, uint32_t speed_cms)
+{
+    struct trip_fix f;
+
+    utc_ms += (int64_t)dt_s * MSEC_PER_SEC;
+    lat_deg += north_m / (EARTH_RADIUS_M * DEG_TO_RAD);
+    lon_deg += east_m / (EARTH_RADIUS_M * DEG_TO_RAD * cos(lat_deg * DEG_TO_RAD));
+    if (lon_deg >= 180.0)
+    {
+        lon_deg -= 360.0;
+    }
+
+    f.utc_ms = utc_ms;
+    f.lat = (int32_t)lround(lat_deg * GEO_UDEG_PER_DEG);
+    f.lon = (int32_t)lround(lon_deg * GEO_UDEG_PER_DEG);
+    f.speed_cms = speed_cms;
+    trip_fix_update(&f);
+}
+
+/* 1 Hz fixes for seconds, driving north or east at 10 m/s */
+static void drive_north(int seconds)
+{
+    for (int i = 0; i < seconds; i++)
+    {
+        fix(1, 10.0, 0.0, 1000);
+    }
+}
+
+static void drive_east(int seconds)
+{
+    for (int i = 0; i < seconds; i++)
+    {
+        fix(1, 0.0, 10.0, 1000);
+    }
+}
+
+/* 1 Hz fixes for seconds, standing still with a few metres of position noise */
+static void rest(int seconds)
+{
+    for (int i = 0; i < seconds; i++)
+    {
+        fix(1, i % 2 ? 3.0 : -3.0, 0.0, 20);
+    }
+}
+
+static int64_t field(enum trip_field f)
+{
+    return summary.values[f];
+}
+
+/* Within 1% of the exact distance, what geo.h promises */
+static void check_distance(int64_t expected_m)
+{
+    int64_t got = field(TRIP_FIELD_DISTANCE_M);
+
+    if (!CHECK(llabs(got - expected_m) * 100 <= expected_m))
+    {
+        fprintf(stderr, "  distance %lld m, expected %lld m\n", (long long)got, (long long)expected_m);
+    }
+}
+
+static void check_near(int64_t got, int64_t expected, int64_t slack)
+{
+    if (!CHECK(llabs(got - expected) <= slack))
+    {
+        fprintf(stderr, "  %lld, expected %lld +- %lld\n", (long long)got, (long long)expected, (long long)slack);
+    }
+}
+
+int main(void)
+{
+    uint8_t buf[TRIP_SUMMARY_LEN];
+
+    trip_init(summary_cb);
+
+    /* A stop shorter than CONFIG_TRIP_STOP_MIN_S is driving, a longer one counts */
+    rest(60);
+    CHECK_EQ(summaries, 0);
+    drive_north(600);
+    rest(30);
+    drive_north(300);
+    rest(120);
+    drive_north(300);
+    rest(CONFIG_TRIP_END_S - 1);
+    CHECK_EQ(summaries, 0);
+    rest(2);
+    CHECK_EQ(summaries, 1);
+    check_distance(12000);
+    CHECK_EQ(field(TRIP_FIELD_STOPS), 1);
+    check_near(field(TRIP_FIELD_STOPPED_S), 120, 2);
+    CHECK_EQ(field(TRIP_FIELD_LONGEST_STOP_S), field(TRIP_FIELD_STOPPED_S));
+    check_near(field(TRIP_FIELD_DURATION_S), 600 + 30 + 300 + 120 + 300, 2);
+    CHECK_EQ(field(TRIP_FIELD_MAX_SPEED_CMS), 1000);
+    /* The short stop is moving time */
+    check_near(field(TRIP_FIELD_AVG_SPEED_CMS), 12000 * 100 / (600 + 30 + 300 + 300), 10);
+    CHECK_EQ(trip_summary_encode(&summary, buf, sizeof(buf)), TRIP_SUMMARY_LEN);
+    CHECK_EQ(trip_summary_encode(&summary, buf, sizeof(buf) - 1), -ENOMEM);
+
+    /* A gap without fixes where the device did not move: the trip ends at the last fix before it */
+    drive_north(100);
+    fix(3600, 0.0, 0.0, 0);
+    CHECK_EQ(summaries, 2);
+    check_distance(1000);
+    check_near(field(TRIP_FIELD_DURATION_S), 100, 1);
+    CHECK_EQ(field(TRIP_FIELD_STOPS), 0);
+
+    /* A gap the device drove through is part of the trip */
+    drive_north(100);
+    fix(600, 6000.0, 0.0, 1000);
+    drive_north(100);
+    rest(CONFIG_TRIP_END_S + 1);
+    CHECK_EQ(summaries, 3);
+    check_distance(8000);
+    CHECK_EQ(field(TRIP_FIELD_STOPS), 0);
+
+    /* A speed glitch while parked starts a trip that goes nowhere and is discarded */
+    fix(1, 0.0, 0.0, 500);
+    rest(CONFIG_TRIP_END_S + 1);
+    CHECK_EQ(summaries, 3);
+    /* and the next real trip starts afresh */
+    drive_north(200);
+    rest(CONFIG_TRIP_END_S + 1);
+    CHECK_EQ(summaries, 4);
+    check_distance(2000);
+    check_near(field(TRIP_FIELD_DURATION_S), 200, 2);
+
+    /* East across the antimeridian, about 1 km each side */
+    drive_east(200);
+    CHECK(lon_deg < 0.0);
+    rest(CONFIG_TRIP_END_S + 1);
+    CHECK_EQ(summaries, 5);
+    check_distance(2000);
+    CHECK(field(TRIP_FIELD_START_LON) > 0);
+    CHECK(field(TRIP_FIELD_END_LON) < 0);
+
+    return check_result();
+}
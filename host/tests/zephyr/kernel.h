@@ -0,0 +1,151 @@
+#ifndef _HOST_ZEPHYR_KERNEL_H_
+#define _HOST_ZEPHYR_KERNEL_H_
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <zephyr/sys/util.h>
+
+/* Just enough of the kernel API to run firmware modules on the host, single threaded.
+ * The uptime is whatever the test sets host_uptime_ms to, work items run when submitted,
+ * delayed ones when the test calls host_work_run_due(), locks do nothing and the cycle
+ * counter counts nanoseconds of the monotonic clock.
+ */
+
+#define MSEC_PER_SEC 1000
+#define USEC_PER_SEC 1000000
+#define NSEC_PER_SEC 1000000000
+
+typedef int k_timeout_t;
+#define K_FOREVER (-1)
+#define K_NO_WAIT 0
+
+extern int64_t host_uptime_ms;
+
+static inline int64_t k_uptime_get(void)
+{
+    return host_uptime_ms;
+}
+
+static inline uint32_t k_uptime_get_32(void)
+{
+    return (uint32_t)host_uptime_ms;
+}
+
+uint32_t k_cycle_get_32(void);
+
+static inline uint32_t k_cyc_to_us_floor32(uint32_t cycles)
+{
+    return cycles / 1000;
+}
+
+struct k_mutex
+{
+    int locked;
+};
+
+#define K_MUTEX_DEFINE(name) struct k_mutex name
+
+static inline int k_mutex_lock(struct k_mutex *mutex, k_timeout_t timeout)
+{
+    (void)timeout;
+    mutex->locked++;
+    return 0;
+}
+
+static inline int k_mutex_unlock(struct k_mutex *mutex)
+{
+    mutex->locked--;
+    return 0;
+}
+
+struct k_spinlock
+{
+    int locked;
+};
+
+typedef int k_spinlock_key_t;
+
+static inline k_spinlock_key_t k_spin_lock(struct k_spinlock *lock)
+{
+    return lock->locked++;
+}
+
+static inline void k_spin_unlock(struct k_spinlock *lock, k_spinlock_key_t key)
+{
+    lock->locked = key;
+}
+
+struct k_work;
+typedef void (*k_work_handler_t)(struct k_work *work);
+
+struct k_work
+{
+    k_work_handler_t handler;
+};
+
+#define K_WORK_DEFINE(work, work_handler) struct k_work work = {.handler = work_handler}
+
+static inline int k_work_submit(struct k_work *work)
+{
+    work->handler(work);
+    return 1;
+}
+
+/* Delayed work runs from host_work_run_due(), once the uptime reached its time */
+struct k_work_delayable
+{
+    struct k_work work;
+    int64_t due_ms;
+    bool scheduled;
+};
+
+#define K_WORK_DELAYABLE_DEFINE(dwork, work_handler)                                                                   \
+    struct k_work_delayable dwork = {.work = {.handler = work_handler}}
+#define K_MSEC(ms) (ms)
+
+int k_work_reschedule(struct k_work_delayable *dwork, k_timeout_t delay);
+
+/**@brief Run the delayed work that is due, including what it schedules for now.
+ */
+void host_work_run_due(void);
+
+typedef long atomic_t;
+typedef long atomic_val_t;
+
+#define ATOMIC_BITS (sizeof(atomic_val_t) * 8)
+#define ATOMIC_BITMAP_SIZE(num_bits) (((num_bits) + ATOMIC_BITS - 1) / ATOMIC_BITS)
+#define ATOMIC_DEFINE(name, num_bits) atomic_t name[ATOMIC_BITMAP_SIZE(num_bits)]
+
+static inline atomic_val_t atomic_get(const atomic_t *target)
+{
+    return *target;
+}
+
+static inline bool atomic_test_bit(const atomic_t *target, int bit)
+{
+    return (target[bit / ATOMIC_BITS] >> (bit % ATOMIC_BITS)) & 1;
+}
+
+static inline void atomic_set_bit(atomic_t *target, int bit)
+{
+    target[bit / ATOMIC_BITS] |= 1UL << (bit % ATOMIC_BITS);
+}
+
+static inline void atomic_clear_bit(atomic_t *target, int bit)
+{
+    target[bit / ATOMIC_BITS] &= ~(1UL << (bit % ATOMIC_BITS));
+}
+
+static inline bool atomic_test_and_set_bit(atomic_t *target, int bit)
+{
+    bool was = atomic_test_bit(target, bit);
+
+    atomic_set_bit(target, bit);
+    return was;
+}
+
+#endif /* _HOST_ZEPHYR_KERNEL_H_ */
@@ -0,0 +1,42 @@
+#ifndef _HOST_ZEPHYR_SETTINGS_SETTINGS_H_
+#define _HOST_ZEPHYR_SETTINGS_SETTINGS_H_
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/* Settings writes are only counted, a test replays stored values through the handler */
+
+typedef ssize_t (*settings_read_cb)(void *cb_arg, void *data, size_t len);
+
+struct settings_handler_static
+{
+    const char *name;
+    int (*h_get)(const char *key, char *val, int val_len_max);
+    int (*h_set)(const char *key, size_t len, settings_read_cb read_cb, void *cb_arg);
+    int (*h_commit)(void);
+    int (*h_export)(int (*export_func)(const char *name, const void *val, size_t val_len));
+};
+
+#define SETTINGS_STATIC_HANDLER_DEFINE(_hname, _tree, _get, _set, _commit, _export)                                    \
+    const struct settings_handler_static settings_handler_##_hname = {_tree, _get, _set, _commit, _export}
+
+extern unsigned int host_settings_saves;
+extern unsigned int host_settings_deletes;
+
+static inline int settings_save_one(const char *name, const void *value, size_t val_len)
+{
+    (void)name;
+    (void)value;
+    (void)val_len;
+    host_settings_saves++;
+    return 0;
+}
+
+static inline int settings_delete(const char *name)
+{
+    (void)name;
+    host_settings_deletes++;
+    return 0;
+}
+
+#endif /* _HOST_ZEPHYR_SETTINGS_SETTINGS_H_ */
@@ -0,0 +1,13 @@
+#ifndef _HOST_ZEPHYR_SYS_UTIL_H_
+#define _HOST_ZEPHYR_SYS_UTIL_H_
+
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+#define MAX(a, b) (((a) > (b)) ? (a) : (b))
+#define CLAMP(val, low, high) (((val) <= (low)) ? (low) : MIN(val, high))
+#define BIT(n) (1UL << (n))
+#define BIT64(n) (1ULL << (n))
+#define BIT_MASK(n) (BIT(n) - 1UL)
+#define ARRAY_SIZE(array) (sizeof(array) / sizeof((array)[0]))
+#define BUILD_ASSERT(expr, msg) _Static_assert(expr, msg)
+
+#endif /* _HOST_ZEPHYR_SYS_UTIL_H_ */
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#if defined(CONFIG_ARCH_POSIX)
+#include <nsi_main.h>
+#endif
+
+#include "../../src/datatypes/datatypes.h"
+#include "../../src/datatypes/shadow_delta.h"
+#include "../../src/gnss/gnss.h"
+#include "../../src/gnss/gnss_stats.h"
+#include "../../src/pmic/pmic.h"
+#include "../../src/sensors/bme680.h"
+#include "../../src/trace/trace.h"
+#include "../../src/trip/trip.h"
+
+LOG_MODULE_REGISTER(replay, LOG_LEVEL_INF);
+
+/* The processing functions write here, like on target */
+device_shadow_t g_device_state;
+
+static const uint8_t trace[] = {
+#include "trace.inc"
+};
+
+#if defined(CONFIG_TRIP)
+/* What the device would publish, to check against the recorded track */
+static void trip_summary_log(const struct trip_summary *summary)
+{
+    uint8_t record[TRIP_SUMMARY_LEN];
+    const int64_t *v = summary->values;
+
+    LOG_INF("Trip: %u m in %u s, avg %u cm/s, max %u cm/s, %u stops (%u s, longest %u s), %u fixes",
+            (uint32_t)v[TRIP_FIELD_DISTANCE_M], (uint32_t)v[TRIP_FIELD_DURATION_S],
+            (uint32_t)v[TRIP_FIELD_AVG_SPEED_CMS], (uint32_t)v[TRIP_FIELD_MAX_SPEED_CMS],
+            (uint32_t)v[TRIP_FIELD_STOPS], (uint32_t)v[TRIP_FIELD_STOPPED_S],
+            (uint32_t)v[TRIP_FIELD_LONGEST_STOP_S], (uint32_t)v[TRIP_FIELD_FIXES]);
+    if (trip_summary_encode(summary, record, sizeof(record)) > 0)
+    {
+        LOG_HEXDUMP_INF(record, sizeof(record), "Trip summary:");
+    }
+}
+#endif
+
+#if CONFIG_REPLAY_SHADOW_REPORT_INTERVAL_S > 0
+static struct
+{
+    uint32_t sent;
+    uint32_t skipped;
+    uint32_t bytes;
+    uint32_t full_bytes; // had every interval sent the full shadow
+} shadow_reports;
+
+/* What the device's scheduled_report() would publish at this point of the trace */
+static void shadow_report_replay(void)
+{
+    char json[DEVICE_MSG_LEN];
+    int len = device_to_json(json, sizeof(json), &g_device_state);
+
+    if (len > 0)
+    {
+        shadow_reports.full_bytes += len;
+    }
+
+    len = shadow_report_build(&g_device_state, json, sizeof(json), false);
+    if (len < 0)
+    {
+        return;
+    }
+    if (shadow_report_empty())
+    {
+        shadow_reports.skipped++;
+        return;
+    }
+    shadow_reports.sent++;
+    shadow_reports.bytes += len;
+    shadow_report_sent(0);
+}
+
+/* @return false if the reports cost more than CONFIG_REPLAY_SHADOW_MAX_PCT of full ones */
+static bool shadow_reports_check(void)
+{
+    uint32_t intervals = shadow_reports.sent + shadow_reports.skipped;
+
+    if (intervals == 0)
+    {
+        return true;
+    }
+
+    LOG_INF("Shadow reports every %d s: %u sent, %u skipped, %u bytes/report, %u bytes/interval "
+            "against %u for full reports",
+            CONFIG_REPLAY_SHADOW_REPORT_INTERVAL_S, shadow_reports.sent, shadow_reports.skipped,
+            shadow_report_avg_len(), shadow_reports.bytes / intervals, shadow_reports.full_bytes / intervals);
+    if ((uint64_t)shadow_reports.bytes * 100 > (uint64_t)shadow_reports.full_bytes * CONFIG_REPLAY_SHADOW_MAX_PCT)
+    {
+        LOG_ERR("Shadow reports take %u%% of full reports, more than %d%%",
+                (uint32_t)((uint64_t)shadow_reports.bytes * 100 / shadow_reports.full_bytes),
+                CONFIG_REPLAY_SHADOW_MAX_PCT);
+        return false;
+    }
+    return true;
+}
+#endif
+
+int main(void)
+{
+    struct trace_reader reader;
+    struct trace_record rec;
+    struct nrf_modem_gnss_pvt_data_frame pvt;
+    struct sensor_value values[AQI_CHAN_COUNT];
+    uint32_t pvt_count = 0, fix_count = 0, aqi_count = 0, soc_count = 0;
+    int64_t start = k_uptime_get();
+    char json[DEVICE_MSG_LEN];
+    uint8_t summary[GNSS_STATS_SUMMARY_LEN];
+    bool passed = true;
+    int err;
+#if CONFIG_REPLAY_SHADOW_REPORT_INTERVAL_S > 0
+    uint32_t next_report_ms = CONFIG_REPLAY_SHADOW_REPORT_INTERVAL_S * MSEC_PER_SEC;
+#endif
+
+#if defined(CONFIG_TRIP)
+    trip_init(trip_summary_log);
+#endif
+
+    err = trace_reader_init(&reader, trace, sizeof(trace));
+    if (err)
+    {
+        LOG_ERR("Not a usable trace: %d", err);
+        goto out;
+    }
+
+    while ((err = trace_read(&reader, &rec)) == 0)
+    {
+        if (CONFIG_REPLAY_SPEEDUP > 0)
+        {
+            k_sleep(K_TIMEOUT_ABS_MS(start + rec.time_ms / CONFIG_REPLAY_SPEEDUP));
+        }
+#if CONFIG_REPLAY_SHADOW_REPORT_INTERVAL_S > 0
+        for (; next_report_ms <= rec.time_ms; next_report_ms += CONFIG_REPLAY_SHADOW_REPORT_INTERVAL_S * MSEC_PER_SEC)
+        {
+            shadow_report_replay();
+        }
+#endif
+
+        switch (rec.type)
+        {
+        case TRACE_PVT:
+            memcpy(&pvt, rec.data, sizeof(pvt));
+            pvt_count++;
+            if (gnss_pvt_process(&pvt))
+            {
+                fix_count++;
+            }
+            break;
+        case TRACE_AQI:
+            trace_aqi_get(&rec, values);
+            aqi_count++;
+            aqi_sample_process(values);
+            break;
+        case TRACE_SOC:
+            soc_count++;
+            battery_soc_process(rec.data[0]);
+            break;
+        }
+    }
+    if (err != -ENODATA)
+    {
+        LOG_ERR("Trace corrupt at offset %u", (unsigned int)reader.pos);
+    }
+
+    LOG_INF("Replayed %u PVT frames (%u fixes), %u AQI samples, %u SOC readings over %u ms",
+            pvt_count, fix_count, aqi_count, soc_count, reader.time_ms);
+    if (device_to_json(json, sizeof(json), &g_device_state) > 0)
+    {
+        LOG_INF("Final state: %s", json);
+    }
+    if (gnss_stats_summary_build(summary, sizeof(summary)) > 0)
+    {
+        LOG_HEXDUMP_INF(summary, sizeof(summary), "GNSS stats summary:");
+    }
+#if CONFIG_REPLAY_SHADOW_REPORT_INTERVAL_S > 0
+    passed = shadow_reports_check();
+#endif
+
+out:
+#if defined(CONFIG_ARCH_POSIX)
+    nsi_exit(err == -ENODATA && passed ? 0 : 1);
+#endif
+    return 0;
+}
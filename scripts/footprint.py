@@ -0,0 +1,70 @@
+#!/usr/bin/env python3
+"""Flash and RAM per application module (src/<module>/), from Zephyr's size reports.
+
+Run through the build: west build -t module_footprint
+One json line per module, grep for FOOTPRINT to collect the results. Compare a
+default build with -DEXTRA_CONF_FILE=overlay-footprint.conf to see what the
+profile saves; libc and the rest of the image are reported as their own lines.
+"""
+
+import json
+import os
+import sys
+
+
+def module_of(identifier, app_src):
+    """src/<module>/<file>.c -> module, src/main.c -> main, None if not an application file"""
+    path = "/" + identifier.replace("\\", "/").lstrip("/")
+    idx = path.rfind("/src/")
+    if idx < 0:
+        return None
+    rel = path[idx + len("/src/"):]
+    if not os.path.isfile(os.path.join(app_src, rel)):
+        return None
+    parts = rel.split("/")
+    return parts[0] if len(parts) > 1 else os.path.splitext(parts[0])[0]
+
+
+def is_libc(identifier):
+    return any(name in identifier for name in ("picolibc", "newlib", "/libc/"))
+
+
+def walk(node, app_src, totals):
+    identifier = node.get("identifier", "")
+    module = module_of(identifier, app_src)
+    if module is not None:
+        totals[module] = totals.get(module, 0) + node["size"]
+        return
+    children = node.get("children")
+    if not children:
+        key = "(libc)" if is_libc(identifier) else "(rest)"
+        totals[key] = totals.get(key, 0) + node["size"]
+        return
+    for child in children:
+        walk(child, app_src, totals)
+
+
+def load(path, app_src):
+    with open(path) as f:
+        report = json.load(f)
+    totals = {}
+    walk(report["symbols"], app_src, totals)
+    return totals
+
+
+def main():
+    if len(sys.argv) != 4:
+        sys.exit("usage: footprint.py <app src dir> <rom.json> <ram.json>")
+    app_src = sys.argv[1]
+    rom = load(sys.argv[2], app_src)
+    ram = load(sys.argv[3], app_src)
+
+    for module in sorted(set(rom) | set(ram), key=lambda m: (m.startswith("("), m)):
+        line = {"module": module, "rom": rom.get(module, 0), "ram": ram.get(module, 0)}
+        print("FOOTPRINT " + json.dumps(line, separators=(",", ":")))
+    total = {"module": "total", "rom": sum(rom.values()), "ram": sum(ram.values())}
+    print("FOOTPRINT " + json.dumps(total, separators=(",", ":")))
+
+
+if __name__ == "__main__":
+    main()
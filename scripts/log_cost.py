@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+"""CPU and RAM spent on logging, measured by replaying one trace on native_sim.
+
+Builds replay/ at each given git revision with deferred logging, as on the device,
+runs it under callgrind and prints one json line per revision, grep for LOGCOST:
+  scripts/log_cost.py trace.bin <revision>...
+instructions covers the whole replay, log_instructions the part spent in the logging
+subsystem and its formatting, ram is the image's writable data (.data, .bss, noinit).
+Needs west in a Zephyr/NCS workspace, valgrind and callgrind_annotate.
+"""
+
+import json
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+BOARD = "native_sim/native/64"
+
+# Self cost of these functions is logging: message creation, the deferred queue, the
+# backend and cbprintf formatting
+LOG_FUNCTION = re.compile(r"(^|[\s:])(z_log|log_|z_impl_z_log|cbvprintf|cbprintf|z_cbvprintf|cbpprintf)")
+ANNOTATE_LINE = re.compile(r"^\s*([\d,]+)\s+(?:\([^)]*\)\s+)?(\S.*)$")
+
+
+def run(args, **kwargs):
+    return subprocess.run(args, check=True, **kwargs)
+
+
+def build(worktree, trace):
+    build_dir = os.path.join(worktree, "build_replay")
+    run(["west", "build", "-b", BOARD, "-p", "always", "-d", build_dir, os.path.join(worktree, "replay"), "--",
+         "-DTRACE_FILE=" + trace, "-DCONFIG_REPLAY_SPEEDUP=0",
+         "-DCONFIG_LOG_MODE_IMMEDIATE=n", "-DCONFIG_LOG_MODE_DEFERRED=y"],
+        stdout=subprocess.DEVNULL)
+    return os.path.join(build_dir, "zephyr", "zephyr.exe")
+
+
+def instructions(exe, out_file):
+    run(["valgrind", "--tool=callgrind", "--callgrind-out-file=" + out_file, exe],
+        stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    annotate = run(["callgrind_annotate", "--threshold=100", out_file],
+                   stdout=subprocess.PIPE, text=True).stdout
+    total = 0
+    logging = 0
+    for line in annotate.splitlines():
+        match = ANNOTATE_LINE.match(line)
+        if not match:
+            continue
+        count = int(match.group(1).replace(",", ""))
+        if "PROGRAM TOTALS" in match.group(2):
+            total = count
+        elif LOG_FUNCTION.search(match.group(2)):
+            logging += count
+    return total, logging
+
+
+def ram(exe):
+    sections = run(["readelf", "-S", "-W", exe], stdout=subprocess.PIPE, text=True).stdout
+    size = 0
+    for line in sections.splitlines():
+        fields = line.replace("[ ", "[").split()
+        # [Nr] Name Type Address Off Size ES Flg ...
+        if len(fields) > 7 and fields[0].startswith("[") and "W" in fields[7] and "A" in fields[7]:
+            size += int(fields[5], 16)
+    return size
+
+
+def measure(revision, trace, repo):
+    with tempfile.TemporaryDirectory() as tmp:
+        worktree = os.path.join(tmp, "tree")
+        run(["git", "-C", repo, "worktree", "add", "--detach", worktree, revision], stdout=subprocess.DEVNULL)
+        try:
+            exe = build(worktree, trace)
+            total, logging = instructions(exe, os.path.join(tmp, "callgrind.out"))
+            return {"revision": revision, "instructions": total, "log_instructions": logging, "ram": ram(exe)}
+        finally:
+            run(["git", "-C", repo, "worktree", "remove", "--force", worktree])
+
+
+def main():
+    if len(sys.argv) < 3:
+        sys.exit("usage: log_cost.py <trace.bin> <revision>...")
+    trace = os.path.abspath(sys.argv[1])
+    repo = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+    for revision in sys.argv[2:]:
+        line = measure(revision, trace, repo)
+        print("LOGCOST " + json.dumps(line, separators=(",", ":")), flush=True)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+"""Image size of the default build against the footprint profile (overlay-footprint.conf).
+
+Builds the application once per profile and prints one json line each, grep for PROFILE:
+  scripts/profile_compare.py [board]
+flash is what the application image loads into flash (code, rodata and data initialisers),
+ram its static RAM (data, bss, noinit), bin the size of zephyr.bin. Boot time needs the
+device: flash each build and read "Main reached ... us after boot" from the log.
+"""
+
+import glob
+import json
+import os
+import subprocess
+import sys
+
+PROFILES = {
+    "default": [],
+    "footprint": ["-DEXTRA_CONF_FILE=overlay-footprint.conf"],
+}
+
+
+def app_image(build_dir, app_name):
+    """zephyr/ of the application, under build_dir/<app>/ with sysbuild"""
+    for path in (os.path.join(build_dir, app_name, "zephyr"), os.path.join(build_dir, "zephyr")):
+        if os.path.isfile(os.path.join(path, "zephyr.elf")):
+            return path
+    found = glob.glob(os.path.join(build_dir, "*", "zephyr", "zephyr.elf"))
+    if not found:
+        sys.exit("no zephyr.elf under " + build_dir)
+    return os.path.dirname(found[0])
+
+
+def sizes(elf):
+    sections = subprocess.run(["readelf", "-S", "-W", elf], check=True, stdout=subprocess.PIPE,
+                              text=True).stdout
+    flash = 0
+    ram = 0
+    for line in sections.splitlines():
+        fields = line.replace("[ ", "[").split()
+        # [Nr] Name Type Address Off Size ES Flg ...
+        if len(fields) < 8 or not fields[0].startswith("[") or "A" not in fields[7]:
+            continue
+        size = int(fields[5], 16)
+        if "W" in fields[7]:
+            ram += size
+        if fields[2] != "NOBITS":
+            flash += size
+    return flash, ram
+
+
+def main():
+    board = sys.argv[1] if len(sys.argv) > 1 else "thingy91/nrf9160/ns"
+    app = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+    for profile, args in PROFILES.items():
+        build_dir = os.path.join(app, "build_profile_" + profile)
+        subprocess.run(["west", "build", "-b", board, "-p", "always", "-d", build_dir, app, "--"] + args,
+                       check=True, stdout=subprocess.DEVNULL)
+        image = app_image(build_dir, os.path.basename(app))
+        flash, ram = sizes(os.path.join(image, "zephyr.elf"))
+        line = {"profile": profile, "board": board, "flash": flash, "ram": ram,
+                "bin": os.path.getsize(os.path.join(image, "zephyr.bin"))}
+        print("PROFILE " + json.dumps(line, separators=(",", ":")), flush=True)
+
+
+if __name__ == "__main__":
+    main()
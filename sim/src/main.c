@@ -0,0 +1,466 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/logging/log.h>
+
+#if defined(CONFIG_ARCH_POSIX)
+#include <nsi_main.h>
+#endif
+
+#include "../../src/datatypes/datatypes.h"
+#include "../../src/datatypes/json_writer.h"
+#include "../../src/mqtt/mqtt_connection.h"
+#include "../../src/gnss/gnss.h"
+#include "../../src/pmic/pmic.h"
+
+BUILD_ASSERT(IS_ENABLED(CONFIG_MQTT_TRANSPORT_TCP), "The simulator drives MQTT over TCP");
+
+LOG_MODULE_REGISTER(nrf9160_mqtt_gnss, LOG_LEVEL_WRN);
+
+/* The processing functions write here; every device swaps its own state in and out */
+device_shadow_t g_device_state;
+
+#define METERS_PER_DEG_LAT 111320.0
+#define SIM_SV_COUNT 8
+/* Battery drain, one percent every this many reports */
+#define REPORTS_PER_SOC_PERCENT 20
+/* Margin between keepalive and TAU, like CONFIG_MQTT_KEEPALIVE_PSM_MARGIN_S */
+#define KEEPALIVE_PSM_MARGIN_S 60
+
+struct sim_device
+{
+	app_mqtt_client_t client;
+	/* mqtt_transport_tcp.c has one pair of buffers for its one client */
+	uint8_t rx_buf[CONFIG_MQTT_MESSAGE_BUFFER_SIZE];
+	uint8_t tx_buf[CONFIG_MQTT_MESSAGE_BUFFER_SIZE];
+	char client_id[CLIENT_ID_LEN + 1];
+	device_shadow_t shadow;
+	bool connected;
+	/* Trajectory */
+	double lat;
+	double lon;
+	double heading; // rad
+	double speed;	// m/s
+	uint8_t soc;
+	uint32_t reports;
+	/* Schedule, in uptime ms */
+	int64_t connect_at;
+	int64_t report_at;
+	int64_t fix_at;
+	int64_t last_tx;
+	bool waking;
+};
+
+static struct sim_device devices[CONFIG_SIM_DEVICES];
+static struct pollfd fds[CONFIG_SIM_DEVICES];
+static struct sim_device *fds_device[CONFIG_SIM_DEVICES];
+
+static struct
+{
+	uint32_t publishes;
+	uint32_t acked;
+	uint32_t failed;
+	uint32_t fixes;
+	uint32_t connects;
+	uint32_t drops;
+	uint32_t disconnects;
+	uint64_t latency_total_us;
+	uint32_t latency_max_us;
+} totals;
+
+/* Message ids are unique across devices, they all come from message_id_next() */
+static uint32_t sent_at[UINT16_MAX + 1];
+static uint32_t rng_state = CONFIG_SIM_SEED ? CONFIG_SIM_SEED : 1;
+
+/* xorshift32, reproducible runs for a given CONFIG_SIM_SEED */
+static uint32_t rng(void)
+{
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= rng_state << 5;
+	return rng_state;
+}
+
+static uint32_t rng_range(uint32_t max)
+{
+	return max ? rng() % max : 0;
+}
+
+static double rng_unit(void)
+{
+	return (double)rng() / UINT32_MAX;
+}
+
+/* +-10 % around interval_ms, so devices with the same configuration drift apart */
+static int64_t jittered(uint32_t interval_ms)
+{
+	return interval_ms - interval_ms / 10 + rng_range(interval_ms / 5 + 1);
+}
+
+static void puback_handler(uint16_t message_id)
+{
+	uint32_t latency_us = k_cyc_to_us_floor32(k_cycle_get_32() - sent_at[message_id]);
+
+	totals.acked++;
+	totals.latency_total_us += latency_us;
+	totals.latency_max_us = MAX(totals.latency_max_us, latency_us);
+}
+
+/* Uptime counts from an arbitrary recent date */
+#define SIM_EPOCH_DAYS 20089 // 2025-01-01
+
+/* Calendar date of the day `days` after 1970-01-01 (Howard Hinnant's civil_from_days) */
+static void date_from_days(int32_t days, struct nrf_modem_gnss_datetime *dt)
+{
+	int32_t z = days + 719468;
+	int32_t era = z / 146097;
+	uint32_t doe = z - era * 146097;
+	uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	uint32_t mp = (5 * doy + 2) / 153;
+
+	dt->day = doy - (153 * mp + 2) / 5 + 1;
+	dt->month = mp < 10 ? mp + 3 : mp - 9;
+	dt->year = yoe + era * 400 + (dt->month <= 2);
+}
+
+/* Advance the trajectory to now and run the frame through the application's PVT processing */
+static void device_fix(struct sim_device *dev, int64_t now)
+{
+	struct nrf_modem_gnss_pvt_data_frame pvt = {0};
+	double dist = dev->speed * CONFIG_SIM_FIX_INTERVAL_S;
+	int64_t day_ms = now % (24 * 60 * 60 * MSEC_PER_SEC);
+
+	/* Wander: small heading changes, the odd stop */
+	dev->heading += (rng_unit() - 0.5) * 0.6;
+	dev->speed = CLAMP(dev->speed + (rng_unit() - 0.5) * 2.0, 0.0, 15.0);
+	dev->lat += dist * cos(dev->heading) / METERS_PER_DEG_LAT;
+	dev->lon += dist * sin(dev->heading) / (METERS_PER_DEG_LAT * cos(dev->lat * M_PI / 180.0));
+
+	date_from_days(SIM_EPOCH_DAYS + now / (24 * 60 * 60 * MSEC_PER_SEC), &pvt.datetime);
+	pvt.datetime.hour = day_ms / (60 * 60 * MSEC_PER_SEC);
+	pvt.datetime.minute = day_ms / (60 * MSEC_PER_SEC) % 60;
+	pvt.datetime.seconds = day_ms / MSEC_PER_SEC % 60;
+	pvt.datetime.ms = day_ms % MSEC_PER_SEC;
+
+	pvt.latitude = dev->lat;
+	pvt.longitude = dev->lon;
+	pvt.altitude = 40.0f + (float)rng_range(100) / 10.0f;
+	pvt.flags = NRF_MODEM_GNSS_PVT_FLAG_FIX_VALID;
+	for (int i = 0; i < SIM_SV_COUNT; i++)
+	{
+		pvt.sv[i].sv = 1 + rng_range(32);
+		pvt.sv[i].signal = 1;
+		pvt.sv[i].cn0 = 250 + rng_range(200);
+		pvt.sv[i].flags = NRF_MODEM_GNSS_SV_FLAG_USED_IN_FIX;
+	}
+
+	g_device_state = dev->shadow;
+	gnss_pvt_process(&pvt);
+	dev->shadow = g_device_state;
+	totals.fixes++;
+}
+
+static void device_connect(struct sim_device *dev, int64_t now)
+{
+	int keepalive_s = CLAMP(CONFIG_SIM_PSM_TAU_S - KEEPALIVE_PSM_MARGIN_S, 60, UINT16_MAX);
+	int err;
+
+	client_keepalive_set(&dev->client, keepalive_s);
+	err = client_connect(&dev->client);
+	if (err)
+	{
+		LOG_WRN("%s: connect failed: %d", dev->client_id, err);
+		dev->connect_at = now + CONFIG_SIM_RECONNECT_DELAY_S * MSEC_PER_SEC;
+		return;
+	}
+
+	dev->connected = true;
+	dev->last_tx = now;
+	dev->report_at = now + jittered(CONFIG_SIM_REPORT_INTERVAL_S * MSEC_PER_SEC);
+	totals.connects++;
+}
+
+/* Coverage lost or the broker hung up: the connection is gone without a DISCONNECT */
+static void device_drop(struct sim_device *dev, int64_t now)
+{
+	mqtt_abort(&dev->client);
+	dev->connected = false;
+	dev->connect_at = now + CONFIG_SIM_RECONNECT_DELAY_S * MSEC_PER_SEC;
+}
+
+static void device_report(struct sim_device *dev, int64_t now)
+{
+	size_t size;
+	uint8_t *json = data_publish_buf_get(&size);
+	int len;
+	int err;
+
+	/* Out of PSM, the RRC connection has to be set up first */
+	if (!dev->waking && now - dev->last_tx > CONFIG_SIM_PSM_ACTIVE_TIME_S * MSEC_PER_SEC)
+	{
+		dev->waking = true;
+		dev->report_at = now + CONFIG_SIM_WAKEUP_LATENCY_MS;
+		return;
+	}
+	dev->waking = false;
+	dev->report_at = now + jittered(CONFIG_SIM_REPORT_INTERVAL_S * MSEC_PER_SEC);
+
+	if (++dev->reports % REPORTS_PER_SOC_PERCENT == 0 && dev->soc > 0)
+	{
+		dev->soc--;
+	}
+	g_device_state = dev->shadow;
+	battery_soc_process(dev->soc);
+	dev->shadow = g_device_state;
+
+	len = device_to_json((char *)json, size, &dev->shadow);
+	if (len < 0)
+	{
+		totals.failed++;
+		return;
+	}
+
+	err = data_publish(&dev->client, MQTT_QOS_1_AT_LEAST_ONCE, json, len);
+	if (err)
+	{
+		/* -ENOTCONN until the CONNACK is in */
+		totals.failed++;
+		return;
+	}
+	sent_at[data_publish_last_id()] = k_cycle_get_32();
+	dev->last_tx = now;
+	totals.publishes++;
+
+	if (rng_range(1000) < CONFIG_SIM_DROP_PERMILLE)
+	{
+		totals.drops++;
+		device_drop(dev, now);
+	}
+}
+
+static void device_init(struct sim_device *dev, int index, int64_t now)
+{
+	/* Derived like client_id_get(): "nrf-" followed by the 15 digit IMEI */
+	snprintf(dev->client_id, sizeof(dev->client_id), "nrf-%s%07d", CONFIG_SIM_IMEI_PREFIX, index);
+
+	dev->client.client_id.utf8 = (uint8_t *)dev->client_id;
+	dev->client.client_id.size = strlen(dev->client_id);
+	dev->client.rx_buf = dev->rx_buf;
+	dev->client.rx_buf_size = sizeof(dev->rx_buf);
+	dev->client.tx_buf = dev->tx_buf;
+	dev->client.tx_buf_size = sizeof(dev->tx_buf);
+
+	/* Spread the devices over a few km around the origin */
+	dev->lat = CONFIG_SIM_ORIGIN_LAT_UDEG / 1e6 + (rng_unit() - 0.5) * 0.05;
+	dev->lon = CONFIG_SIM_ORIGIN_LON_UDEG / 1e6 + (rng_unit() - 0.5) * 0.1;
+	dev->heading = rng_unit() * 2 * M_PI;
+	dev->speed = rng_unit() * 10.0;
+	dev->soc = 50 + rng_range(51);
+
+	dev->connect_at = now + rng_range(CONFIG_SIM_STARTUP_SPREAD_S * MSEC_PER_SEC + 1);
+	dev->fix_at = dev->connect_at + rng_range(CONFIG_SIM_FIX_INTERVAL_S * MSEC_PER_SEC);
+}
+
+static void stats_print(const char *label, uint32_t elapsed_ms, uint32_t window_publishes, uint32_t window_ms)
+{
+	const struct mqtt_transport_stats *stats = mqtt_transport_stats_get();
+	struct json_writer w;
+	char json[320];
+	int connected = 0;
+
+	for (int i = 0; i < CONFIG_SIM_DEVICES; i++)
+	{
+		connected += devices[i].connected;
+	}
+
+	json_writer_init(&w, json, sizeof(json));
+	json_add_int(&w, "t_s", elapsed_ms / MSEC_PER_SEC);
+	json_add_int(&w, "devices", CONFIG_SIM_DEVICES);
+	json_add_int(&w, "connected", connected);
+	json_add_int(&w, "publishes", totals.publishes);
+	json_add_int(&w, "acked", totals.acked);
+	json_add_int(&w, "failed", totals.failed);
+	json_add_fixed(&w, "msg_per_s", (int32_t)((uint64_t)window_publishes * 10 * MSEC_PER_SEC / MAX(window_ms, 1)), 1);
+	json_add_int(&w, "ack_avg_us", totals.acked ? (int32_t)(totals.latency_total_us / totals.acked) : 0);
+	json_add_int(&w, "ack_max_us", totals.latency_max_us);
+	json_add_int(&w, "fixes", totals.fixes);
+	json_add_int(&w, "connects", totals.connects);
+	json_add_int(&w, "drops", totals.drops);
+	json_add_int(&w, "disconnects", totals.disconnects);
+	json_add_int(&w, "tx_bytes", stats->tx_bytes);
+	json_add_int(&w, "rx_bytes", stats->rx_bytes);
+	if (json_writer_finish(&w) < 0)
+	{
+		return;
+	}
+
+	/* grep for SIM to collect the results */
+	printk("%s %s\n", label, json);
+}
+
+/* Run whatever is due and return the time of the next scheduled action */
+static int64_t devices_run(int64_t now)
+{
+	int64_t next = now + CONFIG_SIM_STATS_INTERVAL_S * MSEC_PER_SEC;
+
+	for (int i = 0; i < CONFIG_SIM_DEVICES; i++)
+	{
+		struct sim_device *dev = &devices[i];
+
+		/* GNSS runs whether or not the device is connected */
+		if (now >= dev->fix_at)
+		{
+			device_fix(dev, now);
+			dev->fix_at = now + CONFIG_SIM_FIX_INTERVAL_S * MSEC_PER_SEC;
+		}
+		next = MIN(next, dev->fix_at);
+
+		if (!dev->connected)
+		{
+			if (now >= dev->connect_at)
+			{
+				device_connect(dev, now);
+			}
+			next = MIN(next, dev->connected ? dev->report_at : dev->connect_at);
+			continue;
+		}
+
+		if (now >= dev->report_at)
+		{
+			device_report(dev, now);
+		}
+		if (dev->connected)
+		{
+			int keepalive_left = client_keepalive_time_left(&dev->client);
+
+			next = MIN(next, dev->report_at);
+			if (keepalive_left >= 0)
+			{
+				next = MIN(next, now + keepalive_left);
+			}
+		}
+	}
+	return next;
+}
+
+/* Poll the connections until `until`, handling input and keepalives */
+static void connections_service(int64_t now, int64_t until)
+{
+	int count = 0;
+	int err;
+
+	for (int i = 0; i < CONFIG_SIM_DEVICES; i++)
+	{
+		if (devices[i].connected && fds_init(&devices[i].client, &fds[count]) == 0)
+		{
+			fds_device[count++] = &devices[i];
+		}
+	}
+
+	if (count == 0)
+	{
+		k_sleep(K_MSEC(MAX(until - now, 0)));
+		return;
+	}
+
+	err = poll(fds, count, (int)MAX(until - now, 0));
+	if (err < 0)
+	{
+		LOG_ERR("poll: %d", errno);
+		k_sleep(K_MSEC(100));
+		return;
+	}
+
+	now = k_uptime_get();
+	for (int i = 0; i < count; i++)
+	{
+		struct sim_device *dev = fds_device[i];
+
+		err = 0;
+		if ((fds[i].revents & POLLIN) == POLLIN)
+		{
+			err = client_input(&dev->client);
+		}
+		if (err == 0 && (fds[i].revents & (POLLERR | POLLNVAL | POLLHUP)) != 0)
+		{
+			err = -EIO;
+		}
+		if (err == 0)
+		{
+			err = client_live(&dev->client);
+			err = (err == -EAGAIN) ? 0 : err;
+		}
+		if (err)
+		{
+			LOG_WRN("%s: connection lost: %d", dev->client_id, err);
+			totals.disconnects++;
+			device_drop(dev, now);
+		}
+	}
+}
+
+int main(void)
+{
+	int64_t start = k_uptime_get();
+	int64_t end = start + CONFIG_SIM_DURATION_S * MSEC_PER_SEC;
+	int64_t stats_at = start + CONFIG_SIM_STATS_INTERVAL_S * MSEC_PER_SEC;
+	uint32_t window_publishes = 0;
+	int64_t window_start = start;
+	int err = 0;
+
+	data_publish_puback_cb_set(puback_handler);
+
+	for (int i = 0; i < CONFIG_SIM_DEVICES; i++)
+	{
+		/* Resolves the broker and sets up the client like on target, then gets its own identity */
+		err = client_init(&devices[i].client);
+		if (err)
+		{
+			LOG_ERR("Failed to initialize MQTT client %d: %d", i, err);
+			goto out;
+		}
+		device_init(&devices[i], i, start);
+	}
+
+	while (k_uptime_get() < end)
+	{
+		int64_t now = k_uptime_get();
+		int64_t next = MIN(devices_run(now), MIN(stats_at, end));
+
+		connections_service(now, next);
+
+		now = k_uptime_get();
+		if (now >= stats_at)
+		{
+			stats_print("SIM", now - start, totals.publishes - window_publishes, now - window_start);
+			window_publishes = totals.publishes;
+			window_start = now;
+			stats_at = now + CONFIG_SIM_STATS_INTERVAL_S * MSEC_PER_SEC;
+		}
+	}
+
+	for (int i = 0; i < CONFIG_SIM_DEVICES; i++)
+	{
+		if (devices[i].connected)
+		{
+			client_disconnect(&devices[i].client);
+			devices[i].connected = false;
+		}
+	}
+	stats_print("SIM_TOTAL", k_uptime_get() - start, totals.publishes, k_uptime_get() - start);
+
+out:
+#if defined(CONFIG_ARCH_POSIX)
+	nsi_exit(err ? 1 : 0);
+#endif
+	return 0;
+}
@@ -0,0 +1,164 @@
+#include <errno.h>
+#include <stdbool.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "remote_config.h"
+#include "../pmic/pmic.h"
+#include "../sensors/bme680.h"
+
+LOG_MODULE_REGISTER(remote_config, LOG_LEVEL_INF);
+
+#define SETTINGS_KEY "rcfg/cfg"
+
+static struct remote_config config = {
+    .version = 0,
+    .gnss_interval_s = CONFIG_GNSS_PERIODIC_INTERVAL,
+    .gnss_timeout_s = CONFIG_GNSS_PERIODIC_TIMEOUT,
+    .sensor_interval_ms = SENSOR_SAMPLE_INTERVAL_MS,
+    .battery_interval_ms = BATTERY_SAMPLE_INTERVAL_MS,
+    .reconnect_delay_s = CONFIG_MQTT_RECONNECT_DELAY_S,
+};
+static remote_config_apply_cb_t apply_cb;
+
+static bool value_valid(enum remote_config_key key, uint32_t value)
+{
+    switch (key)
+    {
+    case REMOTE_CONFIG_KEY_GNSS_INTERVAL_S:
+        return value <= 1 || (value >= 10 && value <= UINT16_MAX);
+    case REMOTE_CONFIG_KEY_GNSS_TIMEOUT_S:
+        return value <= UINT16_MAX;
+    case REMOTE_CONFIG_KEY_SENSOR_INTERVAL_MS:
+    case REMOTE_CONFIG_KEY_BATTERY_INTERVAL_MS:
+        return value >= REMOTE_CONFIG_MIN_INTERVAL_MS;
+    case REMOTE_CONFIG_KEY_RECONNECT_DELAY_S:
+        return value >= 1 && value <= 86400;
+    default:
+        return false;
+    }
+}
+
+static uint32_t *field_get(struct remote_config *cfg, enum remote_config_key key)
+{
+    switch (key)
+    {
+    case REMOTE_CONFIG_KEY_GNSS_INTERVAL_S:
+        return &cfg->gnss_interval_s;
+    case REMOTE_CONFIG_KEY_GNSS_TIMEOUT_S:
+        return &cfg->gnss_timeout_s;
+    case REMOTE_CONFIG_KEY_SENSOR_INTERVAL_MS:
+        return &cfg->sensor_interval_ms;
+    case REMOTE_CONFIG_KEY_BATTERY_INTERVAL_MS:
+        return &cfg->battery_interval_ms;
+    case REMOTE_CONFIG_KEY_RECONNECT_DELAY_S:
+        return &cfg->reconnect_delay_s;
+    default:
+        return NULL;
+    }
+}
+
+int remote_config_apply(const uint8_t *data, size_t len)
+{
+    struct remote_config next = config;
+    size_t pos = 4;
+    int err;
+
+    if (len < 4)
+    {
+        return -EMSGSIZE;
+    }
+
+    next.version = sys_get_le32(data);
+    if (next.version <= config.version)
+    {
+        LOG_INF("Config version %u is not newer than %u", next.version, config.version);
+        return -EALREADY;
+    }
+
+    /* Decode into a copy so a bad pair leaves the running config untouched */
+    while (pos < len)
+    {
+        enum remote_config_key key;
+        uint32_t value;
+
+        if (len - pos < 5)
+        {
+            return -EMSGSIZE;
+        }
+        key = data[pos];
+        value = sys_get_le32(&data[pos + 1]);
+        pos += 5;
+
+        if (!value_valid(key, value))
+        {
+            LOG_ERR("Config key %u value %u rejected", key, value);
+            return -EINVAL;
+        }
+        *field_get(&next, key) = value;
+    }
+
+    config = next;
+    LOG_INF("Config version %u: GNSS %u s/%u s, sensor %u ms, battery %u ms, reconnect %u s",
+            config.version, config.gnss_interval_s, config.gnss_timeout_s,
+            config.sensor_interval_ms, config.battery_interval_ms, config.reconnect_delay_s);
+
+    if (apply_cb != NULL)
+    {
+        apply_cb(&config);
+    }
+
+    err = settings_save_one(SETTINGS_KEY, &config, sizeof(config));
+    if (err)
+    {
+        LOG_ERR("Failed to persist config version %u: %d", config.version, err);
+    }
+    return 0;
+}
+
+const struct remote_config *remote_config_get(void)
+{
+    return &config;
+}
+
+static int remote_config_settings_set(const char *name, size_t len, settings_read_cb read_cb, void *cb_arg)
+{
+    struct remote_config stored;
+    int rc;
+
+    /* A layout change discards the stored config, the backend pushes it again */
+    if (!settings_name_steq(name, "cfg", NULL) || len != sizeof(stored))
+    {
+        return -EINVAL;
+    }
+
+    rc = read_cb(cb_arg, &stored, sizeof(stored));
+    if (rc < 0)
+    {
+        return rc;
+    }
+
+    config = stored;
+    return 0;
+}
+
+static int remote_config_settings_commit(void)
+{
+    if (apply_cb != NULL)
+    {
+        apply_cb(&config);
+    }
+    return 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(remote_config, "rcfg", NULL, remote_config_settings_set,
+                               remote_config_settings_commit, NULL);
+
+int remote_config_init(remote_config_apply_cb_t cb)
+{
+    apply_cb = cb;
+    return 0;
+}
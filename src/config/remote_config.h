@@ -0,0 +1,60 @@
+#ifndef _REMOTE_CONFIG_H_
+#define _REMOTE_CONFIG_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Sampling and reporting cadence, pushed by the backend on CONFIG_REMOTE_CONFIG_TOPIC.
+ *
+ * Document: version:u32, then any number of key:u8 value:u32 pairs
+ *   REMOTE_CONFIG_KEY_GNSS_INTERVAL_S     0 single fix, 1 continuous, 10-65535 periodic
+ *   REMOTE_CONFIG_KEY_GNSS_TIMEOUT_S      0-65535, 0 for no limit
+ *   REMOTE_CONFIG_KEY_SENSOR_INTERVAL_MS  >= REMOTE_CONFIG_MIN_INTERVAL_MS
+ *   REMOTE_CONFIG_KEY_BATTERY_INTERVAL_MS >= REMOTE_CONFIG_MIN_INTERVAL_MS
+ *   REMOTE_CONFIG_KEY_RECONNECT_DELAY_S   1-86400
+ * Integers are little endian. Keys that are left out keep their value. A document is
+ * only applied if its version is newer than the current one, and either entirely or not
+ * at all.
+ */
+
+#define REMOTE_CONFIG_MIN_INTERVAL_MS 1000
+
+enum remote_config_key
+{
+    REMOTE_CONFIG_KEY_GNSS_INTERVAL_S = 1,
+    REMOTE_CONFIG_KEY_GNSS_TIMEOUT_S = 2,
+    REMOTE_CONFIG_KEY_SENSOR_INTERVAL_MS = 3,
+    REMOTE_CONFIG_KEY_BATTERY_INTERVAL_MS = 4,
+    REMOTE_CONFIG_KEY_RECONNECT_DELAY_S = 5,
+};
+
+struct remote_config
+{
+    uint32_t version; // 0 until the first document, the compiled-in defaults
+    uint32_t gnss_interval_s;
+    uint32_t gnss_timeout_s;
+    uint32_t sensor_interval_ms;
+    uint32_t battery_interval_ms;
+    uint32_t reconnect_delay_s;
+};
+
+/**@brief Called with the new configuration, once after settings_load() and on every
+ * applied document. Pass it on to the modules.
+ */
+typedef void (*remote_config_apply_cb_t)(const struct remote_config *cfg);
+
+/**@brief Set the apply callback. Call before settings_load().
+ */
+int remote_config_init(remote_config_apply_cb_t cb);
+
+/**@brief Apply and persist a config document.
+ * @return 0, -EALREADY if it is not newer than the current version, -EMSGSIZE if it is
+ * truncated, -EINVAL for an unknown key or a value out of range.
+ */
+int remote_config_apply(const uint8_t *data, size_t len);
+
+/**@brief The configuration in use.
+ */
+const struct remote_config *remote_config_get(void);
+
+#endif /* _REMOTE_CONFIG_H_ */
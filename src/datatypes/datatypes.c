@@ -1,11 +1,103 @@
 #include <stdio.h>
 #include <stdbool.h>
 
+#include <zephyr/sys/util.h>
+
 #include "datatypes.h"
+#include "json_writer.h"
+#include "../timesync/timesync.h"
+
+BUILD_ASSERT(DEVICE_JSON_MAX_LEN <= DEVICE_MSG_LEN, "DEVICE_MSG_LEN cannot hold the largest shadow json");
+
+#define SHADOW_FIELD_KEY(name, key, decimals) key,
+static const char *const field_keys[] = {DEVICE_SHADOW_FIELDS(SHADOW_FIELD_KEY)};
+#undef SHADOW_FIELD_KEY
+
+#define SHADOW_FIELD_DECIMALS(name, key, decimals) decimals,
+static const uint8_t field_decimals[] = {DEVICE_SHADOW_FIELDS(SHADOW_FIELD_DECIMALS)};
+#undef SHADOW_FIELD_DECIMALS
+
+/* Fields dated by each sample stamp */
+#define POS_FIELDS (BIT(SHADOW_FIELD_LAT) | BIT(SHADOW_FIELD_LON) | BIT(SHADOW_FIELD_ALT))
+#define BAT_FIELDS BIT(SHADOW_FIELD_BAT)
+#define ENV_FIELDS (BIT(SHADOW_FIELD_TEMP) | BIT(SHADOW_FIELD_PRES) | BIT(SHADOW_FIELD_HUM) | BIT(SHADOW_FIELD_GAS))
+
+int32_t shadow_sample_time(const device_shadow_t *device, uint32_t mask)
+{
+    const int64_t stamps[] = {
+        (mask & POS_FIELDS) ? device->pos_stamp : 0,
+        (mask & BAT_FIELDS) ? device->bat_stamp : 0,
+        (mask & ENV_FIELDS) ? device->env_stamp : 0,
+    };
+    int64_t newest = 0;
+    int64_t utc_ms;
+
+    for (int i = 0; i < ARRAY_SIZE(stamps); i++)
+    {
+        newest = MAX(newest, stamps[i]);
+    }
+
+    /* Past 2038 the field cannot hold the time, no time beats a negative one */
+    if (newest == 0 || timesync_to_utc_ms(newest, &utc_ms) != 0 || utc_ms / MSEC_PER_SEC > SHADOW_TS_MAX)
+    {
+        return 0;
+    }
+    return (int32_t)(utc_ms / MSEC_PER_SEC);
+}
 
-//should really use a json lib instead of this.
-int device_to_json(char *json_payload, uint8_t payload_len, device_shadow_t device)
+int32_t shadow_field_get(const device_shadow_t *device, enum shadow_field field)
 {
-	return snprintf(json_payload, payload_len, "{\"9160\": [{\"lat\": %.2f},{\"long\": \"%.2f\"},{\"alt\": \"%.2f\"},{\"battery\": \"%d %%\"},{\"led\": \"%s\"},{\"temp\":\"%d C\"},{\"pres\":\"%d kPa\"},{\"humid\":\"%d %%\"},{\"gas\":\"%d ohm\"}]}",
-	device.latitude, device.longitude, device.altitude,	device.batt_voltage, device.led1_state ? "on" : "off", device.temperature, device.pressure, device.relative_humidity, device.gas_res);
+    switch (field)
+    {
+    case SHADOW_FIELD_LAT:
+        return device->lat_udeg;
+    case SHADOW_FIELD_LON:
+        return device->lon_udeg;
+    case SHADOW_FIELD_ALT:
+        return device->alt_dm;
+    case SHADOW_FIELD_BAT:
+        return device->batt_voltage;
+    case SHADOW_FIELD_LED:
+        return device->led1_state ? 1 : 0;
+    case SHADOW_FIELD_TEMP:
+        return device->temperature;
+    case SHADOW_FIELD_PRES:
+        return device->pressure;
+    case SHADOW_FIELD_HUM:
+        return device->relative_humidity;
+    case SHADOW_FIELD_GAS:
+        return device->gas_res;
+    case SHADOW_FIELD_TS:
+        return shadow_sample_time(device, BIT_MASK(SHADOW_FIELD_COUNT));
+    default:
+        return 0;
+    }
+}
+
+int shadow_fields_to_json(char *json_payload, size_t payload_len, const int32_t values[SHADOW_FIELD_COUNT], uint32_t mask)
+{
+    struct json_writer w;
+
+    json_writer_init(&w, json_payload, payload_len);
+    for (int i = 0; i < SHADOW_FIELD_COUNT; i++)
+    {
+        if (mask & BIT(i))
+        {
+            json_add_fixed(&w, field_keys[i], values[i], field_decimals[i]);
+        }
+    }
+
+    return json_writer_finish(&w);
+}
+
+int device_to_json(char *json_payload, size_t payload_len, const device_shadow_t *device)
+{
+    int32_t values[SHADOW_FIELD_COUNT];
+
+    for (int i = 0; i < SHADOW_FIELD_COUNT; i++)
+    {
+        values[i] = shadow_field_get(device, i);
+    }
+
+    return shadow_fields_to_json(json_payload, payload_len, values, BIT_MASK(SHADOW_FIELD_COUNT));
 }
@@ -3,29 +3,50 @@
 
 #include <stdio.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "shadow_schema.h"
 
 #define DEVICE_MSG_LEN 200 // some placeholder value for now.
 
 typedef struct device_shadow
 {
-	double latitude;
-	double longitude;
-	double altitude; // skeptical
-	int batt_voltage;
-	bool led1_state; // false = off, true = on
-	int temperature; // you can do the arithmetic to convert these to float in bme680.c if you wish. the log shows how.
-	int pressure;
-	int relative_humidity;
-	int gas_res;
+    int32_t lat_udeg; // micro-degrees, see geo.h
+    int32_t lon_udeg;
+    int32_t alt_dm;   // decimetres, skeptical
+    int batt_voltage;
+    bool led1_state; // false = off, true = on
+    int temperature; // you can do the arithmetic to convert these to float in bme680.c if you wish. the log shows how.
+    int pressure;
+    int relative_humidity;
+    int gas_res;
+    // timesync_stamp() of the last position, battery and bme680 sample, 0 if none yet
+    int64_t pos_stamp;
+    int64_t bat_stamp;
+    int64_t env_stamp;
 
 } device_shadow_t;
 
-/* @brief Just an snprintf wrapper.
-    Returns the number of characters that would have been written if n had been sufficiently large, not counting the terminating null character.
-    If an encoding error occurs, a negative number is returned.
-    Notice that only when this returned value is non-negative and less than n, the string has been completely written.
+/* @brief Value of one shadow field as the fixed-point integer described in shadow_schema.h.
+ */
+int32_t shadow_field_get(const device_shadow_t *device, enum shadow_field field);
+
+/* @brief The ts field for a report of the fields in `mask`: UTC seconds of the newest sample
+    among them, 0 if none of them has a sample time.
+*/
+int32_t shadow_sample_time(const device_shadow_t *device, uint32_t mask);
+
+/* @brief Write the fields in `mask` (bit n = enum shadow_field n) of a fixed-point value array as a flat json object.
+    Same return convention as device_to_json().
+*/
+int shadow_fields_to_json(char *json_payload, size_t payload_len, const int32_t values[SHADOW_FIELD_COUNT], uint32_t mask);
+
+/* @brief Write the shadow as a flat json object (see shadow_schema.h) into json_payload.
+    Never writes more than payload_len bytes, terminating null included; DEVICE_JSON_MAX_LEN always fits.
+    Returns the json length without the terminating null, or -ENOMEM if payload_len was too small.
 */
-int device_to_json(char *json_payload, uint8_t payload_len, device_shadow_t device);
+int device_to_json(char *json_payload, size_t payload_len, const device_shadow_t *device);
 
 
 #endif /* _DATATYPES_H_ */
@@ -0,0 +1,127 @@
+#include <errno.h>
+#include <string.h>
+
+#include "json_writer.h"
+
+static void put_char(struct json_writer *w, char c)
+{
+    /* Always keep room for the terminating null */
+    if (w->len + 1 >= w->size)
+    {
+        w->overflow = true;
+        return;
+    }
+    w->buf[w->len++] = c;
+}
+
+static void put_str(struct json_writer *w, const char *s)
+{
+    while (*s != '\0')
+    {
+        put_char(w, *s++);
+    }
+}
+
+/* Writes the decimal digits of v, at least min_digits of them (zero padded) */
+static void put_uint(struct json_writer *w, uint32_t v, uint8_t min_digits)
+{
+    char digits[10];
+    uint8_t n = 0;
+
+    do
+    {
+        digits[n++] = '0' + (v % 10);
+        v /= 10;
+    } while (v != 0 && n < sizeof(digits));
+
+    while (n < min_digits && n < sizeof(digits))
+    {
+        digits[n++] = '0';
+    }
+
+    while (n > 0)
+    {
+        put_char(w, digits[--n]);
+    }
+}
+
+static void put_key(struct json_writer *w, const char *key)
+{
+    if (!w->first)
+    {
+        put_char(w, ',');
+    }
+    w->first = false;
+
+    put_char(w, '"');
+    put_str(w, key);
+    put_str(w, "\":");
+}
+
+static uint32_t abs_u32(int32_t v)
+{
+    /* Through unsigned so INT32_MIN does not overflow */
+    return v < 0 ? (uint32_t)0 - (uint32_t)v : (uint32_t)v;
+}
+
+void json_writer_init(struct json_writer *w, char *buf, size_t size)
+{
+    w->buf = buf;
+    w->size = size;
+    w->len = 0;
+    w->overflow = (size == 0);
+    w->first = true;
+
+    put_char(w, '{');
+}
+
+void json_add_int(struct json_writer *w, const char *key, int32_t value)
+{
+    put_key(w, key);
+    if (value < 0)
+    {
+        put_char(w, '-');
+    }
+    put_uint(w, abs_u32(value), 1);
+}
+
+void json_add_fixed(struct json_writer *w, const char *key, int32_t value, uint8_t decimals)
+{
+    static const uint32_t pow10[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
+    uint32_t magnitude;
+
+    if (decimals == 0 || decimals >= sizeof(pow10) / sizeof(pow10[0]))
+    {
+        json_add_int(w, key, value);
+        return;
+    }
+
+    put_key(w, key);
+    if (value < 0)
+    {
+        put_char(w, '-');
+    }
+    magnitude = abs_u32(value);
+    put_uint(w, magnitude / pow10[decimals], 1);
+    put_char(w, '.');
+    put_uint(w, magnitude % pow10[decimals], decimals);
+}
+
+void json_add_str(struct json_writer *w, const char *key, const char *value)
+{
+    put_key(w, key);
+    put_char(w, '"');
+    put_str(w, value);
+    put_char(w, '"');
+}
+
+int json_writer_finish(struct json_writer *w)
+{
+    put_char(w, '}');
+    if (w->size > 0)
+    {
+        w->buf[w->len] = '\0';
+    }
+
+    return w->overflow ? -ENOMEM : (int)w->len;
+}
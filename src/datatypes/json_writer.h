@@ -0,0 +1,42 @@
+#ifndef _JSON_WRITER_H_
+#define _JSON_WRITER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Streaming json writer for flat objects. Writes straight into the caller's buffer,
+ * no allocation and no printf, numbers are formatted from fixed-point integers.
+ * Once the buffer is full the writer stops and json_writer_finish() reports it.
+ */
+struct json_writer
+{
+    char *buf;
+    size_t size;
+    size_t len;
+    bool overflow;
+    bool first;
+};
+
+/**@brief Start a json object in buf.
+ */
+void json_writer_init(struct json_writer *w, char *buf, size_t size);
+
+/**@brief Add "key":value where value is an integer.
+ */
+void json_add_int(struct json_writer *w, const char *key, int32_t value);
+
+/**@brief Add "key":value where value is fixed-point with `decimals` digits after the point.
+ */
+void json_add_fixed(struct json_writer *w, const char *key, int32_t value, uint8_t decimals);
+
+/**@brief Add "key":"value".
+ */
+void json_add_str(struct json_writer *w, const char *key, const char *value);
+
+/**@brief Close the object and null-terminate it.
+ * @return The json length without the terminator, or -ENOMEM if it did not fit.
+ */
+int json_writer_finish(struct json_writer *w);
+
+#endif /* _JSON_WRITER_H_ */
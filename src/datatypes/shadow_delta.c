@@ -0,0 +1,166 @@
+#include <string.h>
+
+#include <zephyr/sys/util.h>
+#include <zephyr/logging/log.h>
+
+#include "shadow_delta.h"
+
+LOG_MODULE_REGISTER(shadow_delta, LOG_LEVEL_INF);
+
+/* Smallest change worth reporting, in the fixed-point units of shadow_schema.h */
+static const int32_t field_threshold[SHADOW_FIELD_COUNT] = {
+    [SHADOW_FIELD_LAT] = 20,  // 20e-6 deg, ~2 m
+    [SHADOW_FIELD_LON] = 20,
+    [SHADOW_FIELD_ALT] = 50,  // 5 m, gnss altitude is noisy
+    [SHADOW_FIELD_BAT] = 1,   // %
+    [SHADOW_FIELD_LED] = 1,
+    [SHADOW_FIELD_TEMP] = 1,  // C
+    [SHADOW_FIELD_PRES] = 1,  // kPa
+    [SHADOW_FIELD_HUM] = 2,   // %
+    [SHADOW_FIELD_GAS] = 1000, // ohm
+    [SHADOW_FIELD_TS] = 1,     // s, only sent along with other fields
+};
+
+/* Reports sent but not acknowledged yet */
+#define SHADOW_REPORTS_IN_FLIGHT 4
+
+struct shadow_report
+{
+    uint16_t message_id; // 0 = free slot
+    uint32_t seq;        // order the reports were sent in
+    uint32_t mask;
+    int32_t values[SHADOW_FIELD_COUNT];
+};
+
+static int32_t baseline[SHADOW_FIELD_COUNT];
+static uint32_t baseline_seq[SHADOW_FIELD_COUNT]; // report each baseline value came from
+static uint32_t baseline_valid; // fields the backend has seen at least once
+static uint32_t report_seq;
+static struct shadow_report in_flight[SHADOW_REPORTS_IN_FLIGHT];
+static uint8_t in_flight_next;
+static struct shadow_report last_built;
+static int last_built_len;
+static uint32_t reports_since_keyframe;
+
+/* Average report size */
+static uint32_t reports;
+static uint32_t report_bytes;
+
+static bool field_changed(enum shadow_field field, int32_t value)
+{
+    int32_t diff = value - baseline[field];
+
+    if (!(baseline_valid & BIT(field)))
+    {
+        return true;
+    }
+
+    return (diff >= field_threshold[field]) || (-diff >= field_threshold[field]);
+}
+
+int shadow_report_build(const device_shadow_t *device, char *buf, size_t size, bool full)
+{
+    int len;
+
+    last_built.mask = 0;
+    if (++reports_since_keyframe >= CONFIG_SHADOW_KEYFRAME_INTERVAL)
+    {
+        full = true;
+    }
+
+    for (int i = 0; i < SHADOW_FIELD_COUNT; i++)
+    {
+        if (i == SHADOW_FIELD_TS)
+        {
+            continue;
+        }
+        last_built.values[i] = shadow_field_get(device, i);
+        if (full || field_changed(i, last_built.values[i]))
+        {
+            last_built.mask |= BIT(i);
+        }
+    }
+
+    /* The sample time alone is no news, it dates the fields sent with it, and only them */
+    last_built.values[SHADOW_FIELD_TS] = shadow_sample_time(device, last_built.mask);
+    if (full || (last_built.mask != 0 && field_changed(SHADOW_FIELD_TS, last_built.values[SHADOW_FIELD_TS])))
+    {
+        last_built.mask |= BIT(SHADOW_FIELD_TS);
+    }
+
+    if (full)
+    {
+        reports_since_keyframe = 0;
+    }
+
+    len = shadow_fields_to_json(buf, size, last_built.values, last_built.mask);
+    last_built_len = MAX(len, 0);
+
+    return len;
+}
+
+bool shadow_report_empty(void)
+{
+    return last_built.mask == 0;
+}
+
+uint32_t shadow_report_avg_len(void)
+{
+    return reports > 0 ? report_bytes / reports : 0;
+}
+
+/* Acks can come out of order: a field keeps the value of the newest report acked */
+static void report_commit(struct shadow_report *report)
+{
+    for (int f = 0; f < SHADOW_FIELD_COUNT; f++)
+    {
+        if ((report->mask & BIT(f)) &&
+            (!(baseline_valid & BIT(f)) || (int32_t)(report->seq - baseline_seq[f]) > 0))
+        {
+            baseline[f] = report->values[f];
+            baseline_seq[f] = report->seq;
+        }
+    }
+    baseline_valid |= report->mask;
+    report->message_id = 0;
+}
+
+void shadow_report_sent(uint16_t message_id)
+{
+    reports++;
+    report_bytes += last_built_len;
+    last_built.seq = ++report_seq;
+    LOG_DBG("Shadow report: %d bytes, avg %u bytes over %u reports", last_built_len,
+            report_bytes / reports, reports);
+
+    /* No PUBACK will come, the next keyframe repairs a lost report */
+    if (message_id == 0)
+    {
+        report_commit(&last_built);
+        return;
+    }
+
+    /* When every slot is taken the oldest report is dropped; its fields were never
+     * committed, so they stay dirty and are sent again.
+     */
+    in_flight[in_flight_next] = last_built;
+    in_flight[in_flight_next].message_id = message_id;
+    in_flight_next = (in_flight_next + 1) % SHADOW_REPORTS_IN_FLIGHT;
+}
+
+void shadow_report_acked(uint16_t message_id)
+{
+    if (message_id == 0)
+    {
+        return;
+    }
+
+    for (int i = 0; i < SHADOW_REPORTS_IN_FLIGHT; i++)
+    {
+        if (in_flight[i].message_id == message_id)
+        {
+            report_commit(&in_flight[i]);
+            return;
+        }
+    }
+}
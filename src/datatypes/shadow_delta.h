@@ -0,0 +1,43 @@
+#ifndef _SHADOW_DELTA_H_
+#define _SHADOW_DELTA_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "datatypes.h"
+
+/* Delta reporting of the device shadow.
+ * Only fields that moved by more than their significance threshold since the last
+ * *acknowledged* report are sent, with a full keyframe every CONFIG_SHADOW_KEYFRAME_INTERVAL reports.
+ * The baseline only advances on PUBACK, so a lost report just leaves its fields dirty
+ * and they go out again with the next one. Over a transport without PUBACKs (MQTT-SN,
+ * see DATA_PUBLISH_PUBACK) it advances when the report is sent, and only keyframes
+ * repair a lost one.
+ */
+
+/**@brief Build the next report for `device` into buf.
+ * @param full Send every field (keyframe), e.g. on a user request.
+ * @return json length, or a negative error. An unchanged shadow gives "{}".
+ */
+int shadow_report_build(const device_shadow_t *device, char *buf, size_t size, bool full);
+
+/**@brief The report built last carries no field, publishing it only tells the broker
+ * the device is alive.
+ */
+bool shadow_report_empty(void);
+
+/**@brief The report built last went out with this message id, 0 if no PUBACK will
+ * confirm it.
+ */
+void shadow_report_sent(uint16_t message_id);
+
+/**@brief PUBACK received, advance the baseline to what that report contained.
+ */
+void shadow_report_acked(uint16_t message_id);
+
+/**@brief Average length in bytes of the reports that went out, 0 before the first.
+ */
+uint32_t shadow_report_avg_len(void);
+
+#endif /* _SHADOW_DELTA_H_ */
@@ -0,0 +1,47 @@
+#ifndef _SHADOW_SCHEMA_H_
+#define _SHADOW_SCHEMA_H_
+
+/* Flat device shadow schema, shared by the device encoder (datatypes.c) and anything
+ * decoding it. No dependencies so it can be included from host code too.
+ *
+ * X(name, key, decimals): every field travels as a fixed-point integer with
+ * `decimals` digits after the decimal point, e.g. lat 37.774929 is 37774929 with 6 decimals.
+ */
+#define DEVICE_SHADOW_FIELDS(X) \
+    X(LAT, "lat", 6)   /* degrees */ \
+    X(LON, "lon", 6)   /* degrees */ \
+    X(ALT, "alt", 1)   /* m */ \
+    X(BAT, "bat", 0)   /* battery % */ \
+    X(LED, "led", 0)   /* 0 = off, 1 = on */ \
+    X(TEMP, "temp", 0) /* C */ \
+    X(PRES, "pres", 0) /* kPa */ \
+    X(HUM, "hum", 0)   /* % relative humidity */ \
+    X(GAS, "gas", 0)   /* ohm */ \
+    X(TS, "ts", 0)     /* UTC s since 1970 of the newest sample sent with it, see below */
+
+/* ts is an int32 like every other field, so it covers up to 2038-01-19 03:14:07 UTC and reads
+ * 0 after that until it is widened. 0 also means no time: nothing sampled yet, or the clock
+ * not set. Samples are never stamped 0 (timesync_stamp()), so a real sample is never taken
+ * for a missing one.
+ */
+#define SHADOW_TS_MAX 2147483647 /* INT32_MAX, without stdint.h */
+
+#define SHADOW_FIELD_ENUM(name, key, decimals) SHADOW_FIELD_##name,
+enum shadow_field
+{
+    DEVICE_SHADOW_FIELDS(SHADOW_FIELD_ENUM)
+    SHADOW_FIELD_COUNT
+};
+#undef SHADOW_FIELD_ENUM
+
+/* Longest value text: sign + 10 digits of an int32, plus the decimal point if any */
+#define SHADOW_VALUE_MAX_CHARS(decimals) (11 + ((decimals) > 0 ? 1 : 0))
+
+/* "key":value, plus a separating comma */
+#define SHADOW_FIELD_MAX_CHARS(name, key, decimals) \
+    (sizeof(key) - 1 + 3 + SHADOW_VALUE_MAX_CHARS(decimals) + 1) +
+
+/* Upper bound of the flat json object, braces and terminating null included */
+#define DEVICE_JSON_MAX_LEN (DEVICE_SHADOW_FIELDS(SHADOW_FIELD_MAX_CHARS) 2 + 1)
+
+#endif /* _SHADOW_SCHEMA_H_ */
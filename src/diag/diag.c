@@ -0,0 +1,71 @@
+#include <errno.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/sys_heap.h>
+
+#include "diag.h"
+#include "../datatypes/json_writer.h"
+
+LOG_MODULE_REGISTER(diag, LOG_LEVEL_INF);
+
+#if defined(CONFIG_HEAP_MEM_POOL_SIZE) && CONFIG_HEAP_MEM_POOL_SIZE > 0
+extern struct k_heap _system_heap;
+#endif
+
+struct diag_ctx
+{
+    struct json_writer *w;
+    uint32_t near_overflow;
+};
+
+static void thread_sample(const struct k_thread *thread, void *user_data)
+{
+    struct diag_ctx *ctx = user_data;
+    const char *name = k_thread_name_get((k_tid_t)thread);
+    size_t size = thread->stack_info.size;
+    size_t unused;
+    size_t used;
+
+    if (k_thread_stack_space_get(thread, &unused) != 0 || size == 0)
+    {
+        return;
+    }
+    used = size - unused;
+
+    if (name == NULL || name[0] == '\0')
+    {
+        name = "unnamed";
+    }
+
+    if (used * 100 >= size * CONFIG_DIAG_STACK_WARN_PCT)
+    {
+        LOG_WRN("Thread %s used %u of %u stack bytes", name, (unsigned int)used, (unsigned int)size);
+        ctx->near_overflow++;
+    }
+    json_add_int(ctx->w, name, used);
+}
+
+int diag_report_build(char *buf, size_t size)
+{
+    struct json_writer w;
+    struct diag_ctx ctx = {
+        .w = &w,
+    };
+
+    json_writer_init(&w, buf, size);
+    k_thread_foreach_unlocked(thread_sample, &ctx);
+
+#if defined(CONFIG_HEAP_MEM_POOL_SIZE) && CONFIG_HEAP_MEM_POOL_SIZE > 0
+    struct sys_memory_stats stats;
+
+    if (sys_heap_runtime_stats_get(&_system_heap.heap, &stats) == 0)
+    {
+        json_add_int(&w, "heap_max", stats.max_allocated_bytes);
+        json_add_int(&w, "heap_size", stats.allocated_bytes + stats.free_bytes);
+    }
+#endif
+
+    json_add_int(&w, "near_overflow", ctx.near_overflow);
+    return json_writer_finish(&w);
+}
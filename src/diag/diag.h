@@ -0,0 +1,14 @@
+#ifndef _DIAG_H_
+#define _DIAG_H_
+
+#include <stddef.h>
+
+/**@brief Write the stack and heap high-water marks as a flat json object, e.g.
+ * {"main":1840,"sysworkq":712,"aqi_thread_id":604,"heap_max":1024,"heap_size":2048,"near_overflow":0}
+ * Stack values are the peak bytes used per thread since boot. Threads above
+ * CONFIG_DIAG_STACK_WARN_PCT of their stack are counted in near_overflow and logged.
+ * @return The json length, or -ENOMEM if it did not fit.
+ */
+int diag_report_build(char *buf, size_t size);
+
+#endif /* _DIAG_H_ */
@@ -0,0 +1,82 @@
+#include "geo.h"
+
+/* Length of a milli-degree of latitude on the mean earth radius, in dm */
+#define DM_PER_1000_UDEG 1112 // 111.195 km/deg
+
+/* cos(0..90 deg) in Q15, linearly interpolated in between */
+static const uint16_t cos_table_q15[91] = {
+    32767, 32762, 32747, 32722, 32687, 32642, 32587, 32523, 32448, 32364, 32269, 32165, 32051, 31927, 31794, 31650,
+    31498, 31335, 31163, 30982, 30791, 30591, 30381, 30162, 29934, 29697, 29451, 29196, 28932, 28659, 28377, 28087,
+    27788, 27481, 27165, 26841, 26509, 26169, 25821, 25465, 25101, 24730, 24351, 23964, 23571, 23170, 22762, 22347,
+    21925, 21497, 21062, 20621, 20173, 19720, 19260, 18794, 18323, 17846, 17364, 16876, 16384, 15886, 15383, 14876,
+    14364, 13848, 13328, 12803, 12275, 11743, 11207, 10668, 10126, 9580, 9032, 8481, 7927, 7371, 6813, 6252,
+    5690, 5126, 4560, 3993, 3425, 2856, 2286, 1715, 1144, 572, 0};
+
+int32_t geo_cos_q15(int32_t lat_udeg)
+{
+    uint32_t a = lat_udeg < 0 ? (uint32_t)0 - (uint32_t)lat_udeg : (uint32_t)lat_udeg;
+    uint32_t deg = a / GEO_UDEG_PER_DEG;
+    uint32_t frac = a % GEO_UDEG_PER_DEG;
+
+    if (deg >= 90)
+    {
+        return 0;
+    }
+
+    return cos_table_q15[deg] -
+           (int32_t)(((int64_t)(cos_table_q15[deg] - cos_table_q15[deg + 1]) * frac) / GEO_UDEG_PER_DEG);
+}
+
+int64_t geo_distance_sq_dm2(int32_t lat1, int32_t lon1, int32_t lat2, int32_t lon2)
+{
+    int64_t dlat = (int64_t)lat2 - lat1;
+    int64_t dlon = (int64_t)lon2 - lon1;
+    int64_t dy, dx;
+
+    /* Shortest way around the antimeridian */
+    if (dlon > 180LL * GEO_UDEG_PER_DEG)
+    {
+        dlon -= 360LL * GEO_UDEG_PER_DEG;
+    }
+    else if (dlon < -180LL * GEO_UDEG_PER_DEG)
+    {
+        dlon += 360LL * GEO_UDEG_PER_DEG;
+    }
+
+    dy = dlat * DM_PER_1000_UDEG / 1000;
+    dx = ((dlon * DM_PER_1000_UDEG / 1000) * geo_cos_q15((int32_t)(((int64_t)lat1 + lat2) / 2))) >> 15;
+
+    return dx * dx + dy * dy;
+}
+
+uint32_t geo_distance_m(int32_t lat1, int32_t lon1, int32_t lat2, int32_t lon2)
+{
+    return geo_isqrt64((uint64_t)geo_distance_sq_dm2(lat1, lon1, lat2, lon2)) / 10;
+}
+
+uint32_t geo_isqrt64(uint64_t v)
+{
+    uint64_t res = 0;
+    uint64_t bit = 1ULL << 62;
+
+    while (bit > v)
+    {
+        bit >>= 2;
+    }
+
+    while (bit != 0)
+    {
+        if (v >= res + bit)
+        {
+            v -= res + bit;
+            res = (res >> 1) + bit;
+        }
+        else
+        {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return (uint32_t)res;
+}
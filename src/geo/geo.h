@@ -0,0 +1,31 @@
+#ifndef _GEO_H_
+#define _GEO_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Integer-only geodesy helpers. Coordinates are in micro-degrees (1e-6 deg).
+ * Distances use the small-angle form of the haversine formula (equirectangular
+ * projection around the mean latitude), accurate to well under 1% for the few
+ * kilometres between consecutive fixes or across a geofence.
+ */
+
+#define GEO_UDEG_PER_DEG 1000000
+
+/**@brief cos(latitude) in Q15 (32767 = 1.0).
+ */
+int32_t geo_cos_q15(int32_t lat_udeg);
+
+/**@brief Squared distance between two points, in dm^2.
+ */
+int64_t geo_distance_sq_dm2(int32_t lat1, int32_t lon1, int32_t lat2, int32_t lon2);
+
+/**@brief Distance between two points, in m.
+ */
+uint32_t geo_distance_m(int32_t lat1, int32_t lon1, int32_t lat2, int32_t lon2);
+
+/**@brief Integer square root.
+ */
+uint32_t geo_isqrt64(uint64_t v);
+
+#endif /* _GEO_H_ */
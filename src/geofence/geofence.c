@@ -0,0 +1,585 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/util.h>
+
+#include "geofence.h"
+#include "../geo/geo.h"
+
+LOG_MODULE_REGISTER(geofence, LOG_LEVEL_INF);
+
+#define GEOFENCE_TYPE_FREE 0
+#define GEOFENCE_TYPE_CIRCLE 1
+#define GEOFENCE_TYPE_POLYGON 2
+
+/* Latitude/longitude are shifted to be positive so cells can be packed in one key */
+#define CELL_LAT(lat) ((uint32_t)((int64_t)(lat) + 90LL * GEO_UDEG_PER_DEG) / CONFIG_GEOFENCE_CELL_SIZE_UDEG)
+#define CELL_LON(lon) ((uint32_t)((int64_t)(lon) + 180LL * GEO_UDEG_PER_DEG) / CONFIG_GEOFENCE_CELL_SIZE_UDEG)
+#define CELL_KEY(cell_lat, cell_lon) (((uint32_t)(cell_lat) << 16) | (cell_lon))
+
+BUILD_ASSERT(360LL * GEO_UDEG_PER_DEG / CONFIG_GEOFENCE_CELL_SIZE_UDEG < BIT(16),
+             "Longitude cells do not fit the 16 bit half of the cell key");
+
+/* Stored as-is in settings, so keep the layout stable */
+struct geofence
+{
+    uint16_t id;
+    uint8_t type;
+    uint8_t vertex_count;
+    uint32_t radius_m;
+    int32_t lat[CONFIG_GEOFENCE_MAX_VERTICES]; // a circle only uses [0]
+    int32_t lon[CONFIG_GEOFENCE_MAX_VERTICES];
+};
+
+struct bbox
+{
+    int32_t min_lat;
+    int32_t max_lat;
+    int32_t min_lon;
+    int32_t max_lon;
+};
+
+struct index_entry
+{
+    uint32_t cell;
+    uint16_t slot;
+};
+
+/* Fences keep their slot for their lifetime, so the inside/dwell state stays valid across updates.
+ * A configuration update is applied to the other table, which replaces the active one only
+ * once the whole payload was valid.
+ */
+static struct geofence fence_tables[2][CONFIG_GEOFENCE_MAX_FENCES];
+static struct geofence *fences = fence_tables[0];
+static struct bbox bboxes[CONFIG_GEOFENCE_MAX_FENCES];
+static uint32_t enter_time_s[CONFIG_GEOFENCE_MAX_FENCES];
+static ATOMIC_DEFINE(inside, CONFIG_GEOFENCE_MAX_FENCES);
+static ATOMIC_DEFINE(dwelled, CONFIG_GEOFENCE_MAX_FENCES);
+
+/* Grid index, sorted by cell. Fences covering too many cells are checked on every fix instead. */
+static struct index_entry index_entries[CONFIG_GEOFENCE_INDEX_SIZE];
+static uint16_t index_count;
+static uint16_t large_slots[CONFIG_GEOFENCE_MAX_FENCES];
+static uint16_t large_count;
+
+static K_MUTEX_DEFINE(geofence_lock);
+static geofence_event_cb_t event_cb;
+
+/* Latest fix, written from the GNSS event handler and evaluated from the work queue */
+static struct k_spinlock fix_lock;
+static int32_t fix_lat;
+static int32_t fix_lon;
+static void eval_work_fn(struct k_work *work);
+static K_WORK_DEFINE(eval_work, eval_work_fn);
+
+/* Per-fix evaluation cost */
+static uint32_t eval_count;
+static uint32_t eval_us_total;
+static uint32_t eval_us_max;
+
+static void bbox_compute(const struct geofence *fence, struct bbox *box)
+{
+    if (fence->type == GEOFENCE_TYPE_CIRCLE)
+    {
+        int32_t cos_q15 = MAX(geo_cos_q15(fence->lat[0]), 1);
+        /* 111195 m per degree of latitude */
+        int32_t dlat = (int32_t)((int64_t)fence->radius_m * GEO_UDEG_PER_DEG / 111195);
+        int32_t dlon = (int32_t)MIN(((int64_t)dlat << 15) / cos_q15, 180LL * GEO_UDEG_PER_DEG);
+
+        box->min_lat = fence->lat[0] - dlat;
+        box->max_lat = fence->lat[0] + dlat;
+        box->min_lon = fence->lon[0] - dlon;
+        box->max_lon = fence->lon[0] + dlon;
+        return;
+    }
+
+    box->min_lat = box->max_lat = fence->lat[0];
+    box->min_lon = box->max_lon = fence->lon[0];
+    for (int i = 1; i < fence->vertex_count; i++)
+    {
+        box->min_lat = MIN(box->min_lat, fence->lat[i]);
+        box->max_lat = MAX(box->max_lat, fence->lat[i]);
+        box->min_lon = MIN(box->min_lon, fence->lon[i]);
+        box->max_lon = MAX(box->max_lon, fence->lon[i]);
+    }
+}
+
+static int index_entry_cmp(const void *a, const void *b)
+{
+    const struct index_entry *ea = a;
+    const struct index_entry *eb = b;
+
+    return (ea->cell > eb->cell) - (ea->cell < eb->cell);
+}
+
+/* Call with geofence_lock held */
+static void index_build(void)
+{
+    index_count = 0;
+    large_count = 0;
+
+    for (uint16_t slot = 0; slot < CONFIG_GEOFENCE_MAX_FENCES; slot++)
+    {
+        struct bbox *box = &bboxes[slot];
+        uint32_t lat0, lat1, lon0, lon1;
+
+        if (fences[slot].type == GEOFENCE_TYPE_FREE)
+        {
+            continue;
+        }
+
+        bbox_compute(&fences[slot], box);
+        lat0 = CELL_LAT(CLAMP(box->min_lat, -90 * GEO_UDEG_PER_DEG, 90 * GEO_UDEG_PER_DEG - 1));
+        lat1 = CELL_LAT(CLAMP(box->max_lat, -90 * GEO_UDEG_PER_DEG, 90 * GEO_UDEG_PER_DEG - 1));
+        lon0 = CELL_LON(CLAMP(box->min_lon, -180 * GEO_UDEG_PER_DEG, 180 * GEO_UDEG_PER_DEG - 1));
+        lon1 = CELL_LON(CLAMP(box->max_lon, -180 * GEO_UDEG_PER_DEG, 180 * GEO_UDEG_PER_DEG - 1));
+
+        if ((lat1 - lat0 + 1) * (lon1 - lon0 + 1) > CONFIG_GEOFENCE_MAX_CELLS_PER_FENCE ||
+            index_count + (lat1 - lat0 + 1) * (lon1 - lon0 + 1) > ARRAY_SIZE(index_entries))
+        {
+            large_slots[large_count++] = slot;
+            continue;
+        }
+
+        for (uint32_t cell_lat = lat0; cell_lat <= lat1; cell_lat++)
+        {
+            for (uint32_t cell_lon = lon0; cell_lon <= lon1; cell_lon++)
+            {
+                index_entries[index_count].cell = CELL_KEY(cell_lat, cell_lon);
+                index_entries[index_count].slot = slot;
+                index_count++;
+            }
+        }
+    }
+
+    qsort(index_entries, index_count, sizeof(index_entries[0]), index_entry_cmp);
+    LOG_INF("Geofence index: %u grid entries, %u large fences", index_count, large_count);
+}
+
+/* First entry with cell >= key */
+static uint16_t index_lower_bound(uint32_t key)
+{
+    uint16_t lo = 0;
+    uint16_t hi = index_count;
+
+    while (lo < hi)
+    {
+        uint16_t mid = lo + (hi - lo) / 2;
+
+        if (index_entries[mid].cell < key)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* Ray casting on the lat/lon plane, fine for fences that do not span the antimeridian */
+static bool polygon_contains(const struct geofence *fence, int32_t lat, int32_t lon)
+{
+    bool in = false;
+
+    for (int i = 0, j = fence->vertex_count - 1; i < fence->vertex_count; j = i++)
+    {
+        int64_t lat_i = fence->lat[i];
+        int64_t lat_j = fence->lat[j];
+
+        if ((lat_i > lat) != (lat_j > lat))
+        {
+            /* lon < lon_i + (lat - lat_i) * (lon_j - lon_i) / (lat_j - lat_i), without dividing */
+            int64_t lhs = ((int64_t)lon - fence->lon[i]) * (lat_j - lat_i);
+            int64_t rhs = ((int64_t)lat - lat_i) * ((int64_t)fence->lon[j] - fence->lon[i]);
+
+            if ((lat_j > lat_i) ? (lhs < rhs) : (lhs > rhs))
+            {
+                in = !in;
+            }
+        }
+    }
+    return in;
+}
+
+static bool fence_contains(uint16_t slot, int32_t lat, int32_t lon)
+{
+    const struct geofence *fence = &fences[slot];
+    const struct bbox *box = &bboxes[slot];
+
+    if (lat < box->min_lat || lat > box->max_lat || lon < box->min_lon || lon > box->max_lon)
+    {
+        return false;
+    }
+
+    if (fence->type == GEOFENCE_TYPE_CIRCLE)
+    {
+        int64_t radius_dm = (int64_t)fence->radius_m * 10;
+
+        return geo_distance_sq_dm2(fence->lat[0], fence->lon[0], lat, lon) <= radius_dm * radius_dm;
+    }
+
+    return polygon_contains(fence, lat, lon);
+}
+
+static void event_emit(uint16_t slot, enum geofence_event_type type, int32_t lat, int32_t lon)
+{
+    struct geofence_event evt = {
+        .fence_id = fences[slot].id,
+        .type = type,
+        .lat = lat,
+        .lon = lon,
+    };
+
+    if (event_cb != NULL)
+    {
+        event_cb(&evt);
+    }
+}
+
+/* Update the state of one fence that the fix may be in, call with geofence_lock held */
+static void fence_evaluate(uint16_t slot, int32_t lat, int32_t lon, uint32_t now_s, atomic_t *hit)
+{
+    if (atomic_test_bit(hit, slot) || !fence_contains(slot, lat, lon))
+    {
+        return;
+    }
+
+    atomic_set_bit(hit, slot);
+
+    if (!atomic_test_and_set_bit(inside, slot))
+    {
+        enter_time_s[slot] = now_s;
+        atomic_clear_bit(dwelled, slot);
+        event_emit(slot, GEOFENCE_EVT_ENTER, lat, lon);
+    }
+    else if (!atomic_test_bit(dwelled, slot) && now_s - enter_time_s[slot] >= CONFIG_GEOFENCE_DWELL_S)
+    {
+        atomic_set_bit(dwelled, slot);
+        event_emit(slot, GEOFENCE_EVT_DWELL, lat, lon);
+    }
+}
+
+static void eval_work_fn(struct k_work *work)
+{
+    ATOMIC_DEFINE(hit, CONFIG_GEOFENCE_MAX_FENCES) = {0};
+    k_spinlock_key_t fix_key = k_spin_lock(&fix_lock);
+    int32_t lat = fix_lat;
+    int32_t lon = fix_lon;
+
+    k_spin_unlock(&fix_lock, fix_key);
+
+    uint32_t now_s = (uint32_t)(k_uptime_get() / MSEC_PER_SEC);
+    uint32_t start = k_cycle_get_32();
+    uint32_t key = CELL_KEY(CELL_LAT(lat), CELL_LON(lon));
+    uint32_t elapsed_us;
+
+    k_mutex_lock(&geofence_lock, K_FOREVER);
+
+    for (uint16_t i = index_lower_bound(key); i < index_count && index_entries[i].cell == key; i++)
+    {
+        fence_evaluate(index_entries[i].slot, lat, lon, now_s, hit);
+    }
+
+    for (uint16_t i = 0; i < large_count; i++)
+    {
+        fence_evaluate(large_slots[i], lat, lon, now_s, hit);
+    }
+
+    /* A fence we were in that does not contain this fix: exit.
+     * Only the few set bits of `inside` are visited.
+     */
+    for (uint16_t w = 0; w < ARRAY_SIZE(inside); w++)
+    {
+        /* Unsigned so clearing the top bit cannot overflow. find_lsb_set() takes 32 bits,
+         * atomic_t is 64 on 64-bit targets such as native_sim.
+         */
+        unsigned long bits = (unsigned long)atomic_get(&inside[w]);
+
+        while (bits != 0)
+        {
+            uint16_t slot = w * ATOMIC_BITS + __builtin_ctzl(bits);
+
+            bits &= bits - 1;
+            if (!atomic_test_bit(hit, slot))
+            {
+                atomic_clear_bit(inside, slot);
+                event_emit(slot, GEOFENCE_EVT_EXIT, lat, lon);
+            }
+        }
+    }
+
+    k_mutex_unlock(&geofence_lock);
+
+    elapsed_us = k_cyc_to_us_floor32(k_cycle_get_32() - start);
+    eval_count++;
+    eval_us_total += elapsed_us;
+    eval_us_max = MAX(eval_us_max, elapsed_us);
+    LOG_DBG("Geofence eval: %u us (avg %u us, max %u us)", elapsed_us, eval_us_total / eval_count, eval_us_max);
+}
+
+void geofence_position_update(int32_t lat_udeg, int32_t lon_udeg)
+{
+    k_spinlock_key_t key = k_spin_lock(&fix_lock);
+
+    fix_lat = lat_udeg;
+    fix_lon = lon_udeg;
+    k_spin_unlock(&fix_lock, key);
+    k_work_submit(&eval_work);
+}
+
+static int slot_find(const struct geofence *table, uint16_t id)
+{
+    for (int slot = 0; slot < CONFIG_GEOFENCE_MAX_FENCES; slot++)
+    {
+        if (table[slot].type != GEOFENCE_TYPE_FREE && table[slot].id == id)
+        {
+            return slot;
+        }
+    }
+    return -ENOENT;
+}
+
+static int slot_alloc(const struct geofence *table, uint16_t id)
+{
+    int slot = slot_find(table, id);
+
+    if (slot >= 0)
+    {
+        return slot;
+    }
+
+    for (slot = 0; slot < CONFIG_GEOFENCE_MAX_FENCES; slot++)
+    {
+        if (table[slot].type == GEOFENCE_TYPE_FREE)
+        {
+            return slot;
+        }
+    }
+    return -ENOMEM;
+}
+
+static void slot_reset(int slot)
+{
+    atomic_clear_bit(inside, slot);
+    atomic_clear_bit(dwelled, slot);
+}
+
+/* Bring settings in line with a slot that changed from old to fence */
+static int fence_persist(const struct geofence *old, const struct geofence *fence)
+{
+    char key[sizeof("geofence/65535")];
+    int err = 0;
+
+    if (old->type != GEOFENCE_TYPE_FREE && (fence->type == GEOFENCE_TYPE_FREE || fence->id != old->id))
+    {
+        snprintf(key, sizeof(key), "geofence/%u", old->id);
+        err = settings_delete(key);
+    }
+    if (fence->type != GEOFENCE_TYPE_FREE)
+    {
+        snprintf(key, sizeof(key), "geofence/%u", fence->id);
+        err = settings_save_one(key, fence, sizeof(*fence));
+    }
+    return err;
+}
+
+static int fence_store(struct geofence *table, const struct geofence *fence, atomic_t *changed)
+{
+    int slot = slot_alloc(table, fence->id);
+
+    if (slot < 0)
+    {
+        LOG_ERR("No room for fence %u", fence->id);
+        return slot;
+    }
+
+    /* Pushed again as it is: keep its inside/dwell state and spare the flash */
+    if (memcmp(&table[slot], fence, sizeof(*fence)) == 0)
+    {
+        return 0;
+    }
+
+    table[slot] = *fence;
+    atomic_set_bit(changed, slot);
+    return 0;
+}
+
+static int fence_delete(struct geofence *table, uint16_t id, atomic_t *changed)
+{
+    int slot = slot_find(table, id);
+
+    if (slot < 0)
+    {
+        return slot;
+    }
+
+    table[slot].type = GEOFENCE_TYPE_FREE;
+    atomic_set_bit(changed, slot);
+    return 0;
+}
+
+int geofence_config_apply(const uint8_t *data, size_t len)
+{
+    ATOMIC_DEFINE(changed, CONFIG_GEOFENCE_MAX_FENCES) = {0};
+    /* Only this function and the settings handler write the tables, never concurrently */
+    struct geofence *staged = fences == fence_tables[0] ? fence_tables[1] : fence_tables[0];
+    struct geofence *old;
+    int err = 0;
+    size_t pos = 0;
+
+    memcpy(staged, fences, sizeof(fence_tables[0]));
+
+    while (pos < len && err == 0)
+    {
+        struct geofence fence = {0};
+        uint8_t cmd = data[pos++];
+
+        switch (cmd)
+        {
+        case GEOFENCE_CMD_CIRCLE:
+            if (len - pos < 14)
+            {
+                err = -EMSGSIZE;
+                break;
+            }
+            fence.id = sys_get_le16(&data[pos]);
+            fence.type = GEOFENCE_TYPE_CIRCLE;
+            fence.vertex_count = 1;
+            fence.lat[0] = (int32_t)sys_get_le32(&data[pos + 2]);
+            fence.lon[0] = (int32_t)sys_get_le32(&data[pos + 6]);
+            fence.radius_m = sys_get_le32(&data[pos + 10]);
+            pos += 14;
+            err = fence.id ? fence_store(staged, &fence, changed) : -EINVAL;
+            break;
+
+        case GEOFENCE_CMD_POLYGON:
+            if (len - pos < 3)
+            {
+                err = -EMSGSIZE;
+                break;
+            }
+            fence.id = sys_get_le16(&data[pos]);
+            fence.type = GEOFENCE_TYPE_POLYGON;
+            fence.vertex_count = data[pos + 2];
+            pos += 3;
+            if (fence.id == 0 || fence.vertex_count < 3 || fence.vertex_count > CONFIG_GEOFENCE_MAX_VERTICES)
+            {
+                err = -EINVAL;
+                break;
+            }
+            if (len - pos < fence.vertex_count * 8U)
+            {
+                err = -EMSGSIZE;
+                break;
+            }
+            for (int i = 0; i < fence.vertex_count; i++, pos += 8)
+            {
+                fence.lat[i] = (int32_t)sys_get_le32(&data[pos]);
+                fence.lon[i] = (int32_t)sys_get_le32(&data[pos + 4]);
+            }
+            err = fence_store(staged, &fence, changed);
+            break;
+
+        case GEOFENCE_CMD_DELETE:
+            if (len - pos < 2)
+            {
+                err = -EMSGSIZE;
+                break;
+            }
+            fence_delete(staged, sys_get_le16(&data[pos]), changed);
+            pos += 2;
+            break;
+
+        case GEOFENCE_CMD_CLEAR:
+            for (int slot = 0; slot < CONFIG_GEOFENCE_MAX_FENCES; slot++)
+            {
+                if (staged[slot].type != GEOFENCE_TYPE_FREE)
+                {
+                    fence_delete(staged, staged[slot].id, changed);
+                }
+            }
+            break;
+
+        default:
+            err = -EINVAL;
+            break;
+        }
+    }
+
+    if (err)
+    {
+        LOG_ERR("Geofence config rejected at byte %u: %d, fences unchanged", (unsigned int)pos, err);
+        return err;
+    }
+
+    k_mutex_lock(&geofence_lock, K_FOREVER);
+    old = fences;
+    fences = staged;
+    for (int slot = 0; slot < CONFIG_GEOFENCE_MAX_FENCES; slot++)
+    {
+        if (atomic_test_bit(changed, slot))
+        {
+            slot_reset(slot);
+        }
+    }
+    index_build();
+    k_mutex_unlock(&geofence_lock);
+
+    for (int slot = 0; slot < CONFIG_GEOFENCE_MAX_FENCES; slot++)
+    {
+        if (atomic_test_bit(changed, slot) && fence_persist(&old[slot], &staged[slot]) != 0 && err == 0)
+        {
+            err = -EIO;
+            LOG_ERR("Fence %u not persisted", staged[slot].id);
+        }
+    }
+    return err;
+}
+
+static int geofence_settings_set(const char *name, size_t len, settings_read_cb read_cb, void *cb_arg)
+{
+    struct geofence fence;
+    int slot;
+    int rc;
+
+    if (len != sizeof(fence))
+    {
+        return -EINVAL;
+    }
+
+    rc = read_cb(cb_arg, &fence, sizeof(fence));
+    if (rc < 0)
+    {
+        return rc;
+    }
+
+    slot = slot_alloc(fences, fence.id);
+    if (slot < 0)
+    {
+        return slot;
+    }
+    fences[slot] = fence;
+    return 0;
+}
+
+static int geofence_settings_commit(void)
+{
+    k_mutex_lock(&geofence_lock, K_FOREVER);
+    index_build();
+    k_mutex_unlock(&geofence_lock);
+    return 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(geofence, "geofence", NULL, geofence_settings_set, geofence_settings_commit, NULL);
+
+int geofence_init(geofence_event_cb_t cb)
+{
+    event_cb = cb;
+    return 0;
+}
@@ -0,0 +1,58 @@
+#ifndef _GEOFENCE_H_
+#define _GEOFENCE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Geofence engine: every valid fix is checked against a set of circles and polygons,
+ * and only enter/exit/dwell transitions are reported.
+ * Fences are indexed on a coarse grid (CONFIG_GEOFENCE_CELL_SIZE_UDEG) so a fix is only
+ * tested against the fences overlapping its cell, not against all of them.
+ */
+
+enum geofence_event_type
+{
+    GEOFENCE_EVT_ENTER,
+    GEOFENCE_EVT_EXIT,
+    GEOFENCE_EVT_DWELL,
+};
+
+struct geofence_event
+{
+    uint16_t fence_id;
+    enum geofence_event_type type;
+    int32_t lat; // micro-degrees
+    int32_t lon;
+};
+
+typedef void (*geofence_event_cb_t)(const struct geofence_event *evt);
+
+/* Fence configuration payload (little endian), several commands can be concatenated:
+ *   GEOFENCE_CMD_CIRCLE  id:u16 lat:i32 lon:i32 radius_m:u32
+ *   GEOFENCE_CMD_POLYGON id:u16 n:u8 n * (lat:i32 lon:i32)
+ *   GEOFENCE_CMD_DELETE  id:u16
+ *   GEOFENCE_CMD_CLEAR
+ * Coordinates in micro-degrees. Fence ids are chosen by the backend, 0 is reserved.
+ */
+enum geofence_cmd
+{
+    GEOFENCE_CMD_CIRCLE = 1,
+    GEOFENCE_CMD_POLYGON = 2,
+    GEOFENCE_CMD_DELETE = 3,
+    GEOFENCE_CMD_CLEAR = 4,
+};
+
+/**@brief Set the event callback. Fences persisted in settings are loaded by settings_load().
+ */
+int geofence_init(geofence_event_cb_t cb);
+
+/**@brief Hand a valid fix to the engine. Safe from the GNSS event handler, evaluation
+ * runs from the system work queue.
+ */
+void geofence_position_update(int32_t lat_udeg, int32_t lon_udeg);
+
+/**@brief Apply and persist a fence configuration payload (see enum geofence_cmd).
+ */
+int geofence_config_apply(const uint8_t *data, size_t len);
+
+#endif /* _GEOFENCE_H_ */
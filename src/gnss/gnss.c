@@ -9,9 +9,9 @@
 #include <nrf_modem_gnss.h>
 
 #include "gnss.h"
-#include "../datatypes/datatypes.h"
-
-extern device_shadow_t g_device_state;
+#include "gnss_stats.h"
+#include "../radio/radio_arbiter.h"
+#include "../trace/trace.h"
 
 static struct nrf_modem_gnss_pvt_data_frame pvt_data;
 
@@ -19,37 +19,16 @@ static struct nrf_modem_gnss_pvt_data_frame pvt_data;
 static int64_t gnss_start_time;
 static bool first_fix = false;
 
-static uint8_t g_gps_data[MESSAGE_SIZE];
+/* Fix interval and retry in seconds, see gnss_cadence_set() */
+static uint16_t fix_interval = CONFIG_GNSS_PERIODIC_INTERVAL;
+static uint16_t fix_retry = CONFIG_GNSS_PERIODIC_TIMEOUT;
+static bool gnss_started = false;
 
 extern const struct k_sem lte_connected; // main.c handles the LTE work, so we need the semaphore from there. This is what Zephyr docs recommended.
 extern bool g_psm_granted;
 extern bool g_edrx_granted;
 
-LOG_MODULE_REGISTER(gnss, LOG_LEVEL_INF);
-
-/**@brief log fix data in a readable format
- */
-static void print_fix_data(struct nrf_modem_gnss_pvt_data_frame *pvt_data)
-{
-    LOG_INF("Latitude:       %.06f", pvt_data->latitude);
-    LOG_INF("Longitude:      %.06f", pvt_data->longitude);
-    LOG_INF("Altitude:       %.01f m", (double)pvt_data->altitude);
-    LOG_INF("Time (UTC):     %02u:%02u:%02u.%03u",
-            pvt_data->datetime.hour,
-            pvt_data->datetime.minute,
-            pvt_data->datetime.seconds,
-            pvt_data->datetime.ms);
-
-    int err = snprintf(g_gps_data, MESSAGE_SIZE, "Latitude: %.06f, Longitude: %.06f", pvt_data->latitude, pvt_data->longitude);
-    if (err < 0)
-    {
-        LOG_ERR("Failed to print to buffer: %d", err);
-    }
-    // capture data to the device state
-    g_device_state.latitude = pvt_data->latitude;
-    g_device_state.longitude = pvt_data->longitude;
-    g_device_state.altitude = pvt_data->altitude;
-}
+LOG_MODULE_DECLARE(gnss);
 
 static void gnss_event_handler(int event)
 {
@@ -59,51 +38,48 @@ static void gnss_event_handler(int event)
     {
     /* On a PVT event, confirm if PVT data is a valid fix */
     case NRF_MODEM_GNSS_EVT_PVT:
-        LOG_INF("Searching...");
-        /* Print satellite information */
-        int num_satellites = 0;
-        for (int i = 0; i < 12; i++)
-        {
-            if (pvt_data.sv[i].signal != 0)
-            {
-                LOG_INF("sv: %d, cn0: %d, signal: %d", pvt_data.sv[i].sv, pvt_data.sv[i].cn0, pvt_data.sv[i].signal);
-                num_satellites++;
-            }
-        }
-        LOG_INF("Number of current satellites: %d", num_satellites);
         err = nrf_modem_gnss_read(&pvt_data, sizeof(pvt_data), NRF_MODEM_GNSS_DATA_PVT);
         if (err)
         {
             LOG_ERR("nrf_modem_gnss_read failed, err %d", err);
             return;
         }
-        if (pvt_data.flags & NRF_MODEM_GNSS_PVT_FLAG_FIX_VALID)
+#if defined(CONFIG_TRACE_CAPTURE)
+        trace_record_pvt(&pvt_data);
+#endif
+#if defined(CONFIG_RADIO_ARBITER)
+        radio_arbiter_gnss_pvt(&pvt_data);
+#endif
+        if (gnss_pvt_process(&pvt_data))
         {
             dk_set_led_on(DK_LED1);
-            print_fix_data(&pvt_data);
             /* Print the time to first fix */
             if (!first_fix)
             {
                 LOG_INF("Time to first fix: %2.1lld s", (k_uptime_get() - gnss_start_time) / 1000);
                 first_fix = true;
             }
-            return;
-        }
-        if (pvt_data.flags & NRF_MODEM_GNSS_PVT_FLAG_DEADLINE_MISSED)
-        {
-            LOG_INF("GNSS blocked by LTE activity");
-        }
-        else if (pvt_data.flags & NRF_MODEM_GNSS_PVT_FLAG_NOT_ENOUGH_WINDOW_TIME)
-        {
-            LOG_INF("Insufficient GNSS time windows");
         }
         break;
     /* Log when the GNSS sleeps and wakes up */
     case NRF_MODEM_GNSS_EVT_PERIODIC_WAKEUP:
         LOG_INF("GNSS has woken up");
+#if defined(CONFIG_RADIO_ARBITER)
+        radio_arbiter_gnss_search();
+#endif
         break;
     case NRF_MODEM_GNSS_EVT_SLEEP_AFTER_FIX:
         LOG_INF("GNSS enter sleep after fix");
+#if defined(CONFIG_RADIO_ARBITER)
+        radio_arbiter_gnss_sleep();
+#endif
+        break;
+    case NRF_MODEM_GNSS_EVT_SLEEP_AFTER_TIMEOUT:
+        LOG_INF("GNSS enter sleep after timeout");
+        gnss_stats_search_timeout();
+#if defined(CONFIG_RADIO_ARBITER)
+        radio_arbiter_gnss_sleep();
+#endif
         break;
     default:
         break;
@@ -126,13 +102,13 @@ int gnss_init_and_start(void)
         return -1;
     }
 
-    if (nrf_modem_gnss_fix_interval_set(CONFIG_GNSS_PERIODIC_INTERVAL) != 0)
+    if (nrf_modem_gnss_fix_interval_set(fix_interval) != 0)
     {
         LOG_ERR("Failed to set GNSS fix interval");
         return -1;
     }
 
-    if (nrf_modem_gnss_fix_retry_set(CONFIG_GNSS_PERIODIC_TIMEOUT) != 0)
+    if (nrf_modem_gnss_fix_retry_set(fix_retry) != 0)
     {
         LOG_ERR("Failed to set GNSS fix retry");
         return -1;
@@ -145,8 +121,9 @@ int gnss_init_and_start(void)
         return -1;
     }
 
+#if !defined(CONFIG_RADIO_ARBITER)
     // If not granted psm/edrx, we'll never get a fix. Depends on network. This will give GNSS priority over LTE events.
-    // An alternative would be to manaully activate and deactivate emodem when wanting to use GNSS in main.c
+    // With CONFIG_RADIO_ARBITER, priority is given in bounded windows and follows PSM/eDRX updates instead.
     if (!g_edrx_granted && !g_psm_granted)
     {
         if (nrf_modem_gnss_prio_mode_enable() != 0)
@@ -158,8 +135,54 @@ int gnss_init_and_start(void)
             LOG_INF("GNSS priority mode set");
         }
     }
+#endif
 
     gnss_start_time = k_uptime_get();
+    gnss_started = true;
 
     return 0;
+}
+
+int gnss_cadence_set(uint16_t interval_s, uint16_t timeout_s)
+{
+    int err;
+
+    if (gnss_started && interval_s == fix_interval && timeout_s == fix_retry)
+    {
+        return 0;
+    }
+    fix_interval = interval_s;
+    fix_retry = timeout_s;
+    if (!gnss_started)
+    {
+        return 0; // picked up by gnss_init_and_start()
+    }
+
+    /* The fix interval and retry can only be changed while GNSS is stopped */
+    err = nrf_modem_gnss_stop();
+    if (err)
+    {
+        LOG_ERR("Failed to stop GNSS: %d", err);
+        return err;
+    }
+
+    err = nrf_modem_gnss_fix_interval_set(fix_interval);
+    if (err == 0)
+    {
+        err = nrf_modem_gnss_fix_retry_set(fix_retry);
+    }
+    if (err)
+    {
+        LOG_ERR("Failed to set GNSS fix interval %u s, retry %u s: %d", fix_interval, fix_retry, err);
+    }
+
+    /* Restart either way, with the old cadence if the new one was refused */
+    if (nrf_modem_gnss_start() != 0)
+    {
+        LOG_ERR("Failed to restart GNSS");
+        gnss_started = false;
+        return -EIO;
+    }
+    LOG_INF("GNSS fix interval %u s, retry %u s", fix_interval, fix_retry);
+    return err;
 }
\ No newline at end of file
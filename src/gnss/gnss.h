@@ -1,11 +1,23 @@
 #ifndef _GNSS_H_
 #define _GNSS_H_
 
-#define MESSAGE_SIZE 0xFF
+#include <stdbool.h>
+#include <stdint.h>
+#include <nrf_modem_gnss.h>
 
 /**@brief Initialize GNSS
  */
 int gnss_init_and_start(void);
 
+/**@brief Change the fix interval and retry timeout (seconds), restarting GNSS if it runs.
+ * Before gnss_init_and_start(), the values are stored for it.
+ */
+int gnss_cadence_set(uint16_t interval_s, uint16_t timeout_s);
+
+/**@brief Log a PVT frame and store a valid fix in the device state.
+ * @return true if the frame holds a valid fix.
+ */
+bool gnss_pvt_process(const struct nrf_modem_gnss_pvt_data_frame *pvt);
+
 
 #endif /* _GNSS_H_ */
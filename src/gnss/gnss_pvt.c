@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include <nrf_modem_gnss.h>
+
+#include "gnss.h"
+#include "gnss_stats.h"
+#include "../datatypes/datatypes.h"
+#include "../geo/geo.h"
+#include "../geofence/geofence.h"
+#include "../logctl/logctl.h"
+#include "../timesync/timesync.h"
+#include "../trip/trip.h"
+
+/* Repeating messages while searching are logged at most this often */
+#define SEARCH_LOG_INTERVAL_MS 30000
+
+/* PVT frame processing, kept apart from the modem calls in gnss.c so recorded
+ * frames can be fed through it off-target (replay/).
+ */
+
+extern device_shadow_t g_device_state;
+
+LOG_MODULE_REGISTER(gnss, LOG_LEVEL_INF);
+
+/* The modem reports doubles, everything past this point works in fixed point */
+static int32_t to_fixed(double value, int32_t scale)
+{
+    double scaled = value * scale;
+
+    return (int32_t)(scaled < 0 ? scaled - 0.5 : scaled + 0.5);
+}
+
+/**@brief log fix data in a readable format, without float printf
+ */
+static void print_fix_data(const struct nrf_modem_gnss_pvt_data_frame *pvt_data)
+{
+    int32_t lat_udeg = to_fixed(pvt_data->latitude, GEO_UDEG_PER_DEG);
+    int32_t lon_udeg = to_fixed(pvt_data->longitude, GEO_UDEG_PER_DEG);
+    int32_t alt_dm = to_fixed(pvt_data->altitude, 10);
+
+    LOG_INF("Latitude:       %s%d.%06d", lat_udeg < 0 ? "-" : "", abs(lat_udeg / GEO_UDEG_PER_DEG), abs(lat_udeg % GEO_UDEG_PER_DEG));
+    LOG_INF("Longitude:      %s%d.%06d", lon_udeg < 0 ? "-" : "", abs(lon_udeg / GEO_UDEG_PER_DEG), abs(lon_udeg % GEO_UDEG_PER_DEG));
+    LOG_INF("Altitude:       %s%d.%01d m", alt_dm < 0 ? "-" : "", abs(alt_dm / 10), abs(alt_dm % 10));
+    LOG_INF("Time (UTC):     %02u:%02u:%02u.%03u",
+            pvt_data->datetime.hour,
+            pvt_data->datetime.minute,
+            pvt_data->datetime.seconds,
+            pvt_data->datetime.ms);
+
+    timesync_pvt_update(&pvt_data->datetime);
+
+#if defined(CONFIG_GEOFENCE)
+    geofence_position_update(lat_udeg, lon_udeg);
+#endif
+#if defined(CONFIG_TRIP)
+    struct trip_fix fix = {
+        .utc_ms = timesync_gnss_utc_ms(&pvt_data->datetime),
+        .lat = lat_udeg,
+        .lon = lon_udeg,
+        .speed_cms = to_fixed(pvt_data->speed, 100),
+    };
+
+    trip_fix_update(&fix);
+#endif
+#if !defined(CONFIG_GEOFENCE_EVENTS_ONLY)
+    // capture data to the device state
+    g_device_state.lat_udeg = lat_udeg;
+    g_device_state.lon_udeg = lon_udeg;
+    g_device_state.alt_dm = alt_dm;
+    g_device_state.pos_stamp = timesync_stamp();
+#endif
+}
+
+bool gnss_pvt_process(const struct nrf_modem_gnss_pvt_data_frame *pvt)
+{
+    gnss_stats_pvt(pvt);
+
+    /* Print satellite information, one frame per second while searching */
+    int num_satellites = 0;
+    for (int i = 0; i < NRF_MODEM_GNSS_MAX_SATELLITES; i++)
+    {
+        if (pvt->sv[i].signal != 0)
+        {
+            LOG_DBG("sv: %d, cn0: %d, signal: %d", pvt->sv[i].sv, pvt->sv[i].cn0, pvt->sv[i].signal);
+            num_satellites++;
+        }
+    }
+
+    if (pvt->flags & NRF_MODEM_GNSS_PVT_FLAG_FIX_VALID)
+    {
+        print_fix_data(pvt);
+        return true;
+    }
+    APP_LOG_RATELIMIT(LOG_INF, SEARCH_LOG_INTERVAL_MS, "Searching... %d satellites", num_satellites);
+    if (pvt->flags & NRF_MODEM_GNSS_PVT_FLAG_DEADLINE_MISSED)
+    {
+        APP_LOG_RATELIMIT(LOG_INF, SEARCH_LOG_INTERVAL_MS, "GNSS blocked by LTE activity");
+    }
+    else if (pvt->flags & NRF_MODEM_GNSS_PVT_FLAG_NOT_ENOUGH_WINDOW_TIME)
+    {
+        APP_LOG_RATELIMIT(LOG_INF, SEARCH_LOG_INTERVAL_MS, "Insufficient GNSS time windows");
+    }
+    return false;
+}
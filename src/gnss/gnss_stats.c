@@ -0,0 +1,202 @@
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+
+#include "gnss_stats.h"
+
+/* nRF91 SV numbering */
+#define GPS_SV_MIN 1
+#define GPS_SV_MAX 32
+#define QZSS_SV_MIN 193
+#define QZSS_SV_MAX 202
+
+/* CN0 is reported in 0.1 dB-Hz, bins are 5 dB-Hz wide from 15 dB-Hz */
+#define CN0_BIN_FIRST 150
+#define CN0_BIN_WIDTH 50
+
+/* Time to fix bins double from 5 s */
+#define TTF_BIN_FIRST_MS 5000
+
+struct gnss_stats
+{
+    uint32_t start_ms;
+    uint32_t frames;
+    uint32_t fix_frames;
+    uint32_t timeouts;
+    uint32_t deadline_missed;
+    uint32_t window_short;
+    uint32_t tracked;
+    uint32_t used;
+    uint32_t observations[GNSS_CONSTELLATION_COUNT];
+    uint32_t cn0[GNSS_CONSTELLATION_COUNT][GNSS_STATS_CN0_BINS];
+    uint32_t ttf[GNSS_STATS_TTF_BINS];
+};
+
+#define GNSS_STATS_HEADER_BITS(name, bits) bits,
+static const uint8_t header_bits[] = {GNSS_STATS_HEADER_FIELDS(GNSS_STATS_HEADER_BITS)};
+#undef GNSS_STATS_HEADER_BITS
+
+BUILD_ASSERT(GNSS_CONSTELLATION_COUNT == GNSS_STATS_CONSTELLATIONS, "Summary layout out of date");
+BUILD_ASSERT(GNSS_STATS_SUMMARY_BITS <= GNSS_STATS_SUMMARY_LEN * 8, "Summary layout does not fit GNSS_STATS_SUMMARY_LEN");
+
+static struct gnss_stats stats;
+static uint32_t searching_since_ms; // 0 while not searching
+static struct k_spinlock stats_lock;
+
+static int constellation_get(uint16_t sv)
+{
+    if (sv >= GPS_SV_MIN && sv <= GPS_SV_MAX)
+    {
+        return GNSS_CONSTELLATION_GPS;
+    }
+    if (sv >= QZSS_SV_MIN && sv <= QZSS_SV_MAX)
+    {
+        return GNSS_CONSTELLATION_QZSS;
+    }
+    return -1;
+}
+
+static int cn0_bin(uint16_t cn0)
+{
+    if (cn0 < CN0_BIN_FIRST)
+    {
+        return 0;
+    }
+    return MIN(1 + (cn0 - CN0_BIN_FIRST) / CN0_BIN_WIDTH, GNSS_STATS_CN0_BINS - 1);
+}
+
+static int ttf_bin(uint32_t ttf_ms)
+{
+    int bin = 0;
+
+    for (uint32_t limit = TTF_BIN_FIRST_MS; ttf_ms >= limit && bin < GNSS_STATS_TTF_BINS - 1; limit *= 2)
+    {
+        bin++;
+    }
+    return bin;
+}
+
+void gnss_stats_pvt(const struct nrf_modem_gnss_pvt_data_frame *pvt)
+{
+    uint32_t now_ms = k_uptime_get_32();
+    k_spinlock_key_t key = k_spin_lock(&stats_lock);
+
+    stats.frames++;
+    for (int i = 0; i < NRF_MODEM_GNSS_MAX_SATELLITES; i++)
+    {
+        int c = constellation_get(pvt->sv[i].sv);
+
+        if (pvt->sv[i].signal == 0 || c < 0)
+        {
+            continue;
+        }
+        stats.tracked++;
+        stats.observations[c]++;
+        stats.cn0[c][cn0_bin(pvt->sv[i].cn0)]++;
+        if (pvt->sv[i].flags & NRF_MODEM_GNSS_SV_FLAG_USED_IN_FIX)
+        {
+            stats.used++;
+        }
+    }
+
+    if (pvt->flags & NRF_MODEM_GNSS_PVT_FLAG_DEADLINE_MISSED)
+    {
+        stats.deadline_missed++;
+    }
+    if (pvt->flags & NRF_MODEM_GNSS_PVT_FLAG_NOT_ENOUGH_WINDOW_TIME)
+    {
+        stats.window_short++;
+    }
+
+    /* A search runs from the first frame without a fix to the next fix */
+    if (pvt->flags & NRF_MODEM_GNSS_PVT_FLAG_FIX_VALID)
+    {
+        stats.fix_frames++;
+        if (searching_since_ms != 0)
+        {
+            stats.ttf[ttf_bin(now_ms - searching_since_ms)]++;
+            searching_since_ms = 0;
+        }
+    }
+    else if (searching_since_ms == 0)
+    {
+        searching_since_ms = MAX(now_ms, 1);
+    }
+    k_spin_unlock(&stats_lock, key);
+}
+
+void gnss_stats_search_timeout(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&stats_lock);
+
+    stats.timeouts++;
+    searching_since_ms = 0;
+    k_spin_unlock(&stats_lock, key);
+}
+
+/* Append the low `width` bits of MIN(value, max of width) at bit `*pos`, MSB first */
+static void bits_put(uint8_t *buf, size_t *pos, uint32_t value, uint8_t width)
+{
+    value = MIN(value, BIT_MASK(width));
+    for (int i = width - 1; i >= 0; i--, (*pos)++)
+    {
+        if (value & BIT(i))
+        {
+            buf[*pos / 8] |= BIT(7 - *pos % 8);
+        }
+    }
+}
+
+int gnss_stats_summary_build(uint8_t *buf, size_t size)
+{
+    struct gnss_stats s;
+    uint32_t header[GNSS_STATS_HDR_COUNT];
+    size_t pos = 0;
+    k_spinlock_key_t key;
+
+    if (size < GNSS_STATS_SUMMARY_LEN)
+    {
+        return -ENOMEM;
+    }
+
+    key = k_spin_lock(&stats_lock);
+    s = stats;
+    memset(&stats, 0, sizeof(stats));
+    stats.start_ms = k_uptime_get_32();
+    k_spin_unlock(&stats_lock, key);
+
+    memset(buf, 0, GNSS_STATS_SUMMARY_LEN);
+    header[GNSS_STATS_HDR_VERSION] = GNSS_STATS_VERSION;
+    header[GNSS_STATS_HDR_MINUTES] = (k_uptime_get_32() - s.start_ms) / (60 * MSEC_PER_SEC);
+    header[GNSS_STATS_HDR_FRAMES] = s.frames;
+    header[GNSS_STATS_HDR_FIX_FRAMES] = s.fix_frames;
+    header[GNSS_STATS_HDR_TIMEOUTS] = s.timeouts;
+    header[GNSS_STATS_HDR_DEADLINE_MISSED] = s.deadline_missed;
+    header[GNSS_STATS_HDR_WINDOW_SHORT] = s.window_short;
+    header[GNSS_STATS_HDR_TRACKED_AVG] = s.frames ? s.tracked * 4 / s.frames : 0;
+    header[GNSS_STATS_HDR_USED_AVG] = s.fix_frames ? s.used * 4 / s.fix_frames : 0;
+    for (int i = 0; i < GNSS_STATS_HDR_COUNT; i++)
+    {
+        bits_put(buf, &pos, header[i], header_bits[i]);
+    }
+
+    for (int c = 0; c < GNSS_CONSTELLATION_COUNT; c++)
+    {
+        bits_put(buf, &pos, s.observations[c], GNSS_STATS_OBSERVATIONS_BITS);
+        for (int b = 0; b < GNSS_STATS_CN0_BINS; b++)
+        {
+            uint32_t share = s.observations[c] ? (s.cn0[c][b] * GNSS_STATS_CN0_SHARE_MAX + s.observations[c] / 2) / s.observations[c] : 0;
+
+            bits_put(buf, &pos, share, GNSS_STATS_CN0_BITS);
+        }
+    }
+
+    for (int b = 0; b < GNSS_STATS_TTF_BINS; b++)
+    {
+        bits_put(buf, &pos, s.ttf[b], GNSS_STATS_TTF_BITS);
+    }
+
+    return GNSS_STATS_SUMMARY_LEN;
+}
@@ -0,0 +1,36 @@
+#ifndef _GNSS_STATS_H_
+#define _GNSS_STATS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <nrf_modem_gnss.h>
+
+/* GNSS signal quality accumulated over CONFIG_GNSS_STATS_INTERVAL_S and published as
+ * a fixed-size binary summary (layout in gnss_stats_schema.h), to tell antenna and
+ * coverage problems apart across a fleet without logs.
+ */
+
+#include "gnss_stats_schema.h"
+
+enum gnss_constellation
+{
+    GNSS_CONSTELLATION_GPS,
+    GNSS_CONSTELLATION_QZSS,
+    GNSS_CONSTELLATION_COUNT
+};
+
+/**@brief Account one PVT frame. Safe from the GNSS event handler.
+ */
+void gnss_stats_pvt(const struct nrf_modem_gnss_pvt_data_frame *pvt);
+
+/**@brief Account a search that ran into the fix retry timeout.
+ */
+void gnss_stats_search_timeout(void);
+
+/**@brief Write the summary of everything since the last call and start over.
+ * @return GNSS_STATS_SUMMARY_LEN, or -ENOMEM if size is smaller.
+ */
+int gnss_stats_summary_build(uint8_t *buf, size_t size);
+
+#endif /* _GNSS_STATS_H_ */
@@ -0,0 +1,55 @@
+#ifndef _GNSS_STATS_SCHEMA_H_
+#define _GNSS_STATS_SCHEMA_H_
+
+/* Bit layout of the GNSS signal quality summary (see gnss_stats.h), shared by the
+ * device packer (gnss_stats.c) and anything decoding it. No dependencies so it can
+ * be included from host code too.
+ *
+ * Fields are packed MSB first in this order, counters saturate:
+ *   GNSS_STATS_HEADER_FIELDS, X(name, bits)
+ *   then for each of GNSS_STATS_CONSTELLATIONS: observations, then GNSS_STATS_CN0_BINS shares
+ *   then GNSS_STATS_TTF_BINS counts
+ *   padding up to GNSS_STATS_SUMMARY_LEN bytes
+ */
+#define GNSS_STATS_HEADER_FIELDS(X) \
+    X(VERSION, 4)          /* GNSS_STATS_VERSION */ \
+    X(MINUTES, 12)         /* time covered */ \
+    X(FRAMES, 16)          /* PVT frames */ \
+    X(FIX_FRAMES, 16)      /* PVT frames with a valid fix */ \
+    X(TIMEOUTS, 8)         /* searches that ended without a fix */ \
+    X(DEADLINE_MISSED, 16) /* frames where LTE blocked GNSS */ \
+    X(WINDOW_SHORT, 16)    /* frames without enough GNSS time windows */ \
+    X(TRACKED_AVG, 6)      /* SVs tracked per frame, in 1/4 */ \
+    X(USED_AVG, 6)         /* SVs used per fix frame, in 1/4 */
+
+#define GNSS_STATS_HEADER_ENUM(name, bits) GNSS_STATS_HDR_##name,
+enum gnss_stats_header
+{
+    GNSS_STATS_HEADER_FIELDS(GNSS_STATS_HEADER_ENUM)
+    GNSS_STATS_HDR_COUNT
+};
+#undef GNSS_STATS_HEADER_ENUM
+
+#define GNSS_STATS_VERSION 1
+#define GNSS_STATS_SUMMARY_LEN 32
+
+/* GPS, then QZSS */
+#define GNSS_STATS_CONSTELLATIONS 2
+/* SVs tracked, summed over frames */
+#define GNSS_STATS_OBSERVATIONS_BITS 20
+/* Share of observations per CN0 bin in 1/15: < 15, < 20, < 25, < 30, < 35, < 40, < 45, >= 45 dB-Hz */
+#define GNSS_STATS_CN0_BINS 8
+#define GNSS_STATS_CN0_BITS 4
+#define GNSS_STATS_CN0_SHARE_MAX 15
+/* Searches by time to fix: < 5, < 10, < 20, < 40, < 80, < 160, < 320, >= 320 s */
+#define GNSS_STATS_TTF_BINS 8
+#define GNSS_STATS_TTF_BITS 6
+
+/* Bits used by the layout above, checked against GNSS_STATS_SUMMARY_LEN at build time */
+#define GNSS_STATS_HEADER_BITS_ADD(name, bits) (bits) +
+#define GNSS_STATS_SUMMARY_BITS \
+    (GNSS_STATS_HEADER_FIELDS(GNSS_STATS_HEADER_BITS_ADD) \
+     GNSS_STATS_CONSTELLATIONS * (GNSS_STATS_OBSERVATIONS_BITS + GNSS_STATS_CN0_BINS * GNSS_STATS_CN0_BITS) + \
+     GNSS_STATS_TTF_BINS * GNSS_STATS_TTF_BITS)
+
+#endif /* _GNSS_STATS_SCHEMA_H_ */
@@ -0,0 +1,104 @@
+#include <string.h>
+
+#include <zephyr/logging/log.h>
+#include <zephyr/logging/log_ctrl.h>
+
+#include "logctl.h"
+
+LOG_MODULE_REGISTER(logctl, LOG_LEVEL_INF);
+
+/* Longest "module=level" pair accepted */
+#define PAIR_MAX_LEN 48
+
+static const char *const level_names[] = {"none", "err", "wrn", "inf", "dbg"};
+
+static int level_parse(const char *name)
+{
+    for (int i = 0; i < ARRAY_SIZE(level_names); i++)
+    {
+        if (strcmp(name, level_names[i]) == 0)
+        {
+            return i;
+        }
+    }
+    if (name[0] >= '0' && name[0] <= '4' && name[1] == '\0')
+    {
+        return name[0] - '0';
+    }
+    return -EINVAL;
+}
+
+static int level_set(const char *module, int level)
+{
+    uint32_t count = log_src_cnt_get(Z_LOG_LOCAL_DOMAIN_ID);
+    bool found = false;
+
+    for (uint32_t source_id = 0; source_id < count; source_id++)
+    {
+        if (strcmp(module, "*") != 0 &&
+            strcmp(module, log_source_name_get(Z_LOG_LOCAL_DOMAIN_ID, source_id)) != 0)
+        {
+            continue;
+        }
+
+        /* NULL applies it to every backend. Capped at the compile-time level of the module */
+        uint32_t applied = log_filter_set(NULL, Z_LOG_LOCAL_DOMAIN_ID, source_id, level);
+        LOG_INF("%s: %s", log_source_name_get(Z_LOG_LOCAL_DOMAIN_ID, source_id), level_names[applied]);
+        found = true;
+    }
+
+    return found ? 0 : -ENOENT;
+}
+
+int logctl_apply(const uint8_t *data, size_t len)
+{
+    char pair[PAIR_MAX_LEN];
+    size_t start = 0;
+    int ret = 0;
+
+    while (start < len)
+    {
+        size_t end = start;
+
+        while (end < len && data[end] != ',' && data[end] != ' ')
+        {
+            end++;
+        }
+
+        if (end > start)
+        {
+            size_t pair_len = end - start;
+            char *sep;
+            int level;
+
+            if (pair_len >= sizeof(pair))
+            {
+                ret = -EINVAL;
+                start = end + 1;
+                continue;
+            }
+            memcpy(pair, &data[start], pair_len);
+            pair[pair_len] = '\0';
+
+            sep = strchr(pair, '=');
+            level = sep ? level_parse(sep + 1) : -EINVAL;
+            if (level < 0)
+            {
+                LOG_WRN("Bad log setting: %s", pair);
+                ret = -EINVAL;
+            }
+            else
+            {
+                *sep = '\0';
+                if (level_set(pair, level) != 0)
+                {
+                    LOG_WRN("No log module %s", pair);
+                    ret = -EINVAL;
+                }
+            }
+        }
+        start = end + 1;
+    }
+
+    return ret;
+}
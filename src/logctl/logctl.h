@@ -0,0 +1,40 @@
+#ifndef _LOGCTL_H_
+#define _LOGCTL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/kernel.h>
+
+/**@brief Log at most once per `_interval_ms` from this call site, e.g.
+ * APP_LOG_RATELIMIT(LOG_INF, 30000, "Searching... %d satellites", n);
+ * The number of dropped messages is logged with the next one that gets through.
+ */
+#define APP_LOG_RATELIMIT(_log, _interval_ms, ...)                   \
+    do                                                               \
+    {                                                                \
+        static int64_t _rl_next;                                     \
+        static uint32_t _rl_dropped;                                 \
+        int64_t _rl_now = k_uptime_get();                            \
+                                                                     \
+        if (_rl_now < _rl_next)                                      \
+        {                                                            \
+            _rl_dropped++;                                           \
+            break;                                                   \
+        }                                                            \
+        _rl_next = _rl_now + (_interval_ms);                         \
+        if (_rl_dropped > 0)                                         \
+        {                                                            \
+            _log("(%u similar messages dropped)", _rl_dropped);      \
+            _rl_dropped = 0;                                         \
+        }                                                            \
+        _log(__VA_ARGS__);                                           \
+    } while (0)
+
+/**@brief Change log levels at runtime. The payload is a list of module=level pairs
+ * separated by commas or spaces, level being none/err/wrn/inf/dbg or 0-4, and module
+ * a log module name or * for all of them: "gnss=dbg,bme680_module=err".
+ * @return 0, -EINVAL if any pair could not be applied (the others still are).
+ */
+int logctl_apply(const uint8_t *data, size_t len);
+
+#endif /* _LOGCTL_H_ */
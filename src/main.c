@@ -5,6 +5,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include <ncs_version.h>
 #include <zephyr/kernel.h>
 #include <zephyr/net/socket.h>
@@ -14,26 +15,43 @@
 #include <modem/nrf_modem_lib.h>
 #include <modem/lte_lc.h>
 #include <zephyr/net/mqtt.h>
+#include <zephyr/settings/settings.h>
 
 #include "datatypes/datatypes.h"
+#include "datatypes/json_writer.h"
+#include "datatypes/shadow_delta.h"
+#include "geofence/geofence.h"
 #include "mqtt/mqtt_connection.h"
+#include "mqtt/mqtt_liveness.h"
+#include "mqtt/mqtt_loop.h"
 #include "gnss/gnss.h"
+#include "gnss/gnss_stats.h"
 #include "pmic/pmic.h"
+#include "pmic/battery_runtime.h"
+#include "sensors/bme680.h"
+#include "trace/trace.h"
+#include "logctl/logctl.h"
+#include "diag/diag.h"
+#include "config/remote_config.h"
+#include "timesync/timesync.h"
+#include "radio/radio_arbiter.h"
+#include "trip/trip.h"
 
 /* The mqtt client struct */
-static struct mqtt_client client;
+static app_mqtt_client_t client;
 /* File descriptor */
 static struct pollfd fds;
 
 static K_SEM_DEFINE(lte_connected, 0, 1);
+static K_SEM_DEFINE(psm_update, 0, 1);
 
 LOG_MODULE_REGISTER(nrf9160_mqtt_gnss, LOG_LEVEL_INF);
 
 device_shadow_t g_device_state = 
 {
-	.latitude = 0,
-	.longitude = 0,
-	.altitude = 0,
+	.lat_udeg = 0,
+	.lon_udeg = 0,
+	.alt_dm = 0,
 	.batt_voltage = 0,
 	.led1_state = false
 };
@@ -42,6 +60,37 @@ device_shadow_t g_device_state =
 bool g_psm_granted = false;
 bool g_edrx_granted = false;
 bool g_started_up = false;
+int g_psm_tau_s = -1;         // network-granted periodic TAU, -1 if none
+int g_psm_active_time_s = -1; // network-granted active time, -1 if none
+bool g_rrc_connected = false;
+
+/* Keepalive traffic, to verify how many modem wakeups the keepalive alignment saves.
+ * A wakeup is a keepalive that had to bring the modem out of RRC idle/PSM.
+ */
+static struct
+{
+	uint32_t pings;
+	uint32_t wakeups;
+	uint32_t piggybacked;
+} keepalive_stats;
+static int keepalive_applied_s = -1;
+static int keepalive_connected_s = -1; // keepalive announced in the last CONNECT
+
+/* Log the keepalive counters every this many pings */
+#define KEEPALIVE_STATS_LOG_INTERVAL 16
+/* Reconnect for a keepalive at least this many times longer than the one announced;
+ * fewer saved pings do not pay for the handshake
+ */
+#define KEEPALIVE_RECONNECT_RATIO 2
+static uint32_t reconnect_delay_s = CONFIG_MQTT_RECONNECT_DELAY_S;
+
+#if defined(CONFIG_BATTERY_RUNTIME)
+/* The settings battery drain is measured under, kept up to date for battery_runtime.c */
+static struct battery_duty_cycle duty_cycle = {
+	.gnss_interval_s = CONFIG_GNSS_PERIODIC_INTERVAL,
+	.sensor_interval_ms = SENSOR_SAMPLE_INTERVAL_MS,
+};
+#endif
 
 static void lte_handler(const struct lte_lc_evt *const evt)
 {
@@ -60,6 +109,7 @@ static void lte_handler(const struct lte_lc_evt *const evt)
 
 	case LTE_LC_EVT_RRC_UPDATE:
 		LOG_INF("RRC mode: %s", evt->rrc_mode == LTE_LC_RRC_MODE_CONNECTED ? "Connected" : "Idle");
+		g_rrc_connected = (evt->rrc_mode == LTE_LC_RRC_MODE_CONNECTED);
 		break;
 
 	/* On event PSM update, print PSM paramters and check if was enabled */
@@ -69,17 +119,32 @@ static void lte_handler(const struct lte_lc_evt *const evt)
 		if (evt->psm_cfg.active_time == -1)
 		{
 			LOG_ERR("Network rejected PSM parameters. Failed to enable PSM");
+			g_psm_granted = false;
 		}
 		else
 		{
 			g_psm_granted = true;
+			g_psm_tau_s = evt->psm_cfg.tau;
+			g_psm_active_time_s = evt->psm_cfg.active_time;
 		}
+		k_sem_give(&psm_update);
+#if defined(CONFIG_RADIO_ARBITER)
+		radio_arbiter_lte_update(g_psm_granted, g_edrx_granted);
+#endif
+#if defined(CONFIG_BATTERY_RUNTIME)
+		duty_cycle.psm = g_psm_granted;
+		battery_runtime_duty_cycle_set(&duty_cycle);
+#endif
 		break;
 	/* On event eDRX update, print eDRX paramters */
 	case LTE_LC_EVT_EDRX_UPDATE:
-		g_edrx_granted = true;
-		LOG_INF("eDRX parameter update: eDRX: %f, PTW: %f",
-				(double)evt->edrx_cfg.edrx, (double)evt->edrx_cfg.ptw);
+		/* The network may also take eDRX away again, e.g. after a cell change */
+		g_edrx_granted = (evt->edrx_cfg.mode != LTE_LC_LTE_MODE_NONE);
+		LOG_INF("eDRX parameter update: eDRX: %d ms, PTW: %d ms",
+				(int)(evt->edrx_cfg.edrx * MSEC_PER_SEC), (int)(evt->edrx_cfg.ptw * MSEC_PER_SEC));
+#if defined(CONFIG_RADIO_ARBITER)
+		radio_arbiter_lte_update(g_psm_granted, g_edrx_granted);
+#endif
 		break;
 	default:
 		break;
@@ -108,6 +173,16 @@ static int modem_configure(void)
 	}
 #endif
 
+#if defined(CONFIG_MQTT_TLS)
+	/* Credentials can only be written while the modem is offline, so before connecting */
+	err = credentials_provision();
+	if (err)
+	{
+		LOG_ERR("Failed to provision credentials, error: %d", err);
+		return err;
+	}
+#endif
+
 	/* Request PSM and eDRX from the network */
 	err = lte_lc_psm_req(true);
 	if (err)
@@ -136,48 +211,424 @@ static int modem_configure(void)
 	return 0;
 }
 
-static void button_handler(uint32_t button_state, uint32_t has_changed)
+/* What shadow_publish() sends with CONFIG_SHADOW_DELTA, always the full shadow without */
+enum shadow_report_kind
+{
+	SHADOW_REPORT_FULL,      // every field, e.g. on a button press
+	SHADOW_REPORT_CHANGES,   // the changed fields, nothing if there are none
+	SHADOW_REPORT_KEEPALIVE, // the changed fields, "{}" if there are none as it stands in for a PINGREQ
+};
+
+/**@brief Publish the device state json, or the stock message if it could not be built.
+ * @return 0 if sent or there was nothing to send, else an error.
+ */
+static int shadow_publish(enum mqtt_qos qos, enum shadow_report_kind kind)
 {
 	int err;
 	int json_len;
-	bool stock_message = false;
+	size_t json_size;
+	uint8_t *json_payload = data_publish_buf_get(&json_size);
+
+#if defined(CONFIG_SHADOW_DELTA)
+	json_len = shadow_report_build(&g_device_state, json_payload, json_size, kind == SHADOW_REPORT_FULL);
+	if (json_len >= 0 && kind == SHADOW_REPORT_CHANGES && shadow_report_empty())
+	{
+		LOG_DBG("Shadow unchanged, no report");
+		return 0;
+	}
+#else
+	json_len = device_to_json(json_payload, json_size, &g_device_state);
+#endif
+	if (json_len < 0)
+	{
+		LOG_ERR("Failure in json packet creation: %d", json_len);
+		err = data_publish(&client, qos,
+						   CONFIG_BUTTON_EVENT_PUBLISH_MSG, sizeof(CONFIG_BUTTON_EVENT_PUBLISH_MSG) - 1);
+	}
+	else
+	{
+		err = data_publish(&client, qos, json_payload, json_len);
+#if defined(CONFIG_SHADOW_DELTA)
+		if (err == 0)
+		{
+			shadow_report_sent(DATA_PUBLISH_PUBACK && qos != MQTT_QOS_0_AT_MOST_ONCE ? data_publish_last_id() : 0);
+		}
+#endif
+	}
+
+	if (err)
+	{
+		LOG_INF("Failed to send message, %d", err);
+	}
+	return err;
+}
+
+#if defined(CONFIG_GEOFENCE)
+static void geofence_config_handler(const uint8_t *data, size_t len)
+{
+	int err = geofence_config_apply(data, len);
+
+	if (err)
+	{
+		LOG_ERR("Rejected geofence configuration: %d", err);
+	}
+}
+
+/**@brief Publish a geofence transition, e.g. {"fence":12,"evt":"enter","lat":..,"lon":..}.
+ * Runs on the system work queue, so the event is queued to the MQTT thread.
+ */
+static void geofence_event_handler(const struct geofence_event *evt)
+{
+	static const char *const names[] = {
+		[GEOFENCE_EVT_ENTER] = "enter",
+		[GEOFENCE_EVT_EXIT] = "exit",
+		[GEOFENCE_EVT_DWELL] = "dwell",
+	};
+	char buf[80];
+	struct json_writer w;
+	int len;
+	int err;
+
+	json_writer_init(&w, buf, sizeof(buf));
+	json_add_int(&w, "fence", evt->fence_id);
+	json_add_str(&w, "evt", names[evt->type]);
+	json_add_fixed(&w, "lat", evt->lat, 6);
+	json_add_fixed(&w, "lon", evt->lon, 6);
+	len = json_writer_finish(&w);
+	if (len < 0)
+	{
+		LOG_ERR("Failure in geofence event creation: %d", len);
+		return;
+	}
+
+	err = mqtt_loop_publish(CONFIG_GEOFENCE_EVENT_TOPIC, MQTT_QOS_1_AT_LEAST_ONCE, (uint8_t *)buf, len);
+	if (err)
+	{
+		LOG_INF("Failed to queue geofence event, %d", err);
+	}
+}
+#endif
+
+#if defined(CONFIG_TRIP)
+/**@brief Publish the summary of a trip that ended (layout in trip_schema.h).
+ * Runs on the system work queue, so the record is queued to the MQTT thread.
+ */
+static void trip_summary_handler(const struct trip_summary *summary)
+{
+	uint8_t buf[TRIP_SUMMARY_LEN];
+	int len = trip_summary_encode(summary, buf, sizeof(buf));
+	int err;
+
+	if (len < 0)
+	{
+		LOG_ERR("Failure in trip summary creation: %d", len);
+		return;
+	}
+
+	err = mqtt_loop_publish(CONFIG_TRIP_TOPIC, MQTT_QOS_1_AT_LEAST_ONCE, buf, len);
+	if (err)
+	{
+		LOG_INF("Failed to queue trip summary, %d", err);
+	}
+}
+#endif
+
+#if defined(CONFIG_TRACE_CAPTURE)
+/**@brief Publish the captured trace in publish buffer sized chunks, in order.
+ * Concatenating the payloads gives back the trace file.
+ */
+static void trace_dump(void)
+{
+	size_t chunk_size;
+	uint8_t *chunk = data_publish_buf_get(&chunk_size);
+	size_t len;
+	const uint8_t *trace = trace_data_get(&len);
+	int err;
+
+	LOG_INF("Dumping %u trace bytes", (unsigned int)len);
+	for (size_t off = 0; off < len; off += chunk_size)
+	{
+		size_t n = MIN(chunk_size, len - off);
+
+		memcpy(chunk, &trace[off], n);
+		err = data_publish_topic(&client, CONFIG_TRACE_DUMP_TOPIC, MQTT_QOS_1_AT_LEAST_ONCE, chunk, n);
+		if (err)
+		{
+			LOG_ERR("Trace dump stopped at %u: %d", (unsigned int)off, err);
+			return;
+		}
+	}
+}
+
+static void trace_cmd_handler(const uint8_t *data, size_t len)
+{
+	if (len == sizeof("dump") - 1 && memcmp(data, "dump", len) == 0)
+	{
+		mqtt_loop_call(trace_dump);
+	}
+	else if (len == sizeof("clear") - 1 && memcmp(data, "clear", len) == 0)
+	{
+		trace_clear();
+	}
+}
+#endif
+
+#if defined(CONFIG_DIAG)
+static void diag_report(void)
+{
+	size_t size;
+	uint8_t *buf = data_publish_buf_get(&size);
+	int len;
+	int err;
+
+	len = diag_report_build(buf, size);
+	if (len < 0)
+	{
+		LOG_ERR("Diagnostics report does not fit: %d", len);
+		return;
+	}
+
+	err = data_publish_topic(&client, CONFIG_DIAG_TOPIC, MQTT_QOS_0_AT_MOST_ONCE, buf, len);
+	if (err)
+	{
+		LOG_INF("Failed to send diagnostics, %d", err);
+	}
+}
+
+static void diag_timer_fn(struct k_timer *timer)
+{
+	mqtt_loop_call(diag_report);
+}
+static K_TIMER_DEFINE(diag_timer, diag_timer_fn, NULL);
+#endif
 
-	uint8_t json_payload[DEVICE_MSG_LEN];
+#if CONFIG_GNSS_STATS_INTERVAL_S > 0
+static void gnss_stats_report(void)
+{
+	size_t size;
+	uint8_t *buf = data_publish_buf_get(&size);
+	int len;
+	int err;
+
+	len = gnss_stats_summary_build(buf, size);
+	if (len < 0)
+	{
+		LOG_ERR("GNSS stats summary does not fit: %d", len);
+		return;
+	}
 
-	json_len = device_to_json(json_payload, DEVICE_MSG_LEN, g_device_state);
-	if (json_len >= DEVICE_MSG_LEN || json_len < 0)
+	err = data_publish_topic(&client, CONFIG_GNSS_STATS_TOPIC, MQTT_QOS_0_AT_MOST_ONCE, buf, len);
+	if (err)
 	{
-		stock_message = true;
-		LOG_ERR("Failure in json packet creation");
-		LOG_ERR("Tried to make len %d msg %s", json_len, json_payload);
+		LOG_INF("Failed to send GNSS stats, %d", err);
 	}
+}
+
+static void gnss_stats_timer_fn(struct k_timer *timer)
+{
+	mqtt_loop_call(gnss_stats_report);
+}
+static K_TIMER_DEFINE(gnss_stats_timer, gnss_stats_timer_fn, NULL);
+#endif
+
+#if defined(CONFIG_BATTERY_RUNTIME)
+static void battery_runtime_report(void)
+{
+	size_t size;
+	uint8_t *buf = data_publish_buf_get(&size);
+	int len;
+	int err;
 
+	len = battery_runtime_report_build((char *)buf, size);
+	if (len < 0)
+	{
+		LOG_ERR("Battery report does not fit: %d", len);
+		return;
+	}
+
+	err = data_publish_topic(&client, CONFIG_BATTERY_RUNTIME_TOPIC, MQTT_QOS_0_AT_MOST_ONCE, buf, len);
+	if (err)
+	{
+		LOG_INF("Failed to send battery report, %d", err);
+	}
+}
+
+static void battery_runtime_timer_fn(struct k_timer *timer)
+{
+	mqtt_loop_call(battery_runtime_report);
+}
+static K_TIMER_DEFINE(battery_runtime_timer, battery_runtime_timer_fn, NULL);
+#endif
+
+#if defined(CONFIG_MQTT_LIVENESS) && CONFIG_MQTT_LIVENESS_REPORT_INTERVAL_S > 0
+static void liveness_report(void)
+{
+	size_t size;
+	uint8_t *buf = data_publish_buf_get(&size);
+	int len;
+	int err;
+
+	len = mqtt_liveness_report_build((char *)buf, size);
+	if (len < 0)
+	{
+		LOG_ERR("Liveness report does not fit: %d", len);
+		return;
+	}
+
+	err = data_publish_topic(&client, CONFIG_MQTT_LIVENESS_TOPIC, MQTT_QOS_0_AT_MOST_ONCE, buf, len);
+	if (err)
+	{
+		LOG_INF("Failed to send liveness report, %d", err);
+	}
+}
+
+static void liveness_timer_fn(struct k_timer *timer)
+{
+	mqtt_loop_call(liveness_report);
+}
+static K_TIMER_DEFINE(liveness_timer, liveness_timer_fn, NULL);
+#endif
+
+#if defined(CONFIG_LOG_CONTROL)
+static void log_control_handler(const uint8_t *data, size_t len)
+{
+	if (logctl_apply(data, len) != 0)
+	{
+		LOG_WRN("Some log settings were not applied");
+	}
+}
+#endif
+
+#if defined(CONFIG_REMOTE_CONFIG)
+static int remote_config_result;
+
+/**@brief Hand a new configuration to the modules. Runs after settings_load() and on
+ * the MQTT thread for every applied document.
+ */
+static void remote_config_apply_handler(const struct remote_config *cfg)
+{
+	gnss_cadence_set(cfg->gnss_interval_s, cfg->gnss_timeout_s);
+#if defined(CONFIG_BME680)
+	aqi_interval_set(cfg->sensor_interval_ms);
+#endif
+#if defined(CONFIG_ADP536X)
+	battery_interval_set(cfg->battery_interval_ms);
+#endif
+#if defined(CONFIG_BATTERY_RUNTIME)
+	duty_cycle.gnss_interval_s = cfg->gnss_interval_s;
+	duty_cycle.sensor_interval_ms = cfg->sensor_interval_ms;
+	battery_runtime_duty_cycle_set(&duty_cycle);
+#endif
+	reconnect_delay_s = cfg->reconnect_delay_s;
+}
+
+/**@brief Acknowledge the version in use, e.g. {"cfg_ver":7,"err":0}. A rejected
+ * document is acknowledged with the version still in use and its error.
+ */
+static void remote_config_ack(void)
+{
+	char buf[40];
+	struct json_writer w;
+	int len;
+	int err;
+
+	json_writer_init(&w, buf, sizeof(buf));
+	json_add_int(&w, "cfg_ver", remote_config_get()->version);
+	json_add_int(&w, "err", remote_config_result);
+	len = json_writer_finish(&w);
+	if (len < 0)
+	{
+		return;
+	}
+
+	err = data_publish_topic(&client, CONFIG_REMOTE_CONFIG_ACK_TOPIC, MQTT_QOS_1_AT_LEAST_ONCE, (uint8_t *)buf, len);
+	if (err)
+	{
+		LOG_INF("Failed to send config ack, %d", err);
+	}
+}
+
+static void remote_config_handler(const uint8_t *data, size_t len)
+{
+	remote_config_result = remote_config_apply(data, len);
+	/* A retained document comes back on every connect, that is not an error */
+	if (remote_config_result == -EALREADY)
+	{
+		remote_config_result = 0;
+	}
+	mqtt_loop_call(remote_config_ack);
+}
+#endif
+
+static void button_report(void)
+{
+	shadow_publish(MQTT_QOS_1_AT_LEAST_ONCE, SHADOW_REPORT_FULL);
+}
+
+static void button_handler(uint32_t button_state, uint32_t has_changed)
+{
 	switch (has_changed)
 	{
 	case DK_BTN1_MSK:
-		/* When button 1 is pressed, call data_publish() to publish lat/long */
+		/* When button 1 is pressed, have the MQTT thread publish lat/long */
 		if (button_state & DK_BTN1_MSK)
 		{
-			if (stock_message)
-			{
-				err = data_publish(&client, MQTT_QOS_1_AT_LEAST_ONCE,
-								   CONFIG_BUTTON_EVENT_PUBLISH_MSG, sizeof(CONFIG_BUTTON_EVENT_PUBLISH_MSG) - 1);
-				if (err)
-				{
-					LOG_INF("Failed to send message, %d", err);
-					return;
-				}
-			}
-			else
-			{
-				err = data_publish(&client, MQTT_QOS_1_AT_LEAST_ONCE,
-								   json_payload, json_len);
-			}
+			mqtt_loop_call(button_report);
 		}
 		break;
 	}
 }
 
+#if CONFIG_SHADOW_REPORT_INTERVAL_S > 0
+static void scheduled_report(void)
+{
+	shadow_publish(MQTT_QOS_1_AT_LEAST_ONCE, SHADOW_REPORT_CHANGES);
+}
+
+static void report_timer_fn(struct k_timer *timer)
+{
+	mqtt_loop_call(scheduled_report);
+}
+static K_TIMER_DEFINE(report_timer, report_timer_fn, NULL);
+#endif
+
+/**@brief Derive the MQTT keepalive from the granted PSM TAU so keepalive traffic
+ * lands in the wakeups the network asks for anyway, instead of waking the modem out of PSM.
+ * @return true if the new keepalive is worth a reconnect: the broker only learns a longer
+ * keepalive from a CONNECT.
+ */
+static bool keepalive_update(void)
+{
+	int err;
+
+	int keepalive_s = CONFIG_MQTT_KEEPALIVE;
+
+#if defined(CONFIG_MQTT_KEEPALIVE_FROM_PSM)
+	if (g_psm_tau_s > 0)
+	{
+		keepalive_s = CLAMP(g_psm_tau_s - CONFIG_MQTT_KEEPALIVE_PSM_MARGIN_S,
+							CONFIG_MQTT_KEEPALIVE_MIN_S, UINT16_MAX);
+	}
+#endif
+
+	if (keepalive_s == keepalive_applied_s)
+	{
+		return false;
+	}
+
+	err = client_keepalive_set(&client, keepalive_s);
+	if (err < 0)
+	{
+		return false;
+	}
+
+	LOG_INF("Keepalive %d s (PSM TAU %d s, active time %d s)",
+			keepalive_s, g_psm_tau_s, g_psm_active_time_s);
+	keepalive_applied_s = keepalive_s;
+	return err > 0 && keepalive_connected_s > 0 &&
+		   keepalive_s >= keepalive_connected_s * KEEPALIVE_RECONNECT_RATIO;
+}
+
 static int mqtt_try_connect(void)
 {
 	int err;
@@ -187,18 +638,19 @@ static int mqtt_try_connect(void)
 	{
 		if (connect_attempt++ > 0)
 		{
-			LOG_INF("Reconnecting in %d seconds...",
-					CONFIG_MQTT_RECONNECT_DELAY_S);
-			k_sleep(K_SECONDS(CONFIG_MQTT_RECONNECT_DELAY_S));
+			LOG_INF("Reconnecting in %u seconds...", reconnect_delay_s);
+			k_sleep(K_SECONDS(reconnect_delay_s));
 		}
-		LOG_INF("Connection to broker using mqtt_connect");
-		err = mqtt_connect(&client);
+		(void)keepalive_update();
+		LOG_INF("Connection to broker using client_connect");
+		err = client_connect(&client);
 		if (err)
 		{
-			LOG_ERR("Error in mqtt_connect: %d, retrying...", err);
+			LOG_ERR("Error in client_connect: %d, retrying...", err);
 		}
 		else
 		{
+			keepalive_connected_s = keepalive_applied_s;
 			break;
 		}
 	}
@@ -208,32 +660,112 @@ static int mqtt_try_connect(void)
 		LOG_ERR("Error in fds_init: %d", err);
 		return 0;
 	}
+	mqtt_loop_socket_set(fds.fd);
 	return 0;
 }
 
+/**@brief How long queued publishes and calls must wait for a GNSS window, 0 to send now.
+ */
+static int uplink_hold_ms(void)
+{
+#if defined(CONFIG_RADIO_ARBITER)
+	bool pending = mqtt_loop_pending() > 0;
+
+#if defined(CONFIG_MQTT_LIVENESS)
+	/* An answer still on its way counts too, GNSS would keep it from arriving */
+	pending = pending || mqtt_liveness_waiting();
+#endif
+	return radio_arbiter_uplink_hold_ms(pending, client_keepalive_time_left(&client));
+#else
+	return 0;
+#endif
+}
+
 static int mqtt_connection(void)
 {
 	int err;
-	err = poll(&fds, 1, mqtt_keepalive_time_left(&client));
+	uint32_t start;
+	bool queued;
+	int hold_ms;
+	int timeout_ms;
+#if defined(CONFIG_MQTT_LIVENESS)
+	int answer_ms;
+#endif
+
+	if (keepalive_update())
+	{
+		LOG_INF("Reconnecting to announce keepalive %d s (was %d s)", keepalive_applied_s, keepalive_connected_s);
+		return -7;
+	}
+	/* While GNSS has the radio, leave the queue alone and only watch the socket */
+	queued = mqtt_loop_pending() > 0;
+	hold_ms = uplink_hold_ms();
+	timeout_ms = client_keepalive_time_left(&client);
+#if defined(CONFIG_MQTT_LIVENESS)
+	/* No answer gets through while GNSS has the radio, so that time does not count */
+	if (hold_ms > 0)
+	{
+		mqtt_liveness_hold();
+	}
+	/* Wake up when an answer is overdue, not only when the next ping is */
+	answer_ms = mqtt_liveness_time_left();
+	if (answer_ms >= 0 && (timeout_ms < 0 || answer_ms < timeout_ms))
+	{
+		timeout_ms = answer_ms;
+	}
+#endif
+	/* A negative timeout waits forever, the hold must still end the wait */
+	if (hold_ms > 0)
+	{
+		timeout_ms = timeout_ms < 0 ? hold_ms : MIN(hold_ms, timeout_ms);
+	}
+	err = mqtt_loop_wait(&fds, timeout_ms, hold_ms == 0);
 	if (err < 0)
 	{
 		LOG_ERR("Error in poll(): %d", errno);
 		return -1;
 	}
+	start = k_cycle_get_32();
 
-	err = mqtt_live(&client);
+	/* Telemetry resets the keepalive timer just like a PINGREQ, so send that instead */
+	if (IS_ENABLED(CONFIG_MQTT_KEEPALIVE_PIGGYBACK) && client_keepalive_time_left(&client) == 0)
+	{
+		if (shadow_publish(MQTT_QOS_1_AT_LEAST_ONCE, SHADOW_REPORT_KEEPALIVE) == 0)
+		{
+			keepalive_stats.piggybacked++;
+		}
+	}
+
+	err = client_live(&client);
 	if ((err != 0) && (err != -EAGAIN))
 	{
-		LOG_ERR("Error in mqtt_live: %d", err);
+		LOG_ERR("Error in client_live: %d", err);
 		return -2;
 	}
+	else if (err == 0)
+	{
+		keepalive_stats.pings++;
+		if (!g_rrc_connected)
+		{
+			keepalive_stats.wakeups++;
+		}
+		if (keepalive_stats.pings % KEEPALIVE_STATS_LOG_INTERVAL == 0)
+		{
+			LOG_INF("Keepalive: %u pings, %u modem wakeups, %u piggybacked on telemetry",
+					keepalive_stats.pings, keepalive_stats.wakeups, keepalive_stats.piggybacked);
+		}
+		else
+		{
+			LOG_DBG("Keepalive ping, %s", g_rrc_connected ? "RRC connected" : "modem woken up");
+		}
+	}
 
 	if ((fds.revents & POLLIN) == POLLIN)
 	{
-		err = mqtt_input(&client);
+		err = client_input(&client);
 		if (err != 0)
 		{
-			LOG_ERR("Error in mqtt_input: %d", err);
+			LOG_ERR("Error in client_input: %d", err);
 			return -3;
 		}
 	}
@@ -250,6 +782,28 @@ static int mqtt_connection(void)
 		return -5;
 	}
 
+#if defined(CONFIG_MQTT_LIVENESS)
+	/* Half-open connection: the carrier dropped the flow without a RST, reconnect now */
+	if (mqtt_liveness_time_left() == 0)
+	{
+		mqtt_liveness_dead();
+		return -6;
+	}
+#endif
+
+	/* Publishes and calls queued by other threads, after input so acks are current. The hold
+	 * from above stands, unless it was asked with nothing queued and the queue filled since */
+	if (mqtt_loop_pending() > 0 && !queued)
+	{
+		hold_ms = uplink_hold_ms();
+	}
+	if (mqtt_loop_pending() > 0 && hold_ms == 0)
+	{
+		mqtt_loop_process(&client);
+	}
+
+	mqtt_loop_iteration_done(start);
+
 	// success
 	return 0;
 }
@@ -258,6 +812,9 @@ int main(void)
 {
 	int err;
 
+	/* Kernel, libc and driver init before the application, compared between build profiles */
+	LOG_INF("Main reached %u us after boot", (uint32_t)k_ticks_to_us_floor64(k_uptime_ticks()));
+
 	if (dk_leds_init() != 0)
 	{
 		LOG_ERR("Failed to initialize the LED library");
@@ -270,11 +827,79 @@ int main(void)
 		return 0;
 	}
 
+#if defined(CONFIG_TIMESYNC_NETWORK)
+	err = timesync_network_query();
+	if (err)
+	{
+		LOG_INF("No network time yet (%d), waiting for a GNSS fix", err);
+	}
+#endif
+
 	if (dk_buttons_init(button_handler) != 0)
 	{
 		LOG_ERR("Failed to initialize the buttons library");
 	}
 
+#if defined(CONFIG_GEOFENCE)
+	err = geofence_init(geofence_event_handler);
+	if (err)
+	{
+		LOG_ERR("Failed to initialize geofencing: %d", err);
+	}
+
+	err = mqtt_downlink_register(CONFIG_GEOFENCE_CONFIG_TOPIC, geofence_config_handler);
+	if (err)
+	{
+		LOG_ERR("Failed to register geofence topic: %d", err);
+	}
+#endif
+
+#if defined(CONFIG_TRIP)
+	trip_init(trip_summary_handler);
+#endif
+
+#if defined(CONFIG_LOG_CONTROL)
+	err = mqtt_downlink_register(CONFIG_LOG_CONTROL_TOPIC, log_control_handler);
+	if (err)
+	{
+		LOG_ERR("Failed to register log control topic: %d", err);
+	}
+#endif
+
+#if defined(CONFIG_TRACE_CAPTURE)
+	err = mqtt_downlink_register(CONFIG_TRACE_CMD_TOPIC, trace_cmd_handler);
+	if (err)
+	{
+		LOG_ERR("Failed to register trace topic: %d", err);
+	}
+#endif
+
+#if defined(CONFIG_BATTERY_RUNTIME)
+	battery_runtime_duty_cycle_set(&duty_cycle);
+#endif
+
+#if defined(CONFIG_REMOTE_CONFIG)
+	remote_config_init(remote_config_apply_handler);
+
+	err = mqtt_downlink_register(CONFIG_REMOTE_CONFIG_TOPIC, remote_config_handler);
+	if (err)
+	{
+		LOG_ERR("Failed to register config topic: %d", err);
+	}
+#endif
+
+#if defined(CONFIG_SETTINGS)
+	err = settings_subsys_init();
+	if (err)
+	{
+		LOG_ERR("Failed to initialize settings: %d", err);
+	}
+	else
+	{
+		settings_load();
+	}
+#endif
+
 	err = client_init(&client);
 	if (err)
 	{
@@ -282,8 +907,45 @@ int main(void)
 		return 0;
 	}
 
+#if defined(CONFIG_SHADOW_DELTA)
+	data_publish_puback_cb_set(shadow_report_acked);
+#endif
+
+#if defined(CONFIG_MQTT_KEEPALIVE_FROM_PSM)
+	/* The first CONNECT should already carry the TAU derived keepalive */
+	if (k_sem_take(&psm_update, K_SECONDS(CONFIG_MQTT_KEEPALIVE_PSM_WAIT_S)) != 0)
+	{
+		LOG_INF("No PSM timers after %d s, connecting with the default keepalive",
+				CONFIG_MQTT_KEEPALIVE_PSM_WAIT_S);
+	}
+#endif
+
 	mqtt_try_connect();
 
+#if defined(CONFIG_DIAG)
+	k_timer_start(&diag_timer, K_SECONDS(CONFIG_DIAG_INTERVAL_S), K_SECONDS(CONFIG_DIAG_INTERVAL_S));
+#endif
+
+#if CONFIG_GNSS_STATS_INTERVAL_S > 0
+	k_timer_start(&gnss_stats_timer, K_SECONDS(CONFIG_GNSS_STATS_INTERVAL_S),
+				  K_SECONDS(CONFIG_GNSS_STATS_INTERVAL_S));
+#endif
+
+#if defined(CONFIG_BATTERY_RUNTIME)
+	k_timer_start(&battery_runtime_timer, K_SECONDS(CONFIG_BATTERY_RUNTIME_INTERVAL_S),
+				  K_SECONDS(CONFIG_BATTERY_RUNTIME_INTERVAL_S));
+#endif
+
+#if defined(CONFIG_MQTT_LIVENESS) && CONFIG_MQTT_LIVENESS_REPORT_INTERVAL_S > 0
+	k_timer_start(&liveness_timer, K_SECONDS(CONFIG_MQTT_LIVENESS_REPORT_INTERVAL_S),
+				  K_SECONDS(CONFIG_MQTT_LIVENESS_REPORT_INTERVAL_S));
+#endif
+
+#if CONFIG_SHADOW_REPORT_INTERVAL_S > 0
+	k_timer_start(&report_timer, K_SECONDS(CONFIG_SHADOW_REPORT_INTERVAL_S),
+				  K_SECONDS(CONFIG_SHADOW_REPORT_INTERVAL_S));
+#endif
+
 	LOG_DBG("PSM: %d EDRX %d", g_psm_granted, g_edrx_granted);
 	err = gnss_init_and_start();
 	if (err != 0)
@@ -302,10 +964,13 @@ int main(void)
 		// disconnect then reconnect.
 		if (mqtt_err < 0)
 		{
-			mqtt_err = 0; // reset flag
 			LOG_INF("Disconnecting MQTT client");
 
-			err = mqtt_disconnect(&client);
+			/* A dead link would not deliver the DISCONNECT anyway. -7 is a deliberate
+			 * reconnect for a new keepalive and says goodbye.
+			 */
+			err = mqtt_err == -6 ? client_abort(&client) : client_disconnect(&client);
+			mqtt_err = 0; // reset flag
 			if (err)
 			{
 				LOG_ERR("Could not disconnect MQTT client: %d", err);
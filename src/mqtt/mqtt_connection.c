@@ -1,260 +1,226 @@
 #include <stdio.h>
 #include <string.h>
-#include <ncs_version.h>
 
 #include <zephyr/logging/log.h>
 #include <zephyr/kernel.h>
 #include <zephyr/net/socket.h>
-#include <zephyr/net/mqtt.h>
-#include <nrf_modem_at.h>
 
+/* Without them (bench/mqtt_bench on native_sim) the client id must be configured,
+ * and LED commands only update the device state.
+ */
+#if defined(CONFIG_NRF_MODEM_LIB)
+#include <nrf_modem_at.h>
+#endif
+#if defined(CONFIG_DK_LIBRARY)
 #include <dk_buttons_and_leds.h>
+#endif
+
 #include "mqtt_connection.h"
+#include "mqtt_transport.h"
 #include "../datatypes/datatypes.h"
 
-#if NCS_VERSION_NUMBER < 0x20600
-#include <zephyr/random/rand32.h>
-#else
-#include <zephyr/random/random.h>
-#endif
-
 extern device_shadow_t g_device_state;
 
-/* Buffers for MQTT client. */
-static uint8_t rx_buffer[CONFIG_MQTT_MESSAGE_BUFFER_SIZE];
-static uint8_t tx_buffer[CONFIG_MQTT_MESSAGE_BUFFER_SIZE];
-static uint8_t payload_buf[CONFIG_MQTT_PAYLOAD_BUFFER_SIZE];
+static struct mqtt_transport_stats transport_stats;
+
+/* Log the publish cost every this many publishes */
+#define TRANSPORT_STATS_LOG_INTERVAL 32
 
-/* MQTT Broker details. */
-static struct sockaddr_storage broker;
+/* Outgoing payloads are built directly in here */
+static uint8_t publish_buf[CONFIG_MQTT_PUBLISH_BUFFER_SIZE];
+BUILD_ASSERT(DEVICE_JSON_MAX_LEN <= CONFIG_MQTT_PUBLISH_BUFFER_SIZE, "Publish buffer cannot hold the shadow json");
 
 LOG_MODULE_DECLARE(nrf9160_mqtt_gnss);
 
-/**@brief Function to get the payload of recived data.
- */
-static int get_received_payload(struct mqtt_client *c, size_t length)
+/* Topics subscribed besides CONFIG_MQTT_SUB_TOPIC */
+static struct
 {
-	int ret;
-	int err = 0;
+	const char *topic;
+	downlink_handler_t handler;
+} downlinks[CONFIG_MQTT_DOWNLINK_TOPICS_MAX];
+static size_t downlinks_registered;
+
+static uint16_t last_message_id;
+static puback_cb_t puback_cb;
 
-	/* Return an error if the payload is larger than the payload buffer.
-	 * Note: To allow new messages, we have to read the payload before returning.
-	 */
-	if (length > sizeof(payload_buf))
+uint16_t message_id_next(void)
+{
+	if (++last_message_id == 0)
 	{
-		err = -EMSGSIZE;
+		last_message_id = 1;
 	}
+	return last_message_id;
+}
 
-	/* Truncate payload until it fits in the payload buffer. */
-	while (length > sizeof(payload_buf))
-	{
-		ret = mqtt_read_publish_payload_blocking(
-			c, payload_buf, (length - sizeof(payload_buf)));
-		if (ret == 0)
-		{
-			return -EIO;
-		}
-		else if (ret < 0)
-		{
-			return ret;
-		}
+uint16_t data_publish_last_id(void)
+{
+	return last_message_id;
+}
 
-		length -= ret;
-	}
+void data_publish_puback_cb_set(puback_cb_t cb)
+{
+	puback_cb = cb;
+}
 
-	ret = mqtt_readall_publish_payload(c, payload_buf, length);
-	if (ret)
+void puback_handle(uint16_t message_id)
+{
+	if (puback_cb != NULL)
 	{
-		return ret;
+		puback_cb(message_id);
 	}
-
-	return err;
 }
 
-/**@brief Function to subscribe to the configured topic
+/**@brief Act on a payload received on the subscribe topic (LED commands).
  */
-static int subscribe(struct mqtt_client *const c)
+static void command_handle(const uint8_t *data, size_t len)
 {
-	struct mqtt_topic subscribe_topic = {
-		.topic = {
-			.utf8 = CONFIG_MQTT_SUB_TOPIC,
-			.size = strlen(CONFIG_MQTT_SUB_TOPIC)},
-		.qos = MQTT_QOS_1_AT_LEAST_ONCE};
+	LOG_HEXDUMP_INF(data, len, "Received:");
+	// Control the LED
+	if (strncmp(data, CONFIG_TURN_LED_ON_CMD, sizeof(CONFIG_TURN_LED_ON_CMD) - 1) == 0)
+	{
+#if defined(CONFIG_DK_LIBRARY)
+		dk_set_led_on(LED_CONTROL_OVER_MQTT);
+#endif
+		g_device_state.led1_state = true;
+	}
+	else if (strncmp(data, CONFIG_TURN_LED_OFF_CMD, sizeof(CONFIG_TURN_LED_OFF_CMD) - 1) == 0)
+	{
+#if defined(CONFIG_DK_LIBRARY)
+		dk_set_led_off(LED_CONTROL_OVER_MQTT);
+#endif
+		g_device_state.led1_state = false;
+	}
+}
 
-	const struct mqtt_subscription_list subscription_list = {
-		.list = &subscribe_topic,
-		.list_count = 1,
-		.message_id = 1234};
+int mqtt_downlink_register(const char *topic, downlink_handler_t handler)
+{
+	if (downlinks_registered >= ARRAY_SIZE(downlinks))
+	{
+		return -ENOMEM;
+	}
 
-	LOG_INF("Subscribing to: %s len %u", CONFIG_MQTT_SUB_TOPIC,
-			(unsigned int)strlen(CONFIG_MQTT_SUB_TOPIC));
+	downlinks[downlinks_registered].topic = topic;
+	downlinks[downlinks_registered].handler = handler;
+	downlinks_registered++;
 
-	return mqtt_subscribe(c, &subscription_list);
+	return 0;
 }
 
-/**@brief Function to print strings without null-termination
- */
-static void data_print(uint8_t *prefix, uint8_t *data, size_t len)
+size_t downlink_count(void)
 {
-	char buf[len + 1];
-
-	memcpy(buf, data, len);
-	buf[len] = 0;
-	LOG_INF("%s%s", (char *)prefix, (char *)buf);
+	return downlinks_registered;
 }
 
-/**@brief Function to publish data on the configured topic
- */
-int data_publish(struct mqtt_client *c, enum mqtt_qos qos,
-				 uint8_t *data, size_t len)
+const char *downlink_topic(size_t index)
 {
-	struct mqtt_publish_param param;
-
-	param.message.topic.qos = qos;
-	param.message.topic.topic.utf8 = CONFIG_MQTT_PUB_TOPIC;
-	param.message.topic.topic.size = strlen(CONFIG_MQTT_PUB_TOPIC);
-	param.message.payload.data = data;
-	param.message.payload.len = len;
-	param.message_id = sys_rand32_get();
-	param.dup_flag = 0;
-	param.retain_flag = 0;
-
-	data_print("Publishing: ", data, len);
-	LOG_INF("to topic: %s len: %u",
-			CONFIG_MQTT_PUB_TOPIC,
-			(unsigned int)strlen(CONFIG_MQTT_PUB_TOPIC));
-
-	return mqtt_publish(c, &param);
+	return downlinks[index].topic;
 }
-/**@brief MQTT client event handler
- */
-void mqtt_evt_handler(struct mqtt_client *const c,
-					  const struct mqtt_evt *evt)
-{
-	int err;
 
-	switch (evt->type)
+int downlink_index(const uint8_t *topic, size_t topic_len)
+{
+	for (size_t i = 0; i < downlinks_registered; i++)
 	{
-	case MQTT_EVT_CONNACK:
-		/* Subscribe to the topic CONFIG_MQTT_SUB_TOPIC when we have a successful connection */
-		if (evt->result != 0)
+		if (strlen(downlinks[i].topic) == topic_len &&
+			memcmp(downlinks[i].topic, topic, topic_len) == 0)
 		{
-			LOG_ERR("MQTT connect failed: %d", evt->result);
-			break;
+			return i;
 		}
+	}
+	return -ENOENT;
+}
 
-		LOG_INF("MQTT client connected");
-		subscribe(c);
-		break;
+void downlink_dispatch(int index, const uint8_t *data, size_t len)
+{
+	if (index < 0 || index >= downlinks_registered)
+	{
+		command_handle(data, len);
+		return;
+	}
 
-	case MQTT_EVT_DISCONNECT:
-		LOG_INF("MQTT client disconnected: %d", evt->result);
-		break;
+	downlinks[index].handler(data, len);
+}
 
-	case MQTT_EVT_PUBLISH:
-		/* Listen to published messages received from the broker and extract the message */
-		{
-			/* Extract the payload */
-			const struct mqtt_publish_param *p = &evt->param.publish;
-			// Print the length of the recived message
-			LOG_INF("MQTT PUBLISH result=%d len=%d",
-					evt->result, p->message.payload.len);
-
-			// Extract the data of the recived message
-			err = get_received_payload(c, p->message.payload.len);
-
-			// Send acknowledgment to the broker on receiving QoS1 publish message
-			if (p->message.topic.qos == MQTT_QOS_1_AT_LEAST_ONCE)
-			{
-				const struct mqtt_puback_param ack = {
-					.message_id = p->message_id};
-
-				/* Send acknowledgment. */
-				mqtt_publish_qos1_ack(c, &ack);
-			}
-
-			/* On successful extraction of data */
-			if (err >= 0)
-			{
-				data_print("Received: ", payload_buf, p->message.payload.len);
-				// Control the LED
-				if (strncmp(payload_buf, CONFIG_TURN_LED_ON_CMD, sizeof(CONFIG_TURN_LED_ON_CMD) - 1) == 0)
-				{
-					dk_set_led_on(LED_CONTROL_OVER_MQTT);
-					g_device_state.led1_state = true;
-				}
-				else if (strncmp(payload_buf, CONFIG_TURN_LED_OFF_CMD, sizeof(CONFIG_TURN_LED_OFF_CMD) - 1) == 0)
-				{
-					dk_set_led_off(LED_CONTROL_OVER_MQTT);
-					g_device_state.led1_state = false;
-				}
-				/* On failed extraction of data */
-				// Payload buffer is smaller than the received data
-			}
-			else if (err == -EMSGSIZE)
-			{
-				LOG_ERR("Received payload (%d bytes) is larger than the payload buffer size (%d bytes).",
-						p->message.payload.len, sizeof(payload_buf));
-				// Failed to extract data, disconnect
-			}
-			else
-			{
-				LOG_ERR("get_received_payload failed: %d", err);
-				LOG_INF("Disconnecting MQTT client...");
-
-				err = mqtt_disconnect(c);
-				if (err)
-				{
-					LOG_ERR("Could not disconnect: %d", err);
-				}
-			}
-		}
-		break;
+void transport_stats_tx(size_t bytes)
+{
+	transport_stats.tx_packets++;
+	transport_stats.tx_bytes += bytes;
+}
 
-	case MQTT_EVT_PUBACK:
-		if (evt->result != 0)
-		{
-			LOG_ERR("MQTT PUBACK error: %d", evt->result);
-			break;
-		}
+void transport_stats_rx(size_t bytes)
+{
+	transport_stats.rx_packets++;
+	transport_stats.rx_bytes += bytes;
+}
 
-		LOG_INF("PUBACK packet id: %u", evt->param.puback.message_id);
-		break;
+void transport_stats_buf_used(size_t tx_bytes, size_t rx_bytes)
+{
+	transport_stats.tx_buf_peak = MAX(transport_stats.tx_buf_peak, tx_bytes);
+	transport_stats.rx_buf_peak = MAX(transport_stats.rx_buf_peak, rx_bytes);
+}
 
-	case MQTT_EVT_SUBACK:
-		if (evt->result != 0)
-		{
-			LOG_ERR("MQTT SUBACK error: %d", evt->result);
-			break;
-		}
+void transport_stats_publish(void)
+{
+	transport_stats.publishes++;
+	if (transport_stats.publishes % TRANSPORT_STATS_LOG_INTERVAL != 0)
+	{
+		return;
+	}
+	LOG_INF("Transport cost per publish: %u tx pkts, %u tx bytes, %u rx pkts, %u rx bytes (%u publishes)",
+			transport_stats.tx_packets / transport_stats.publishes,
+			transport_stats.tx_bytes / transport_stats.publishes,
+			transport_stats.rx_packets / transport_stats.publishes,
+			transport_stats.rx_bytes / transport_stats.publishes,
+			transport_stats.publishes);
+}
+
+void transport_stats_connected(bool after_cache, uint32_t elapsed_ms)
+{
+	if (after_cache)
+	{
+		transport_stats.connects_after_cache++;
+		transport_stats.connect_after_cache_ms += elapsed_ms;
+	}
+	else
+	{
+		transport_stats.connects_uncached++;
+		transport_stats.connect_uncached_ms += elapsed_ms;
+	}
+	LOG_INF("Connected in %u ms (%s), avg uncached %u ms, avg after cache %u ms",
+			elapsed_ms, after_cache ? "session cached" : "no cached session",
+			transport_stats.connects_uncached ? transport_stats.connect_uncached_ms / transport_stats.connects_uncached : 0,
+			transport_stats.connects_after_cache
+				? transport_stats.connect_after_cache_ms / transport_stats.connects_after_cache
+				: 0);
+}
 
-		LOG_INF("SUBACK packet id: %u", evt->param.suback.message_id);
-		break;
+uint8_t *data_publish_buf_get(size_t *size)
+{
+	*size = sizeof(publish_buf);
+	return publish_buf;
+}
 
-	case MQTT_EVT_PINGRESP:
-		if (evt->result != 0)
-		{
-			LOG_ERR("MQTT PINGRESP error: %d", evt->result);
-		}
-		break;
+const struct mqtt_transport_stats *mqtt_transport_stats_get(void)
+{
+	return &transport_stats;
+}
 
-	default:
-		LOG_INF("Unhandled MQTT event type: %d", evt->type);
-		break;
-	}
+void mqtt_transport_stats_peak_reset(void)
+{
+	transport_stats.tx_buf_peak = 0;
+	transport_stats.rx_buf_peak = 0;
 }
 
 /**@brief Resolves the configured hostname and
  * initializes the MQTT broker structure
  */
-static int broker_init(void)
+int broker_init(struct sockaddr_storage *broker, int socktype)
 {
 	int err;
 	struct addrinfo *result;
 	struct addrinfo *addr;
 	struct addrinfo hints = {
 		.ai_family = AF_INET,
-		.ai_socktype = SOCK_STREAM};
+		.ai_socktype = socktype};
 
 	err = getaddrinfo(CONFIG_MQTT_BROKER_HOSTNAME, NULL, &hints, &result);
 	if (err)
@@ -272,7 +238,7 @@ static int broker_init(void)
 		if (addr->ai_addrlen == sizeof(struct sockaddr_in))
 		{
 			struct sockaddr_in *broker4 =
-				((struct sockaddr_in *)&broker);
+				((struct sockaddr_in *)broker);
 			char ipv4_addr[NET_IPV4_ADDR_LEN];
 
 			broker4->sin_addr.s_addr =
@@ -305,7 +271,7 @@ static int broker_init(void)
 }
 
 /* Function to get the client id */
-static const uint8_t *client_id_get(void)
+const uint8_t *client_id_get(void)
 {
 	static uint8_t client_id[MAX(sizeof(CONFIG_MQTT_CLIENT_ID),
 								 CLIENT_ID_LEN)];
@@ -317,6 +283,7 @@ static const uint8_t *client_id_get(void)
 		goto exit;
 	}
 
+#if defined(CONFIG_NRF_MODEM_LIB)
 	char imei_buf[CGSN_RESPONSE_LENGTH + 1];
 	int err;
 
@@ -330,65 +297,12 @@ static const uint8_t *client_id_get(void)
 	imei_buf[IMEI_LEN] = '\0';
 
 	snprintf(client_id, sizeof(client_id), "nrf-%.*s", IMEI_LEN, imei_buf);
+#else
+	LOG_ERR("No modem to derive the client id from, set CONFIG_MQTT_CLIENT_ID");
+#endif
 
 exit:
 	LOG_DBG("client_id = %s", (char *)(client_id));
 
 	return client_id;
 }
-
-/**@brief Initialize the MQTT client structure
- */
-/* Define the function client_init() to initialize the MQTT client instance.  */
-int client_init(struct mqtt_client *client)
-{
-	int err;
-	/* Initializes the client instance. */
-	mqtt_client_init(client);
-
-	/* Resolves the configured hostname and initializes the MQTT broker structure */
-	err = broker_init();
-	if (err)
-	{
-		LOG_ERR("Failed to initialize broker connection");
-		return err;
-	}
-
-	/* MQTT client configuration */
-	client->broker = &broker;
-	client->evt_cb = mqtt_evt_handler;
-	client->client_id.utf8 = client_id_get();
-	client->client_id.size = strlen(client->client_id.utf8);
-	client->password = NULL;
-	client->user_name = NULL;
-	client->protocol_version = MQTT_VERSION_3_1_1;
-
-	/* MQTT buffers configuration */
-	client->rx_buf = rx_buffer;
-	client->rx_buf_size = sizeof(rx_buffer);
-	client->tx_buf = tx_buffer;
-	client->tx_buf_size = sizeof(tx_buffer);
-
-	/* We are not using TLS in Exercise 1 */
-	client->transport.type = MQTT_TRANSPORT_NON_SECURE;
-
-	return err;
-}
-
-/**@brief Initialize the file descriptor structure used by poll.
- */
-int fds_init(struct mqtt_client *c, struct pollfd *fds)
-{
-	if (c->transport.type == MQTT_TRANSPORT_NON_SECURE)
-	{
-		fds->fd = c->transport.tcp.sock;
-	}
-	else
-	{
-		return -ENOTSUP;
-	}
-
-	fds->events = POLLIN;
-
-	return 0;
-}
\ No newline at end of file
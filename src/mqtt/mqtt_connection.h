@@ -1,21 +1,142 @@
 #ifndef _MQTTCONNECTION_H_
 #define _MQTTCONNECTION_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/net/mqtt.h>
+
+#if defined(CONFIG_MQTT_TRANSPORT_SN)
+#include <zephyr/net/mqtt_sn.h>
+#endif
+
 #define LED_CONTROL_OVER_MQTT          DK_LED1 /*The LED to control over MQTT*/
 #define IMEI_LEN 15
 #define CGSN_RESPONSE_LENGTH (IMEI_LEN + 6 + 1) /* Add 6 for \r\nOK\r\n and 1 for \0 */
 #define CLIENT_ID_LEN sizeof("nrf-") + IMEI_LEN
 
+/* The client type depends on the transport selected in Kconfig (MQTT over TCP or MQTT-SN over UDP).
+ * main.c only ever handles it through the functions below.
+ */
+#if defined(CONFIG_MQTT_TRANSPORT_SN)
+typedef struct mqtt_sn_client app_mqtt_client_t;
+#else
+typedef struct mqtt_client app_mqtt_client_t;
+#endif
+
+/* Estimated on-air cost of the publishes done so far, counted at IP level (headers included).
+ * Used to compare the TCP and MQTT-SN transports.
+ */
+struct mqtt_transport_stats
+{
+	uint32_t publishes;
+	uint32_t tx_packets;
+	uint32_t tx_bytes;
+	uint32_t rx_packets;
+	uint32_t rx_bytes;
+	/* Time from client_connect() to CONNACK, split by whether a TLS session was cached
+	 * to offer. The modem does not say whether the broker took it, so a connect after
+	 * the cache may still have been a full handshake.
+	 */
+	uint32_t connects_uncached;
+	uint32_t connects_after_cache;
+	uint32_t connect_uncached_ms;
+	uint32_t connect_after_cache_ms;
+	/* Largest packet held in the client's tx/rx buffer (CONFIG_MQTT_MESSAGE_BUFFER_SIZE) */
+	uint32_t tx_buf_peak;
+	uint32_t rx_buf_peak;
+};
+
 /**@brief Initialize the MQTT client structure
  */
-int client_init(struct mqtt_client *client);
+int client_init(app_mqtt_client_t *client);
+
+/**@brief Write the CA certificate to the modem under CONFIG_MQTT_TLS_SEC_TAG.
+ * Must be called while the modem is offline (before LTE connect).
+ */
+int credentials_provision(void);
+
+/**@brief Connect to the broker (or MQTT-SN gateway).
+ */
+int client_connect(app_mqtt_client_t *client);
+
+/**@brief Disconnect from the broker (or MQTT-SN gateway).
+ */
+int client_disconnect(app_mqtt_client_t *client);
+
+/**@brief Close the connection without saying goodbye, for a link that stopped answering.
+ */
+int client_abort(app_mqtt_client_t *client);
+
+/**@brief Read and process whatever is pending on the client socket.
+ */
+int client_input(app_mqtt_client_t *client);
+
+/**@brief Keep the connection alive. Returns -EAGAIN when nothing had to be sent.
+ */
+int client_live(app_mqtt_client_t *client);
+
+/**@brief Time in ms until client_live() needs to be called again, -1 if never.
+ */
+int client_keepalive_time_left(app_mqtt_client_t *client);
+
+/**@brief Change the keepalive interval. A longer interval than the one sent in CONNECT
+ * only takes effect on the next connect, since the broker holds us to the old one until then.
+ * @return 0 if in effect now, 1 if it waits for the next connect, or a negative error.
+ */
+int client_keepalive_set(app_mqtt_client_t *client, int keepalive_s);
 
 /**@brief Initialize the file descriptor structure used by poll.
  */
-int fds_init(struct mqtt_client *c, struct pollfd *fds);
+int fds_init(app_mqtt_client_t *c, struct pollfd *fds);
 
 /**@brief Function to publish data on the configured topic
  */
-int data_publish(struct mqtt_client *c, enum mqtt_qos qos,
+int data_publish(app_mqtt_client_t *c, enum mqtt_qos qos,
+	uint8_t *data, size_t len);
+
+/**@brief Function to publish data on another topic
+ */
+int data_publish_topic(app_mqtt_client_t *c, const char *topic, enum mqtt_qos qos,
 	uint8_t *data, size_t len);
 
+/**@brief Handler for payloads received on a topic registered with mqtt_downlink_register().
+ */
+typedef void (*downlink_handler_t)(const uint8_t *data, size_t len);
+
+/**@brief Subscribe to `topic` on every connect, besides CONFIG_MQTT_SUB_TOPIC, and route
+ * what arrives on it to `handler`. Call before client_init().
+ * Over MQTT-SN these topics get the predefined ids following CONFIG_MQTT_SN_SUB_TOPIC_ID.
+ */
+int mqtt_downlink_register(const char *topic, downlink_handler_t handler);
+
+/**@brief Message id used by the last successful data_publish().
+ */
+uint16_t data_publish_last_id(void);
+
+/* Whether puback_cb_t ever gets called. The MQTT-SN library retransmits a QoS1 publish
+ * until the gateway acknowledges it, but does not say when that happened, so over MQTT-SN
+ * nothing confirms delivery and callers must not wait for it.
+ */
+#define DATA_PUBLISH_PUBACK IS_ENABLED(CONFIG_MQTT_TRANSPORT_TCP)
+
+/**@brief Get called with the message id of every acknowledged QoS1 publish.
+ * Never called unless DATA_PUBLISH_PUBACK.
+ */
+typedef void (*puback_cb_t)(uint16_t message_id);
+void data_publish_puback_cb_set(puback_cb_t cb);
+
+/**@brief Buffer to build outgoing payloads in place, handed to data_publish() afterwards.
+ * Saves a copy and a stack buffer per publish.
+ */
+uint8_t *data_publish_buf_get(size_t *size);
+
+/**@brief Get the publish cost counters of the active transport.
+ */
+const struct mqtt_transport_stats *mqtt_transport_stats_get(void);
+
+/**@brief Start tx_buf_peak and rx_buf_peak over, e.g. per benchmark point.
+ */
+void mqtt_transport_stats_peak_reset(void);
+
 #endif /* _CONNECTION_H_ */
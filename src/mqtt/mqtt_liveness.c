@@ -0,0 +1,200 @@
+#include <stdlib.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/util.h>
+
+#include "mqtt_liveness.h"
+#include "../datatypes/json_writer.h"
+
+LOG_MODULE_DECLARE(nrf9160_mqtt_gnss);
+
+#define MIN_TIMEOUT_MS CONFIG_MQTT_LIVENESS_MIN_TIMEOUT_MS
+#define MAX_TIMEOUT_MS (CONFIG_MQTT_LIVENESS_MAX_TIMEOUT_S * MSEC_PER_SEC)
+#define INITIAL_TIMEOUT_MS (CONFIG_MQTT_LIVENESS_INITIAL_TIMEOUT_S * MSEC_PER_SEC)
+
+BUILD_ASSERT(MIN_TIMEOUT_MS <= MAX_TIMEOUT_MS, "Liveness timeout range is empty");
+
+struct liveness_request
+{
+	int64_t sent_ms;
+	uint16_t message_id;
+	uint8_t type;
+	bool used;
+};
+
+static struct
+{
+	struct liveness_request requests[CONFIG_MQTT_LIVENESS_TRACKED];
+	int64_t last_rx_ms;
+	int64_t held_ms;
+	/* Scaled like in TCP stacks so the 1/8 and 1/4 gains keep their fraction */
+	uint32_t srtt8;
+	uint32_t rttvar4;
+	struct mqtt_liveness_stats stats;
+} liveness = {
+	.stats.timeout_ms = INITIAL_TIMEOUT_MS,
+};
+
+static void rtt_sample(uint32_t rtt_ms)
+{
+	struct mqtt_liveness_stats *s = &liveness.stats;
+
+	if (s->rtt_samples == 0)
+	{
+		liveness.srtt8 = rtt_ms << 3;
+		liveness.rttvar4 = rtt_ms << 1;
+	}
+	else
+	{
+		int32_t err = (int32_t)rtt_ms - (int32_t)(liveness.srtt8 >> 3);
+
+		liveness.srtt8 += err;
+		liveness.rttvar4 += abs(err) - (liveness.rttvar4 >> 2);
+	}
+
+	s->rtt_samples++;
+	s->rtt_last_ms = rtt_ms;
+	s->rtt_max_ms = MAX(s->rtt_max_ms, rtt_ms);
+	s->srtt_ms = liveness.srtt8 >> 3;
+	s->rttvar_ms = liveness.rttvar4 >> 2;
+	s->timeout_ms = CLAMP(s->srtt_ms + liveness.rttvar4, MIN_TIMEOUT_MS, MAX_TIMEOUT_MS);
+	LOG_DBG("RTT %u ms, srtt %u ms, rttvar %u ms, timeout %u ms", rtt_ms, s->srtt_ms, s->rttvar_ms,
+			s->timeout_ms);
+}
+
+void mqtt_liveness_reset(void)
+{
+	for (int i = 0; i < CONFIG_MQTT_LIVENESS_TRACKED; i++)
+	{
+		liveness.requests[i].used = false;
+	}
+	liveness.last_rx_ms = k_uptime_get();
+}
+
+void mqtt_liveness_sent(enum mqtt_liveness_request type, uint16_t message_id)
+{
+	for (int i = 0; i < CONFIG_MQTT_LIVENESS_TRACKED; i++)
+	{
+		struct liveness_request *r = &liveness.requests[i];
+
+		if (!r->used)
+		{
+			r->sent_ms = k_uptime_get();
+			r->message_id = message_id;
+			r->type = type;
+			r->used = true;
+			return;
+		}
+	}
+	/* The oldest requests are tracked already, and they set the deadline */
+	LOG_DBG("Liveness table full, request %d not timed", type);
+}
+
+void mqtt_liveness_answered(enum mqtt_liveness_request type, uint16_t message_id)
+{
+	struct liveness_request *oldest = NULL;
+
+	/* PINGRESP and CONNACK carry no id, TCP keeps them in order so the oldest is answered */
+	for (int i = 0; i < CONFIG_MQTT_LIVENESS_TRACKED; i++)
+	{
+		struct liveness_request *r = &liveness.requests[i];
+
+		if (r->used && r->type == type && (type != MQTT_LIVENESS_PUBLISH || r->message_id == message_id) &&
+			(oldest == NULL || r->sent_ms < oldest->sent_ms))
+		{
+			oldest = r;
+		}
+	}
+	if (oldest == NULL)
+	{
+		return;
+	}
+
+	oldest->used = false;
+	/* Waited out a hold, the time says nothing about the link */
+	if (oldest->sent_ms < liveness.held_ms)
+	{
+		return;
+	}
+	rtt_sample((uint32_t)(k_uptime_get() - oldest->sent_ms));
+}
+
+void mqtt_liveness_rx(void)
+{
+	liveness.last_rx_ms = k_uptime_get();
+}
+
+void mqtt_liveness_hold(void)
+{
+	liveness.held_ms = k_uptime_get();
+}
+
+bool mqtt_liveness_waiting(void)
+{
+	for (int i = 0; i < CONFIG_MQTT_LIVENESS_TRACKED; i++)
+	{
+		if (liveness.requests[i].used)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+int mqtt_liveness_time_left(void)
+{
+	int64_t oldest_ms = INT64_MAX;
+	int64_t deadline_ms;
+
+	for (int i = 0; i < CONFIG_MQTT_LIVENESS_TRACKED; i++)
+	{
+		if (liveness.requests[i].used)
+		{
+			oldest_ms = MIN(oldest_ms, liveness.requests[i].sent_ms);
+		}
+	}
+	if (oldest_ms == INT64_MAX)
+	{
+		return -1;
+	}
+
+	/* Anything heard since the request went out shows the link still works */
+	deadline_ms = MAX(MAX(oldest_ms, liveness.last_rx_ms), liveness.held_ms) + liveness.stats.timeout_ms;
+	return (int)CLAMP(deadline_ms - k_uptime_get(), 0, MAX_TIMEOUT_MS);
+}
+
+void mqtt_liveness_dead(void)
+{
+	struct mqtt_liveness_stats *s = &liveness.stats;
+	uint32_t silent_ms = (uint32_t)(k_uptime_get() - liveness.last_rx_ms);
+
+	s->dead_links++;
+	s->detect_last_ms = silent_ms;
+	s->detect_max_ms = MAX(s->detect_max_ms, silent_ms);
+	LOG_WRN("Broker silent for %u ms (timeout %u ms, srtt %u ms), link dead", silent_ms, s->timeout_ms,
+			s->srtt_ms);
+	mqtt_liveness_reset();
+}
+
+int mqtt_liveness_report_build(char *buf, size_t size)
+{
+	const struct mqtt_liveness_stats *s = &liveness.stats;
+	struct json_writer w;
+
+	json_writer_init(&w, buf, size);
+	json_add_int(&w, "rtt_ms", s->rtt_last_ms);
+	json_add_int(&w, "srtt_ms", s->srtt_ms);
+	json_add_int(&w, "rttvar_ms", s->rttvar_ms);
+	json_add_int(&w, "rtt_max_ms", s->rtt_max_ms);
+	json_add_int(&w, "samples", s->rtt_samples);
+	json_add_int(&w, "timeout_ms", s->timeout_ms);
+	json_add_int(&w, "dead_links", s->dead_links);
+	json_add_int(&w, "detect_ms", s->detect_last_ms);
+	json_add_int(&w, "detect_max_ms", s->detect_max_ms);
+	return json_writer_finish(&w);
+}
+
+const struct mqtt_liveness_stats *mqtt_liveness_stats_get(void)
+{
+	return &liveness.stats;
+}
@@ -0,0 +1,88 @@
+#ifndef _MQTTLIVENESS_H_
+#define _MQTTLIVENESS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* When the carrier drops the TCP flow without a RST, nothing comes back and the client
+ * would wait out the keepalive. Every request that the broker answers (CONNECT, PINGREQ,
+ * QoS1 PUBLISH) is timestamped, and its answer gives a round trip time sample. The
+ * smoothed RTT and its variation (as for TCP, RFC 6298) set how long an answer may take:
+ *   timeout = SRTT + 4 * RTTVAR, within CONFIG_MQTT_LIVENESS_MIN_TIMEOUT_MS and
+ *   CONFIG_MQTT_LIVENESS_MAX_TIMEOUT_S, CONFIG_MQTT_LIVENESS_INITIAL_TIMEOUT_S until the
+ *   first sample.
+ * Once the oldest unanswered request is older than that, with nothing received since it
+ * was sent, the link is dead and the caller reconnects right away.
+ *
+ * Only called from the MQTT thread, like the client itself.
+ */
+
+enum mqtt_liveness_request
+{
+	MQTT_LIVENESS_CONNECT,
+	MQTT_LIVENESS_PING,
+	MQTT_LIVENESS_PUBLISH,
+};
+
+struct mqtt_liveness_stats
+{
+	uint32_t rtt_samples;
+	uint32_t rtt_last_ms;
+	uint32_t rtt_max_ms;
+	uint32_t srtt_ms;
+	uint32_t rttvar_ms;
+	uint32_t timeout_ms;     // current dead link timeout
+	uint32_t dead_links;
+	uint32_t detect_last_ms; // silence from the broker before the last dead link was declared
+	uint32_t detect_max_ms;
+};
+
+/**@brief Forget the requests of the previous connection. Call before connecting.
+ */
+void mqtt_liveness_reset(void);
+
+/**@brief A request the broker answers went out.
+ * @param message_id The publish message id, ignored for the other requests.
+ */
+void mqtt_liveness_sent(enum mqtt_liveness_request type, uint16_t message_id);
+
+/**@brief The answer to a request came in (CONNACK, PINGRESP, PUBACK).
+ */
+void mqtt_liveness_answered(enum mqtt_liveness_request type, uint16_t message_id);
+
+/**@brief Anything came in from the broker.
+ */
+void mqtt_liveness_rx(void);
+
+/**@brief Nothing can be received for now, e.g. while GNSS has the radio. Unanswered
+ * requests get a full timeout again from here.
+ */
+void mqtt_liveness_hold(void);
+
+/**@brief A request is still unanswered. Its answer is an uplink of sorts: holding the radio
+ * keeps it from arriving.
+ */
+bool mqtt_liveness_waiting(void);
+
+/**@brief Time in ms until the link counts as dead, 0 if it is, -1 if nothing is unanswered.
+ */
+int mqtt_liveness_time_left(void);
+
+/**@brief Account a dead link and forget its requests. Call when mqtt_liveness_time_left()
+ * returned 0, before tearing the connection down.
+ */
+void mqtt_liveness_dead(void);
+
+/**@brief Write the RTT and dead link counters as a flat json object, e.g.
+ * {"rtt_ms":412,"srtt_ms":380,"rttvar_ms":95,"rtt_max_ms":2210,"samples":57,"timeout_ms":3000,
+ *  "dead_links":1,"detect_ms":3120,"detect_max_ms":3120}
+ * @return The json length, or -ENOMEM if it did not fit.
+ */
+int mqtt_liveness_report_build(char *buf, size_t size);
+
+/**@brief Get the RTT and dead link counters.
+ */
+const struct mqtt_liveness_stats *mqtt_liveness_stats_get(void);
+
+#endif /* _MQTTLIVENESS_H_ */
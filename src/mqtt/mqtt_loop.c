@@ -0,0 +1,223 @@
+#include <string.h>
+
+#include <zephyr/logging/log.h>
+#include <zephyr/kernel.h>
+#include <zephyr/net/socket.h>
+
+#if defined(SO_POLLCB)
+#include <nrf_socket.h>
+#endif
+
+#include "mqtt_connection.h"
+#include "mqtt_loop.h"
+
+/* Log the latency counters every this many handled messages */
+#define LOOP_STATS_LOG_INTERVAL 32
+
+struct loop_msg
+{
+	mqtt_loop_handler_t handler; // NULL for a publish
+	const char *topic;
+	enum mqtt_qos qos;
+	uint32_t queued_at;
+	uint16_t len;
+	uint8_t data[CONFIG_MQTT_LOOP_PAYLOAD_SIZE];
+};
+
+K_MSGQ_DEFINE(loop_msgq, sizeof(struct loop_msg), CONFIG_MQTT_LOOP_QUEUE_LEN, 4);
+
+/* The client socket is offloaded to the modem and cannot share a poll() with a kernel object */
+static struct k_poll_signal wakeup = K_POLL_SIGNAL_INITIALIZER(wakeup);
+static struct k_poll_event wakeup_event =
+	K_POLL_EVENT_STATIC_INITIALIZER(K_POLL_TYPE_SIGNAL, K_POLL_MODE_NOTIFY_ONLY, &wakeup, 0);
+static struct mqtt_loop_stats loop_stats;
+/* The modem raises the signal for socket input too, see mqtt_loop_socket_set() */
+static bool socket_cb;
+
+LOG_MODULE_DECLARE(nrf9160_mqtt_gnss);
+
+static int loop_post(struct loop_msg *msg)
+{
+	int err;
+
+	msg->queued_at = k_cycle_get_32();
+	err = k_msgq_put(&loop_msgq, msg, K_NO_WAIT);
+	if (err)
+	{
+		loop_stats.dropped++;
+		return -ENOBUFS;
+	}
+
+	/* Only has to end the wait, the queue holds the work */
+	return k_poll_signal_raise(&wakeup, 0);
+}
+
+#if defined(SO_POLLCB)
+/* Called by the modem library from its interrupt when the socket has input or an error */
+static void socket_pollcb(struct nrf_pollfd *pollfd)
+{
+	k_poll_signal_raise(&wakeup, 0);
+}
+#endif
+
+void mqtt_loop_socket_set(int fd)
+{
+#if defined(SO_POLLCB)
+	struct nrf_modem_pollcb pcb = {
+		.callback = socket_pollcb,
+		.events = NRF_POLLIN,
+		.oneshot = false,
+	};
+
+	socket_cb = setsockopt(fd, SOL_SOCKET, SO_POLLCB, &pcb, sizeof(pcb)) == 0;
+	if (!socket_cb)
+	{
+		LOG_WRN("No socket poll callback (%d), queued work waits for the socket", errno);
+	}
+#else
+	socket_cb = false;
+#endif
+}
+
+/* Without the callback: wake up every CONFIG_MQTT_LOOP_SOCKET_POLL_MS to check the socket */
+static int wait_polling(struct pollfd *fds, int timeout_ms)
+{
+	int64_t deadline = k_uptime_get() + timeout_ms;
+	int wait_ms;
+	int err;
+
+	while (1)
+	{
+		/* The socket first, so input is never starved by a busy queue */
+		err = poll(fds, 1, 0);
+		if (err != 0)
+		{
+			return err;
+		}
+
+		wait_ms = CONFIG_MQTT_LOOP_SOCKET_POLL_MS;
+		if (timeout_ms >= 0)
+		{
+			wait_ms = (int)CLAMP(deadline - k_uptime_get(), 0, wait_ms);
+			if (wait_ms == 0)
+			{
+				return 0;
+			}
+		}
+
+		if (k_poll(&wakeup_event, 1, K_MSEC(wait_ms)) == 0)
+		{
+			k_poll_signal_reset(&wakeup);
+			wakeup_event.state = K_POLL_STATE_NOT_READY;
+			return 0;
+		}
+	}
+}
+
+int mqtt_loop_wait(struct pollfd *fds, int timeout_ms, bool queue)
+{
+	int err;
+
+	if (!queue || (!socket_cb && CONFIG_MQTT_LOOP_SOCKET_POLL_MS == 0))
+	{
+		return poll(fds, 1, timeout_ms);
+	}
+	if (!socket_cb)
+	{
+		return wait_polling(fds, timeout_ms);
+	}
+
+	/* Input that arrived before the callback was armed, or while uplinks were held */
+	err = poll(fds, 1, 0);
+	if (err != 0)
+	{
+		return err;
+	}
+
+	/* Raised by a queued message or by the socket, whichever comes first */
+	k_poll(&wakeup_event, 1, timeout_ms < 0 ? K_FOREVER : K_MSEC(timeout_ms));
+	k_poll_signal_reset(&wakeup);
+	wakeup_event.state = K_POLL_STATE_NOT_READY;
+
+	/* Reset before looking, so input arriving from here on raises it again */
+	return poll(fds, 1, 0);
+}
+
+int mqtt_loop_publish(const char *topic, enum mqtt_qos qos, const uint8_t *data, size_t len)
+{
+	struct loop_msg msg = {
+		.topic = topic,
+		.qos = qos,
+		.len = len};
+
+	if (len > sizeof(msg.data))
+	{
+		return -EMSGSIZE;
+	}
+	memcpy(msg.data, data, len);
+
+	return loop_post(&msg);
+}
+
+int mqtt_loop_call(mqtt_loop_handler_t handler)
+{
+	struct loop_msg msg = {
+		.handler = handler};
+
+	return loop_post(&msg);
+}
+
+void mqtt_loop_process(app_mqtt_client_t *client)
+{
+	/* Large enough for every field, only ever touched by the MQTT thread */
+	static struct loop_msg msg;
+	int err;
+
+	while (k_msgq_get(&loop_msgq, &msg, K_NO_WAIT) == 0)
+	{
+		uint32_t latency_us = k_cyc_to_us_floor32(k_cycle_get_32() - msg.queued_at);
+
+		loop_stats.handled++;
+		loop_stats.latency_total_us += latency_us;
+		loop_stats.latency_max_us = MAX(loop_stats.latency_max_us, latency_us);
+
+		if (msg.handler != NULL)
+		{
+			msg.handler();
+		}
+		else
+		{
+			err = data_publish_topic(client, msg.topic, msg.qos, msg.data, msg.len);
+			if (err)
+			{
+				LOG_INF("Failed to send queued message, %d", err);
+			}
+		}
+
+		if (loop_stats.handled % LOOP_STATS_LOG_INTERVAL == 0)
+		{
+			LOG_INF("Loop: %u iterations, %u handled, %u dropped, latency avg %u us max %u us, iteration max %u us",
+					loop_stats.iterations, loop_stats.handled, loop_stats.dropped,
+					loop_stats.latency_total_us / loop_stats.handled, loop_stats.latency_max_us,
+					loop_stats.iteration_max_us);
+		}
+	}
+}
+
+uint32_t mqtt_loop_pending(void)
+{
+	return k_msgq_num_used_get(&loop_msgq);
+}
+
+void mqtt_loop_iteration_done(uint32_t start)
+{
+	uint32_t elapsed_us = k_cyc_to_us_floor32(k_cycle_get_32() - start);
+
+	loop_stats.iterations++;
+	loop_stats.iteration_max_us = MAX(loop_stats.iteration_max_us, elapsed_us);
+}
+
+const struct mqtt_loop_stats *mqtt_loop_stats_get(void)
+{
+	return &loop_stats;
+}
@@ -0,0 +1,71 @@
+#ifndef _MQTTLOOP_H_
+#define _MQTTLOOP_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mqtt_connection.h"
+
+/* Everything that touches the MQTT client runs on the MQTT thread. Other contexts
+ * (button handler, work items, timers) queue their publishes or calls here and raise a
+ * k_poll_signal. The modem's offloaded socket cannot be polled together with a kernel
+ * object, so the modem library's poll callback (SO_POLLCB) raises the same signal for
+ * socket input and mqtt_loop_wait() blocks on the signal alone.
+ * Without the callback, mqtt_loop_wait() blocks on the socket and queued work waits for
+ * socket input or the timeout, unless CONFIG_MQTT_LOOP_SOCKET_POLL_MS is set.
+ */
+
+/**@brief Function run on the MQTT thread, see mqtt_loop_call().
+ */
+typedef void (*mqtt_loop_handler_t)(void);
+
+/* Time from queueing to handling on the MQTT thread, and time spent per loop iteration */
+struct mqtt_loop_stats
+{
+	uint32_t iterations;
+	uint32_t handled;
+	uint32_t dropped;
+	uint32_t latency_total_us;
+	uint32_t latency_max_us;
+	uint32_t iteration_max_us;
+};
+
+/**@brief Have the modem raise the loop's signal for input on the client socket. Call
+ * once the client is connected, before mqtt_loop_wait().
+ */
+void mqtt_loop_socket_set(int fd);
+
+/**@brief Wait for the client socket, queued work or timeout_ms (-1 for no timeout).
+ * @param queue false to only watch the socket, e.g. while uplinks are held.
+ * @return What poll() returned on the socket: > 0 if it has events, 0 if not, -1 with
+ * errno set on an error.
+ */
+int mqtt_loop_wait(struct pollfd *fds, int timeout_ms, bool queue);
+
+/**@brief Queue a publish. The payload is copied (at most CONFIG_MQTT_LOOP_PAYLOAD_SIZE).
+ * Safe from any thread or work item. `topic` must stay valid until it is sent.
+ */
+int mqtt_loop_publish(const char *topic, enum mqtt_qos qos, const uint8_t *data, size_t len);
+
+/**@brief Run `handler` on the MQTT thread. Safe from any thread, work item or timer.
+ */
+int mqtt_loop_call(mqtt_loop_handler_t handler);
+
+/**@brief Handle everything queued so far. Call from the MQTT thread.
+ */
+void mqtt_loop_process(app_mqtt_client_t *client);
+
+/**@brief Number of publishes and calls waiting for the MQTT thread.
+ */
+uint32_t mqtt_loop_pending(void);
+
+/**@brief Account one loop iteration that started at `start` (k_cycle_get_32()).
+ */
+void mqtt_loop_iteration_done(uint32_t start);
+
+/**@brief Get the loop latency counters.
+ */
+const struct mqtt_loop_stats *mqtt_loop_stats_get(void);
+
+#endif /* _MQTTLOOP_H_ */
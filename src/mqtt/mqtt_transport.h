@@ -0,0 +1,57 @@
+#ifndef _MQTTTRANSPORT_H_
+#define _MQTTTRANSPORT_H_
+
+/* Helpers shared by the transport implementations (mqtt_transport_tcp.c, mqtt_transport_sn.c).
+ * Not meant to be used outside of the mqtt module.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/net/socket.h>
+
+/* IPv4 + transport header sizes, used for the on-air estimates in struct mqtt_transport_stats */
+#define IPV4_HDR_LEN 20
+#define TCP_HDR_LEN 20
+#define UDP_HDR_LEN 8
+
+/**@brief Resolves the configured hostname and initializes the broker address.
+ * @param socktype SOCK_STREAM for MQTT, SOCK_DGRAM for MQTT-SN.
+ */
+int broker_init(struct sockaddr_storage *broker, int socktype);
+
+/**@brief Get the client id, either CONFIG_MQTT_CLIENT_ID or derived from the IMEI.
+ */
+const uint8_t *client_id_get(void);
+
+/**@brief Number of topics registered with mqtt_downlink_register(), and their names.
+ */
+size_t downlink_count(void);
+const char *downlink_topic(size_t index);
+
+/**@brief Index of the registered downlink topic matching `topic`, -ENOENT if none.
+ */
+int downlink_index(const uint8_t *topic, size_t topic_len);
+
+/**@brief Hand a received payload to the handler of downlink `index`.
+ * A negative index means CONFIG_MQTT_SUB_TOPIC (LED commands).
+ */
+void downlink_dispatch(int index, const uint8_t *data, size_t len);
+
+/**@brief Next message id for a publish, never 0.
+ */
+uint16_t message_id_next(void);
+
+/**@brief Forward a PUBACK to the registered puback_cb_t.
+ */
+void puback_handle(uint16_t message_id);
+
+/**@brief Account one packet in the transport stats.
+ */
+void transport_stats_tx(size_t bytes);
+void transport_stats_rx(size_t bytes);
+void transport_stats_publish(void);
+void transport_stats_connected(bool after_cache, uint32_t elapsed_ms);
+void transport_stats_buf_used(size_t tx_bytes, size_t rx_bytes);
+
+#endif /* _MQTTTRANSPORT_H_ */
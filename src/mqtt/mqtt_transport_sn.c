@@ -0,0 +1,382 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <zephyr/logging/log.h>
+#include <zephyr/kernel.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/net/mqtt_sn.h>
+
+#include "mqtt_connection.h"
+#include "mqtt_loop.h"
+#include "mqtt_transport.h"
+
+/* MQTT-SN PUBLISH header: length, msg type, flags, topic id, msg id. PUBACK is fixed size. */
+#define MQTT_SN_PUBLISH_HDR_LEN 7
+#define MQTT_SN_PUBACK_LEN 7
+
+/* Buffers for MQTT-SN client. */
+static uint8_t rx_buffer[CONFIG_MQTT_MESSAGE_BUFFER_SIZE];
+static uint8_t tx_buffer[CONFIG_MQTT_MESSAGE_BUFFER_SIZE];
+
+/* A publish made while the client sleeps is held here until the gateway has woken us up. */
+static uint8_t pending_buf[CONFIG_MQTT_PAYLOAD_BUFFER_SIZE];
+static size_t pending_len;
+static enum mqtt_qos pending_qos;
+static const char *pending_topic;
+
+/* MQTT-SN gateway details. */
+static struct sockaddr_storage gateway;
+static struct mqtt_sn_transport_udp udp_transport;
+
+static struct mqtt_sn_data pub_topic = MQTT_SN_DATA_STRING_LITERAL(CONFIG_MQTT_PUB_TOPIC);
+static struct mqtt_sn_data sub_topic = MQTT_SN_DATA_STRING_LITERAL(CONFIG_MQTT_SUB_TOPIC);
+static struct mqtt_sn_data downlink_topics[CONFIG_MQTT_DOWNLINK_TOPICS_MAX];
+
+static bool sn_connected;
+static bool sn_asleep;
+
+/* Sleep once no publish happened for this long, leaving time for the PUBACK to arrive */
+#define SLEEP_GRACE_MS 2000
+static struct mqtt_sn_client *sn_client;
+static uint16_t sleep_duration_s = CONFIG_MQTT_SN_SLEEP_DURATION_S;
+static void sleep_work_fn(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(sleep_work, sleep_work_fn);
+
+LOG_MODULE_DECLARE(nrf9160_mqtt_gnss);
+
+static enum mqtt_sn_qos qos_to_sn(enum mqtt_qos qos)
+{
+	switch (qos)
+	{
+	case MQTT_QOS_0_AT_MOST_ONCE:
+		return MQTT_SN_QOS_0;
+	case MQTT_QOS_1_AT_LEAST_ONCE:
+		return MQTT_SN_QOS_1;
+	default:
+		return MQTT_SN_QOS_2;
+	}
+}
+
+/* Downlink topics are predefined right after CONFIG_MQTT_SN_SUB_TOPIC_ID. -1 for the LED commands. */
+static int downlink_index_from_id(uint16_t topic_id)
+{
+	if (CONFIG_MQTT_SN_SUB_TOPIC_ID == 0 || topic_id <= CONFIG_MQTT_SN_SUB_TOPIC_ID ||
+		topic_id > CONFIG_MQTT_SN_SUB_TOPIC_ID + downlink_count())
+	{
+		return -1;
+	}
+	return topic_id - CONFIG_MQTT_SN_SUB_TOPIC_ID - 1;
+}
+
+static int publish_now(struct mqtt_sn_client *c, const char *topic, enum mqtt_qos qos,
+					   uint8_t *data, size_t len)
+{
+	int err;
+	struct mqtt_sn_data payload = {
+		.data = data,
+		.size = len};
+	/* Other topics are registered by name, the library keeps its own copy */
+	struct mqtt_sn_data topic_name = {
+		.data = (const uint8_t *)topic,
+		.size = strlen(topic)};
+
+	/* Every publish goes through here, so only at debug level */
+	LOG_HEXDUMP_DBG(data, len, "Publishing:");
+	LOG_DBG("to topic: %s", topic);
+
+	err = mqtt_sn_publish(c, qos_to_sn(qos), strcmp(topic, CONFIG_MQTT_PUB_TOPIC) == 0 ? &pub_topic : &topic_name,
+						  false, &payload);
+	if (err == 0)
+	{
+		/* Keeps data_publish_last_id() counting publishes, the library picks its own ids */
+		(void)message_id_next();
+
+		/* The whole packet is encoded into tx_buffer */
+		transport_stats_buf_used(MQTT_SN_PUBLISH_HDR_LEN + len, 0);
+		transport_stats_tx(IPV4_HDR_LEN + UDP_HDR_LEN + MQTT_SN_PUBLISH_HDR_LEN + len);
+		if (qos != MQTT_QOS_0_AT_MOST_ONCE)
+		{
+			/* The library retransmits until the PUBACK arrives but does not report it,
+			 * so only its cost is accounted. Nothing is passed to puback_handle().
+			 */
+			transport_stats_rx(IPV4_HDR_LEN + UDP_HDR_LEN + MQTT_SN_PUBACK_LEN);
+		}
+		transport_stats_publish();
+		k_work_reschedule(&sleep_work, K_MSEC(SLEEP_GRACE_MS));
+	}
+
+	return err;
+}
+
+/**@brief Put the client to sleep at the gateway, if configured. The gateway buffers
+ * messages for us until we wake up, so the modem can stay in PSM.
+ */
+static void sleep_now(void)
+{
+	int err;
+
+	if (CONFIG_MQTT_SN_SLEEP_DURATION_S == 0 || pending_len > 0 || sn_asleep || !sn_connected)
+	{
+		return;
+	}
+
+	err = mqtt_sn_sleep(sn_client, sleep_duration_s);
+	if (err)
+	{
+		LOG_ERR("mqtt_sn_sleep failed: %d", err);
+	}
+}
+
+/* The client is only driven from the MQTT thread */
+static void sleep_work_fn(struct k_work *work)
+{
+	mqtt_loop_call(sleep_now);
+}
+
+/**@brief MQTT-SN client event handler
+ */
+static void mqtt_sn_evt_handler(struct mqtt_sn_client *c, const struct mqtt_sn_evt *evt)
+{
+	int err;
+
+	switch (evt->type)
+	{
+	case MQTT_SN_EVT_CONNECTED:
+		LOG_INF("MQTT-SN client connected");
+		sn_connected = true;
+		sn_asleep = false;
+
+		err = mqtt_sn_subscribe(c, MQTT_SN_QOS_1, &sub_topic);
+		if (err)
+		{
+			LOG_ERR("mqtt_sn_subscribe failed: %d", err);
+		}
+
+		for (size_t i = 0; i < downlink_count(); i++)
+		{
+			err = mqtt_sn_subscribe(c, MQTT_SN_QOS_1, &downlink_topics[i]);
+			if (err)
+			{
+				LOG_ERR("mqtt_sn_subscribe %s failed: %d", downlink_topic(i), err);
+			}
+		}
+
+		if (pending_len > 0)
+		{
+			size_t len = pending_len;
+
+			pending_len = 0;
+			err = publish_now(c, pending_topic, pending_qos, pending_buf, len);
+			if (err)
+			{
+				LOG_ERR("Failed to send held message: %d", err);
+			}
+		}
+		break;
+
+	case MQTT_SN_EVT_DISCONNECTED:
+		LOG_INF("MQTT-SN client disconnected");
+		sn_connected = false;
+		break;
+
+	case MQTT_SN_EVT_ASLEEP:
+		LOG_INF("MQTT-SN client asleep");
+		sn_asleep = true;
+		break;
+
+	case MQTT_SN_EVT_AWAKE:
+		LOG_INF("MQTT-SN client awake");
+		sn_asleep = false;
+		break;
+
+	case MQTT_SN_EVT_PUBLISH:
+		LOG_INF("MQTT-SN PUBLISH topic id=%u len=%u",
+				evt->param.publish.topic_id, evt->param.publish.data.size);
+		transport_stats_buf_used(0, MQTT_SN_PUBLISH_HDR_LEN + evt->param.publish.data.size);
+		if (evt->param.publish.data.size > 0)
+		{
+			downlink_dispatch(downlink_index_from_id(evt->param.publish.topic_id),
+							  evt->param.publish.data.data, evt->param.publish.data.size);
+		}
+		break;
+
+	case MQTT_SN_EVT_PINGRESP:
+		LOG_DBG("MQTT-SN PINGRESP");
+		break;
+
+	default:
+		LOG_INF("Unhandled MQTT-SN event type: %d", evt->type);
+		break;
+	}
+}
+
+int data_publish(struct mqtt_sn_client *c, enum mqtt_qos qos,
+				 uint8_t *data, size_t len)
+{
+	return data_publish_topic(c, CONFIG_MQTT_PUB_TOPIC, qos, data, len);
+}
+
+int data_publish_topic(struct mqtt_sn_client *c, const char *topic, enum mqtt_qos qos,
+					   uint8_t *data, size_t len)
+{
+	int err;
+
+	if (!sn_asleep)
+	{
+		return publish_now(c, topic, qos, data, len);
+	}
+
+	/* Waking up is a CONNECT, the message goes out on MQTT_SN_EVT_CONNECTED */
+	if (len > sizeof(pending_buf))
+	{
+		return -EMSGSIZE;
+	}
+	memcpy(pending_buf, data, len);
+	pending_len = len;
+	pending_qos = qos;
+	pending_topic = topic;
+
+	err = mqtt_sn_connect(c, false, false);
+	if (err)
+	{
+		LOG_ERR("Failed to wake MQTT-SN client: %d", err);
+		pending_len = 0;
+	}
+
+	return err;
+}
+
+/**@brief Initialize the MQTT-SN client structure
+ */
+int client_init(struct mqtt_sn_client *client)
+{
+	int err;
+	struct mqtt_sn_data client_id;
+
+	/* Resolves the configured hostname and initializes the gateway structure */
+	err = broker_init(&gateway, SOCK_DGRAM);
+	if (err)
+	{
+		LOG_ERR("Failed to initialize gateway connection");
+		return err;
+	}
+
+	err = mqtt_sn_transport_udp_init(&udp_transport, (struct sockaddr *)&gateway,
+									 sizeof(struct sockaddr_in));
+	if (err)
+	{
+		LOG_ERR("Failed to initialize UDP transport: %d", err);
+		return err;
+	}
+
+	sn_client = client;
+	client_id.data = client_id_get();
+	client_id.size = strlen(client_id.data);
+
+	err = mqtt_sn_client_init(client, &client_id, &udp_transport.tp, mqtt_sn_evt_handler,
+							  tx_buffer, sizeof(tx_buffer), rx_buffer, sizeof(rx_buffer));
+	if (err)
+	{
+		LOG_ERR("Failed to initialize MQTT-SN client: %d", err);
+		return err;
+	}
+
+	/* Predefined topics skip the REGISTER round trip, the gateway must know the same ids */
+	if (CONFIG_MQTT_SN_PUB_TOPIC_ID > 0)
+	{
+		err = mqtt_sn_predefine_topic(client, CONFIG_MQTT_SN_PUB_TOPIC_ID, &pub_topic);
+		if (err)
+		{
+			LOG_ERR("Failed to predefine publish topic: %d", err);
+			return err;
+		}
+	}
+
+	if (CONFIG_MQTT_SN_SUB_TOPIC_ID > 0)
+	{
+		err = mqtt_sn_predefine_topic(client, CONFIG_MQTT_SN_SUB_TOPIC_ID, &sub_topic);
+		if (err)
+		{
+			LOG_ERR("Failed to predefine subscribe topic: %d", err);
+			return err;
+		}
+	}
+
+	for (size_t i = 0; i < downlink_count(); i++)
+	{
+		downlink_topics[i].data = (const uint8_t *)downlink_topic(i);
+		downlink_topics[i].size = strlen(downlink_topic(i));
+		if (CONFIG_MQTT_SN_SUB_TOPIC_ID == 0)
+		{
+			continue;
+		}
+
+		err = mqtt_sn_predefine_topic(client, CONFIG_MQTT_SN_SUB_TOPIC_ID + 1 + i, &downlink_topics[i]);
+		if (err)
+		{
+			LOG_ERR("Failed to predefine topic %s: %d", downlink_topic(i), err);
+			return err;
+		}
+	}
+
+	return 0;
+}
+
+int client_connect(struct mqtt_sn_client *client)
+{
+	sn_asleep = false;
+	return mqtt_sn_connect(client, false, true);
+}
+
+int client_disconnect(struct mqtt_sn_client *client)
+{
+	sn_connected = false;
+	return mqtt_sn_disconnect(client);
+}
+
+/* Nothing to tear down over UDP besides our own state */
+int client_abort(struct mqtt_sn_client *client)
+{
+	return client_disconnect(client);
+}
+
+int client_input(struct mqtt_sn_client *client)
+{
+	return mqtt_sn_input(client);
+}
+
+/* Keepalive and retransmissions are driven by the MQTT-SN library's own work item */
+int client_live(struct mqtt_sn_client *client)
+{
+	ARG_UNUSED(client);
+	return -EAGAIN;
+}
+
+int client_keepalive_time_left(struct mqtt_sn_client *client)
+{
+	ARG_UNUSED(client);
+	return SYS_FOREVER_MS;
+}
+
+/* The ping interval is CONFIG_MQTT_SN_KEEPALIVE, what we can align is how long we sleep at the gateway */
+int client_keepalive_set(struct mqtt_sn_client *client, int keepalive_s)
+{
+	ARG_UNUSED(client);
+	if (CONFIG_MQTT_SN_SLEEP_DURATION_S > 0)
+	{
+		sleep_duration_s = keepalive_s;
+	}
+	return 0;
+}
+
+/**@brief Initialize the file descriptor structure used by poll.
+ */
+int fds_init(struct mqtt_sn_client *c, struct pollfd *fds)
+{
+	ARG_UNUSED(c);
+
+	fds->fd = udp_transport.sock;
+	fds->events = POLLIN;
+
+	return 0;
+}
@@ -0,0 +1,493 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <zephyr/logging/log.h>
+#include <zephyr/kernel.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/net/mqtt.h>
+
+#include "mqtt_connection.h"
+#include "mqtt_transport.h"
+#include "mqtt_liveness.h"
+
+#if defined(CONFIG_MQTT_TLS)
+#include <zephyr/net/tls_credentials.h>
+#include <modem/modem_key_mgmt.h>
+#endif
+
+/* MQTT fixed header (type + up to 4 length bytes) and the PUBACK size */
+#define MQTT_PUBACK_LEN 4
+
+/* Buffers for MQTT client. */
+static uint8_t rx_buffer[CONFIG_MQTT_MESSAGE_BUFFER_SIZE];
+static uint8_t tx_buffer[CONFIG_MQTT_MESSAGE_BUFFER_SIZE];
+static uint8_t payload_buf[CONFIG_MQTT_PAYLOAD_BUFFER_SIZE];
+
+/* MQTT Broker details. */
+static struct sockaddr_storage broker;
+
+#if defined(CONFIG_MQTT_TLS)
+static sec_tag_t sec_tag_list[] = {CONFIG_MQTT_TLS_SEC_TAG};
+#endif
+
+#if defined(CONFIG_MQTT_TLS_PROVISION_CA)
+static const uint8_t ca_cert[] = {
+#include "mqtt_ca_cert.inc"
+};
+#endif
+
+/* Connect timing. With session caching, the modem keeps the session of the first
+ * successful handshake per security tag and offers it on later connects. Whether the
+ * broker resumed it is not reported, only that a session was there to offer.
+ */
+static int64_t connect_start_time;
+static bool tls_session_established;
+
+/* Keepalive to announce in the next CONNECT */
+static uint16_t keepalive_next = CONFIG_MQTT_KEEPALIVE;
+
+LOG_MODULE_DECLARE(nrf9160_mqtt_gnss);
+
+/**@brief Function to get the payload of recived data.
+ */
+static int get_received_payload(struct mqtt_client *c, size_t length)
+{
+	int ret;
+	int err = 0;
+
+	/* Return an error if the payload is larger than the payload buffer.
+	 * Note: To allow new messages, we have to read the payload before returning.
+	 */
+	if (length > sizeof(payload_buf))
+	{
+		err = -EMSGSIZE;
+	}
+
+	/* Truncate payload until it fits in the payload buffer. */
+	while (length > sizeof(payload_buf))
+	{
+		ret = mqtt_read_publish_payload_blocking(
+			c, payload_buf, (length - sizeof(payload_buf)));
+		if (ret == 0)
+		{
+			return -EIO;
+		}
+		else if (ret < 0)
+		{
+			return ret;
+		}
+
+		length -= ret;
+	}
+
+	ret = mqtt_readall_publish_payload(c, payload_buf, length);
+	if (ret)
+	{
+		return ret;
+	}
+
+	return err;
+}
+
+/**@brief Function to subscribe to the configured topic, and the registered downlink topics
+ */
+static int subscribe(struct mqtt_client *const c)
+{
+	struct mqtt_topic subscribe_topics[1 + CONFIG_MQTT_DOWNLINK_TOPICS_MAX] = {
+		{
+			.topic = {
+				.utf8 = CONFIG_MQTT_SUB_TOPIC,
+				.size = strlen(CONFIG_MQTT_SUB_TOPIC)},
+			.qos = MQTT_QOS_1_AT_LEAST_ONCE}};
+
+	for (size_t i = 0; i < downlink_count(); i++)
+	{
+		subscribe_topics[1 + i].topic.utf8 = downlink_topic(i);
+		subscribe_topics[1 + i].topic.size = strlen(downlink_topic(i));
+		subscribe_topics[1 + i].qos = MQTT_QOS_1_AT_LEAST_ONCE;
+	}
+
+	const struct mqtt_subscription_list subscription_list = {
+		.list = subscribe_topics,
+		.list_count = 1 + downlink_count(),
+		.message_id = 1234};
+
+	for (size_t i = 0; i < subscription_list.list_count; i++)
+	{
+		LOG_INF("Subscribing to: %s len %u", (char *)subscribe_topics[i].topic.utf8,
+				subscribe_topics[i].topic.size);
+	}
+
+	return mqtt_subscribe(c, &subscription_list);
+}
+
+/**@brief Size of an encoded PUBLISH packet, fixed header included.
+ */
+static size_t publish_packet_len(enum mqtt_qos qos, size_t topic_len, size_t payload_len)
+{
+	size_t remaining = 2 + topic_len + payload_len;
+	size_t len_bytes = 1;
+
+	if (qos != MQTT_QOS_0_AT_MOST_ONCE)
+	{
+		remaining += 2; /* message id */
+	}
+
+	for (size_t r = remaining; r > 127; r >>= 7)
+	{
+		len_bytes++;
+	}
+
+	return 1 + len_bytes + remaining;
+}
+
+/**@brief Function to publish data on the configured topic
+ */
+int data_publish(struct mqtt_client *c, enum mqtt_qos qos,
+				 uint8_t *data, size_t len)
+{
+	return data_publish_topic(c, CONFIG_MQTT_PUB_TOPIC, qos, data, len);
+}
+
+/**@brief Function to publish data on another topic
+ */
+int data_publish_topic(struct mqtt_client *c, const char *topic, enum mqtt_qos qos,
+					   uint8_t *data, size_t len)
+{
+	int err;
+	struct mqtt_publish_param param;
+
+	param.message.topic.qos = qos;
+	param.message.topic.topic.utf8 = topic;
+	param.message.topic.topic.size = strlen(topic);
+	param.message.payload.data = data;
+	param.message.payload.len = len;
+	param.message_id = message_id_next();
+	param.dup_flag = 0;
+	param.retain_flag = 0;
+
+	/* Every publish goes through here, so only at debug level */
+	LOG_HEXDUMP_DBG(data, len, "Publishing:");
+	LOG_DBG("to topic: %s len: %u",
+			topic,
+			(unsigned int)strlen(topic));
+
+	err = mqtt_publish(c, &param);
+	if (err == 0)
+	{
+		/* Only the header goes through tx_buffer, the payload is sent from `data` */
+		transport_stats_buf_used(publish_packet_len(qos, strlen(topic), len) - len, 0);
+		/* One data segment, and the broker's TCP ACK for it */
+		transport_stats_tx(IPV4_HDR_LEN + TCP_HDR_LEN +
+						   publish_packet_len(qos, strlen(topic), len));
+		transport_stats_rx(IPV4_HDR_LEN + TCP_HDR_LEN);
+		if (qos == MQTT_QOS_0_AT_MOST_ONCE)
+		{
+			transport_stats_publish();
+		}
+#if defined(CONFIG_MQTT_LIVENESS)
+		else
+		{
+			mqtt_liveness_sent(MQTT_LIVENESS_PUBLISH, param.message_id);
+		}
+#endif
+	}
+
+	return err;
+}
+/**@brief MQTT client event handler
+ */
+void mqtt_evt_handler(struct mqtt_client *const c,
+					  const struct mqtt_evt *evt)
+{
+	int err;
+
+#if defined(CONFIG_MQTT_LIVENESS)
+	mqtt_liveness_rx();
+#endif
+
+	switch (evt->type)
+	{
+	case MQTT_EVT_CONNACK:
+		/* Subscribe to the topic CONFIG_MQTT_SUB_TOPIC when we have a successful connection */
+		if (evt->result != 0)
+		{
+			LOG_ERR("MQTT connect failed: %d", evt->result);
+			break;
+		}
+
+		LOG_INF("MQTT client connected");
+#if defined(CONFIG_MQTT_LIVENESS)
+		mqtt_liveness_answered(MQTT_LIVENESS_CONNECT, 0);
+#endif
+		transport_stats_connected(IS_ENABLED(CONFIG_MQTT_TLS_SESSION_CACHING) && tls_session_established,
+								  (uint32_t)(k_uptime_get() - connect_start_time));
+		tls_session_established = IS_ENABLED(CONFIG_MQTT_TLS);
+		subscribe(c);
+		break;
+
+	case MQTT_EVT_DISCONNECT:
+		LOG_INF("MQTT client disconnected: %d", evt->result);
+		break;
+
+	case MQTT_EVT_PUBLISH:
+		/* Listen to published messages received from the broker and extract the message */
+		{
+			/* Extract the payload */
+			const struct mqtt_publish_param *p = &evt->param.publish;
+			// Print the length of the recived message
+			LOG_INF("MQTT PUBLISH result=%d len=%d",
+					evt->result, p->message.payload.len);
+
+			// Extract the data of the recived message
+			err = get_received_payload(c, p->message.payload.len);
+			transport_stats_buf_used(0, publish_packet_len(p->message.topic.qos, p->message.topic.topic.size,
+														   p->message.payload.len) -
+											p->message.payload.len);
+
+			// Send acknowledgment to the broker on receiving QoS1 publish message
+			if (p->message.topic.qos == MQTT_QOS_1_AT_LEAST_ONCE)
+			{
+				const struct mqtt_puback_param ack = {
+					.message_id = p->message_id};
+
+				/* Send acknowledgment. */
+				mqtt_publish_qos1_ack(c, &ack);
+			}
+
+			/* On successful extraction of data */
+			if (err >= 0)
+			{
+				downlink_dispatch(downlink_index(p->message.topic.topic.utf8, p->message.topic.topic.size),
+								  payload_buf, p->message.payload.len);
+				/* On failed extraction of data */
+				// Payload buffer is smaller than the received data
+			}
+			else if (err == -EMSGSIZE)
+			{
+				LOG_ERR("Received payload (%d bytes) is larger than the payload buffer size (%d bytes).",
+						p->message.payload.len, sizeof(payload_buf));
+				// Failed to extract data, disconnect
+			}
+			else
+			{
+				LOG_ERR("get_received_payload failed: %d", err);
+				LOG_INF("Disconnecting MQTT client...");
+
+				err = mqtt_disconnect(c);
+				if (err)
+				{
+					LOG_ERR("Could not disconnect: %d", err);
+				}
+			}
+		}
+		break;
+
+	case MQTT_EVT_PUBACK:
+		if (evt->result != 0)
+		{
+			LOG_ERR("MQTT PUBACK error: %d", evt->result);
+			break;
+		}
+
+		LOG_DBG("PUBACK packet id: %u", evt->param.puback.message_id);
+#if defined(CONFIG_MQTT_LIVENESS)
+		mqtt_liveness_answered(MQTT_LIVENESS_PUBLISH, evt->param.puback.message_id);
+#endif
+		puback_handle(evt->param.puback.message_id);
+		transport_stats_buf_used(0, MQTT_PUBACK_LEN);
+		/* PUBACK segment, and our TCP ACK for it */
+		transport_stats_rx(IPV4_HDR_LEN + TCP_HDR_LEN + MQTT_PUBACK_LEN);
+		transport_stats_tx(IPV4_HDR_LEN + TCP_HDR_LEN);
+		transport_stats_publish();
+		break;
+
+	case MQTT_EVT_SUBACK:
+		if (evt->result != 0)
+		{
+			LOG_ERR("MQTT SUBACK error: %d", evt->result);
+			break;
+		}
+
+		LOG_INF("SUBACK packet id: %u", evt->param.suback.message_id);
+		break;
+
+	case MQTT_EVT_PINGRESP:
+		if (evt->result != 0)
+		{
+			LOG_ERR("MQTT PINGRESP error: %d", evt->result);
+			break;
+		}
+#if defined(CONFIG_MQTT_LIVENESS)
+		mqtt_liveness_answered(MQTT_LIVENESS_PING, 0);
+#endif
+		break;
+
+	default:
+		LOG_INF("Unhandled MQTT event type: %d", evt->type);
+		break;
+	}
+}
+
+/**@brief Initialize the MQTT client structure
+ */
+/* Define the function client_init() to initialize the MQTT client instance.  */
+int client_init(struct mqtt_client *client)
+{
+	int err;
+	/* Initializes the client instance. */
+	mqtt_client_init(client);
+
+	/* Resolves the configured hostname and initializes the MQTT broker structure */
+	err = broker_init(&broker, SOCK_STREAM);
+	if (err)
+	{
+		LOG_ERR("Failed to initialize broker connection");
+		return err;
+	}
+
+	/* MQTT client configuration */
+	client->broker = &broker;
+	client->evt_cb = mqtt_evt_handler;
+	client->client_id.utf8 = client_id_get();
+	client->client_id.size = strlen(client->client_id.utf8);
+	client->password = NULL;
+	client->user_name = NULL;
+	client->protocol_version = MQTT_VERSION_3_1_1;
+
+	/* MQTT buffers configuration */
+	client->rx_buf = rx_buffer;
+	client->rx_buf_size = sizeof(rx_buffer);
+	client->tx_buf = tx_buffer;
+	client->tx_buf_size = sizeof(tx_buffer);
+
+#if defined(CONFIG_MQTT_TLS)
+	struct mqtt_sec_config *tls_cfg = &(client->transport).tls.config;
+
+	client->transport.type = MQTT_TRANSPORT_SECURE;
+
+	tls_cfg->peer_verify = CONFIG_MQTT_TLS_PEER_VERIFY;
+	tls_cfg->cipher_list = NULL;
+	tls_cfg->cipher_count = 0;
+	tls_cfg->sec_tag_count = ARRAY_SIZE(sec_tag_list);
+	tls_cfg->sec_tag_list = sec_tag_list;
+	tls_cfg->hostname = CONFIG_MQTT_BROKER_HOSTNAME;
+	tls_cfg->session_cache = IS_ENABLED(CONFIG_MQTT_TLS_SESSION_CACHING) ? TLS_SESSION_CACHE_ENABLED : TLS_SESSION_CACHE_DISABLED;
+#else
+	client->transport.type = MQTT_TRANSPORT_NON_SECURE;
+#endif
+
+	return err;
+}
+
+int credentials_provision(void)
+{
+#if defined(CONFIG_MQTT_TLS_PROVISION_CA)
+	int err;
+
+	/* Skip the write if the modem already holds this certificate, it wears the modem flash */
+	err = modem_key_mgmt_cmp(CONFIG_MQTT_TLS_SEC_TAG, MODEM_KEY_MGMT_CRED_TYPE_CA_CHAIN,
+							 ca_cert, sizeof(ca_cert));
+	if (err == 0)
+	{
+		LOG_INF("CA certificate already provisioned in sec tag %d", CONFIG_MQTT_TLS_SEC_TAG);
+		return 0;
+	}
+
+	LOG_INF("Provisioning CA certificate in sec tag %d", CONFIG_MQTT_TLS_SEC_TAG);
+	err = modem_key_mgmt_write(CONFIG_MQTT_TLS_SEC_TAG, MODEM_KEY_MGMT_CRED_TYPE_CA_CHAIN,
+							   ca_cert, sizeof(ca_cert));
+	if (err)
+	{
+		LOG_ERR("Failed to provision CA certificate: %d", err);
+		return err;
+	}
+#endif
+	return 0;
+}
+
+int client_connect(struct mqtt_client *client)
+{
+	int err;
+
+	connect_start_time = k_uptime_get();
+	client->keepalive = keepalive_next;
+	err = mqtt_connect(client);
+#if defined(CONFIG_MQTT_LIVENESS)
+	if (err == 0)
+	{
+		mqtt_liveness_reset();
+		mqtt_liveness_sent(MQTT_LIVENESS_CONNECT, 0);
+	}
+#endif
+	return err;
+}
+
+int client_disconnect(struct mqtt_client *client)
+{
+	return mqtt_disconnect(client);
+}
+
+/* No DISCONNECT, on a dead link it would only sit in the socket's send buffer */
+int client_abort(struct mqtt_client *client)
+{
+	return mqtt_abort(client);
+}
+
+int client_input(struct mqtt_client *client)
+{
+	return mqtt_input(client);
+}
+
+int client_live(struct mqtt_client *client)
+{
+	int err = mqtt_live(client);
+
+#if defined(CONFIG_MQTT_LIVENESS)
+	if (err == 0)
+	{
+		mqtt_liveness_sent(MQTT_LIVENESS_PING, 0);
+	}
+#endif
+	return err;
+}
+
+int client_keepalive_time_left(struct mqtt_client *client)
+{
+	return mqtt_keepalive_time_left(client);
+}
+
+int client_keepalive_set(struct mqtt_client *client, int keepalive_s)
+{
+	keepalive_next = keepalive_s;
+	if (keepalive_s <= client->keepalive)
+	{
+		client->keepalive = keepalive_s;
+		return 0;
+	}
+	return 1;
+}
+
+/**@brief Initialize the file descriptor structure used by poll.
+ */
+int fds_init(struct mqtt_client *c, struct pollfd *fds)
+{
+	if (c->transport.type == MQTT_TRANSPORT_NON_SECURE)
+	{
+		fds->fd = c->transport.tcp.sock;
+	}
+#if defined(CONFIG_MQTT_LIB_TLS)
+	else if (c->transport.type == MQTT_TRANSPORT_SECURE)
+	{
+		fds->fd = c->transport.tls.sock;
+	}
+#endif
+	else
+	{
+		return -ENOTSUP;
+	}
+
+	fds->events = POLLIN;
+
+	return 0;
+}
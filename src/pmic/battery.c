@@ -0,0 +1,21 @@
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include "pmic.h"
+#include "../datatypes/datatypes.h"
+#include "../timesync/timesync.h"
+
+/* Fuel gauge processing, kept apart from the ADP536X calls in pmic.c so recorded
+ * readings can be fed through it off-target (replay/).
+ */
+
+extern device_shadow_t g_device_state;
+
+LOG_MODULE_REGISTER(pmic, LOG_LEVEL_INF);
+
+void battery_soc_process(uint8_t soc)
+{
+    LOG_INF("Batt percentage as uint8 : %d", soc);
+    g_device_state.batt_voltage = soc;
+    g_device_state.bat_stamp = timesync_stamp();
+}
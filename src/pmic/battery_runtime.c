@@ -0,0 +1,204 @@
+#include <stdlib.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/util.h>
+
+#include "battery_runtime.h"
+#include "../datatypes/json_writer.h"
+
+LOG_MODULE_DECLARE(pmic);
+
+/* A rise of more than this is charging, the fit starts over */
+#define CHARGE_STEP_PCT 1
+/* Voltage changes below this are fuel gauge noise */
+#define STABLE_MV 20
+/* The interval doubles per stable reading, at most this many times */
+#define STABLE_MAX 16
+/* Fewer readings than this do not give a slope */
+#define FIT_MIN_READINGS 3
+
+struct battery_reading
+{
+    uint32_t time_s;
+    uint16_t mv;
+    uint8_t soc;
+};
+
+static struct
+{
+    struct battery_reading history[CONFIG_BATTERY_HISTORY_SIZE];
+    uint16_t head;      // next slot, the oldest reading once full
+    uint16_t count;
+    uint16_t fit_count; // the newest fit_count readings are in the fit
+    uint32_t fit_base_s;
+    /* Least-squares sums over the fit, t in s since fit_base_s, y in % */
+    int64_t st;
+    int64_t sy;
+    int64_t stt;
+    int64_t sty;
+    struct battery_duty_cycle duty;
+    uint8_t stable;     // readings in a row without a change
+} model;
+static K_MUTEX_DEFINE(model_lock);
+
+static const struct battery_reading *reading_get(uint16_t age)
+{
+    return &model.history[(model.head + CONFIG_BATTERY_HISTORY_SIZE - 1 - age) % CONFIG_BATTERY_HISTORY_SIZE];
+}
+
+static void fit_reset(void)
+{
+    model.fit_count = 0;
+    model.st = 0;
+    model.sy = 0;
+    model.stt = 0;
+    model.sty = 0;
+}
+
+static void fit_account(const struct battery_reading *r, int sign)
+{
+    int64_t t = r->time_s - model.fit_base_s;
+
+    model.st += sign * t;
+    model.sy += sign * r->soc;
+    model.stt += sign * t * t;
+    model.sty += sign * t * r->soc;
+}
+
+/* Call with model_lock held. Drain in 1/100 % per hour over span_s, false until the
+ * fit is long enough and SoC is falling.
+ */
+static bool drain_estimate(int32_t *drain_cpct_h, uint32_t *span_s)
+{
+    int64_t n = model.fit_count;
+    int64_t den = n * model.stt - model.st * model.st;
+
+    if (n < FIT_MIN_READINGS || den <= 0)
+    {
+        return false;
+    }
+
+    *span_s = reading_get(0)->time_s - reading_get(model.fit_count - 1)->time_s;
+    /* slope in %/s = (n*sty - st*sy) / den */
+    *drain_cpct_h = (int32_t)(-(n * model.sty - model.st * model.sy) * 100 * 3600 / den);
+
+    return *span_s >= CONFIG_BATTERY_FIT_MIN_SPAN_S && *drain_cpct_h > 0;
+}
+
+void battery_runtime_sample(uint8_t soc, uint16_t mv)
+{
+    struct battery_reading r = {
+        .time_s = (uint32_t)(k_uptime_get() / MSEC_PER_SEC),
+        .mv = mv,
+        .soc = soc,
+    };
+
+    k_mutex_lock(&model_lock, K_FOREVER);
+
+    if (model.count > 0)
+    {
+        const struct battery_reading *prev = reading_get(0);
+
+        if (soc > prev->soc + CHARGE_STEP_PCT)
+        {
+            LOG_INF("Battery charging, drain fit restarted");
+            fit_reset();
+        }
+        if (soc == prev->soc && abs(mv - prev->mv) < STABLE_MV)
+        {
+            model.stable = MIN(model.stable + 1, STABLE_MAX);
+        }
+        else
+        {
+            model.stable = 0;
+        }
+    }
+
+    /* The oldest reading makes room, and leaves the fit if it was in it */
+    if (model.count == CONFIG_BATTERY_HISTORY_SIZE)
+    {
+        if (model.fit_count == model.count)
+        {
+            fit_account(reading_get(model.count - 1), -1);
+            model.fit_count--;
+        }
+        model.count--;
+    }
+
+    model.history[model.head] = r;
+    model.head = (model.head + 1) % CONFIG_BATTERY_HISTORY_SIZE;
+    model.count++;
+
+    if (model.fit_count == 0)
+    {
+        model.fit_base_s = r.time_s;
+    }
+    fit_account(&r, 1);
+    model.fit_count++;
+    k_mutex_unlock(&model_lock);
+}
+
+void battery_runtime_duty_cycle_set(const struct battery_duty_cycle *duty)
+{
+    k_mutex_lock(&model_lock, K_FOREVER);
+    if (duty->gnss_interval_s != model.duty.gnss_interval_s ||
+        duty->sensor_interval_ms != model.duty.sensor_interval_ms || duty->psm != model.duty.psm)
+    {
+        LOG_INF("Duty cycle: GNSS %u s, sensors %u ms, PSM %s, drain fit restarted",
+                duty->gnss_interval_s, duty->sensor_interval_ms, duty->psm ? "on" : "off");
+        model.duty = *duty;
+        model.stable = 0; // sample fast until the new drain shows
+        fit_reset();
+    }
+    k_mutex_unlock(&model_lock);
+}
+
+uint32_t battery_runtime_interval_ms(uint32_t base_ms)
+{
+    uint64_t interval_ms = (uint64_t)base_ms << model.stable;
+
+    return MAX(base_ms, MIN(interval_ms, CONFIG_BATTERY_SAMPLE_MAX_INTERVAL_S * MSEC_PER_SEC));
+}
+
+int battery_runtime_report_build(char *buf, size_t size)
+{
+    struct json_writer w;
+    struct battery_reading last = {0};
+    struct battery_duty_cycle duty;
+    uint16_t samples;
+    int32_t drain_cpct_h = 0;
+    uint32_t span_s = 0;
+    bool valid;
+
+    k_mutex_lock(&model_lock, K_FOREVER);
+    if (model.count > 0)
+    {
+        last = *reading_get(0);
+    }
+    valid = drain_estimate(&drain_cpct_h, &span_s);
+    samples = model.fit_count;
+    duty = model.duty;
+    k_mutex_unlock(&model_lock);
+
+    json_writer_init(&w, buf, size);
+    json_add_int(&w, "soc", last.soc);
+    if (last.mv != 0)
+    {
+        json_add_int(&w, "mv", last.mv);
+    }
+    if (valid)
+    {
+        uint32_t runtime_min = (uint32_t)last.soc * 100 * 60 / drain_cpct_h;
+
+        json_add_fixed(&w, "drain_pct_h", drain_cpct_h, 2);
+        json_add_int(&w, "runtime_min", runtime_min);
+        LOG_INF("Battery: %u%%, drain %d.%02d %%/h over %u s, %u min left", last.soc,
+                drain_cpct_h / 100, drain_cpct_h % 100, span_s, runtime_min);
+    }
+    json_add_int(&w, "samples", samples);
+    json_add_int(&w, "span_s", span_s);
+    json_add_int(&w, "gnss_s", duty.gnss_interval_s);
+    json_add_int(&w, "sensor_ms", duty.sensor_interval_ms);
+    json_add_int(&w, "psm", duty.psm);
+    return json_writer_finish(&w);
+}
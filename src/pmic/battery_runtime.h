@@ -0,0 +1,50 @@
+#ifndef _BATTERY_RUNTIME_H_
+#define _BATTERY_RUNTIME_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Drain rate and remaining runtime from the fuel gauge history, to see what an
+ * interval change costs in battery life without waiting for the battery to run out.
+ *
+ * The last CONFIG_BATTERY_HISTORY_SIZE readings are kept. The drain rate is the
+ * least-squares slope of SoC over time, updated per reading over the readings since
+ * the duty cycle last changed or the battery last charged, so it always describes the
+ * settings in use; reports carry those settings next to it.
+ * While SoC and voltage stay put, the sampling interval doubles per reading up to
+ * CONFIG_BATTERY_SAMPLE_MAX_INTERVAL_S, so the history spans hours instead of minutes.
+ */
+
+/* What the drain depends on that the device controls or the network grants */
+struct battery_duty_cycle
+{
+    uint32_t gnss_interval_s;
+    uint32_t sensor_interval_ms;
+    bool psm;
+};
+
+/**@brief Account a fuel gauge reading. Call from the sampling work item.
+ * @param mv Battery voltage, 0 if unknown.
+ */
+void battery_runtime_sample(uint8_t soc, uint16_t mv);
+
+/**@brief Set the duty cycle readings are taken under from now on.
+ */
+void battery_runtime_duty_cycle_set(const struct battery_duty_cycle *duty);
+
+/**@brief The sampling interval to use next.
+ * @param base_ms The configured interval, used while SoC or voltage moves.
+ */
+uint32_t battery_runtime_interval_ms(uint32_t base_ms);
+
+/**@brief Write the estimate as a flat json object, e.g.
+ * {"soc":87,"mv":3912,"drain_pct_h":1.25,"runtime_min":4176,"samples":24,"span_s":36000,
+ *  "gnss_s":120,"sensor_ms":20000,"psm":1}
+ * drain_pct_h and runtime_min are left out until the fit spans CONFIG_BATTERY_FIT_MIN_SPAN_S
+ * with a falling SoC.
+ * @return The json length, or -ENOMEM if it did not fit.
+ */
+int battery_runtime_report_build(char *buf, size_t size);
+
+#endif /* _BATTERY_RUNTIME_H_ */
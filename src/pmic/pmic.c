@@ -11,29 +11,52 @@
 #endif
 
 #include "pmic.h"
-#include "../datatypes/datatypes.h"
+#include "battery_runtime.h"
+#include "../trace/trace.h"
 
 #define ADP536X_I2C_DEVICE DEVICE_DT_GET(DT_NODELABEL(i2c2))
 
-extern device_shadow_t g_device_state;
 extern bool g_started_up; // don't feel like using any sync primitives.
 
-LOG_MODULE_REGISTER(pmic, LOG_LEVEL_INF);
+LOG_MODULE_DECLARE(pmic);
 
 // Battery Sampling: timer will fire a battery charge request work queue item every time it finishes.
+//! Timer
+static void battery_sample_timer_handler(struct k_timer *timer);
+K_TIMER_DEFINE(battery_sample_timer, battery_sample_timer_handler, NULL);
+static uint32_t battery_interval_ms = BATTERY_SAMPLE_INTERVAL_MS;
+static uint32_t battery_period_ms = BATTERY_SAMPLE_INTERVAL_MS; // battery_interval_ms, stretched while SoC is stable
+static bool battery_sampling = false;
+
 //! WorkQ
 static struct k_work battery_soc_sample_work;
 static void battery_soc_sample_work_fn(struct k_work *work)
 {
     uint8_t battery_percentage_timer;
     adp536x_fg_soc(&battery_percentage_timer);
-    LOG_INF("Batt percentage as uint8 : %d", battery_percentage_timer);
-    g_device_state.batt_voltage = battery_percentage_timer;
-}
+#if defined(CONFIG_TRACE_CAPTURE)
+    trace_record_soc(battery_percentage_timer);
+#endif
+    battery_soc_process(battery_percentage_timer);
+#if defined(CONFIG_BATTERY_RUNTIME)
+    uint16_t battery_mv;
+    uint32_t period_ms;
 
-//! Timer
-static void battery_sample_timer_handler(struct k_timer *timer);
-K_TIMER_DEFINE(battery_sample_timer, battery_sample_timer_handler, NULL);
+    if (adp536x_fg_volts(&battery_mv) != 0)
+    {
+        battery_mv = 0;
+    }
+    battery_runtime_sample(battery_percentage_timer, battery_mv);
+
+    period_ms = battery_runtime_interval_ms(battery_interval_ms);
+    if (period_ms != battery_period_ms)
+    {
+        LOG_DBG("Battery sampling every %u ms", period_ms);
+        battery_period_ms = period_ms;
+        k_timer_start(&battery_sample_timer, K_MSEC(period_ms), K_MSEC(period_ms));
+    }
+#endif
+}
 
 void battery_sample_timer_handler(struct k_timer *timer)
 {
@@ -130,17 +153,32 @@ int pmic_thread(void)
     {
         k_yield();
     }
-    k_timer_start(&battery_sample_timer, K_MSEC(1000), K_MSEC(BATTERY_SAMPLE_INTERVAL_MS));
+    k_timer_start(&battery_sample_timer, K_MSEC(1000), K_MSEC(battery_interval_ms));
+    battery_sampling = true;
     return 0;
 }
 
+void battery_interval_set(uint32_t interval_ms)
+{
+    if (interval_ms == battery_interval_ms)
+    {
+        return;
+    }
+    battery_interval_ms = interval_ms;
+    battery_period_ms = interval_ms;
+    if (battery_sampling) // otherwise pmic_thread starts the timer with it
+    {
+        k_timer_start(&battery_sample_timer, K_MSEC(interval_ms), K_MSEC(interval_ms));
+    }
+}
+
 // You can uncomment this if you want. I think it's odd to do this way, but atv2 does it with sys init.
 #if (DEBUG_USE_SYSINIT)
 SYS_INIT(thingy91_board_init, POST_KERNEL, CONFIG_BOARD_INIT_PRIORITY);
 #else
-K_THREAD_DEFINE(startup_thread_id, STACKSIZE, startup_thread, NULL, NULL, NULL,
+K_THREAD_DEFINE(startup_thread_id, STARTUP_THREAD_STACKSIZE, startup_thread, NULL, NULL, NULL,
                 STARTUP_THREAD_PRIORITY, 0, 0);
 #endif
 
-K_THREAD_DEFINE(pmic_thread_id, STACKSIZE, pmic_thread, NULL, NULL, NULL,
+K_THREAD_DEFINE(pmic_thread_id, PMIC_THREAD_STACKSIZE, pmic_thread, NULL, NULL, NULL,
                 PMIC_THREAD_PRIORITY, 0, 0);
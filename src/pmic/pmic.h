@@ -1,10 +1,21 @@
 #ifndef _PMIC_H_
-#define _PMIC_H
+#define _PMIC_H_
+
+#include <stdint.h>
 
 #define DEBUG_USE_SYSINIT false // Set to true if you want to use sys_init the way the atv2/thingy board inits do.
-#define STACKSIZE 1024
+#define STARTUP_THREAD_STACKSIZE 1024
+#define PMIC_THREAD_STACKSIZE 1024
 #define STARTUP_THREAD_PRIORITY -1
 #define PMIC_THREAD_PRIORITY 7
 #define BATTERY_SAMPLE_INTERVAL_MS 10000
 
+/**@brief Log a fuel gauge reading and store it in the device state.
+ */
+void battery_soc_process(uint8_t soc);
+
+/**@brief Change the fuel gauge sampling interval.
+ */
+void battery_interval_set(uint32_t interval_ms);
+
 #endif /* _PMIC_H_ */
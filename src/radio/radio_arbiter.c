@@ -0,0 +1,378 @@
+#include <stdlib.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/util.h>
+
+#include <nrf_modem_gnss.h>
+
+#include "radio_arbiter.h"
+
+LOG_MODULE_REGISTER(radio_arbiter, LOG_LEVEL_INF);
+
+#define WINDOW_MS (CONFIG_RADIO_ARBITER_WINDOW_S * MSEC_PER_SEC)
+#define UPLINK_DELAY_MS (CONFIG_RADIO_ARBITER_UPLINK_DELAY_S * MSEC_PER_SEC)
+#define GAP_MS (CONFIG_RADIO_ARBITER_GAP_S * MSEC_PER_SEC)
+#define STARVE_MS (CONFIG_RADIO_ARBITER_STARVE_S * MSEC_PER_SEC)
+#define MAX_STARVE_MS (CONFIG_RADIO_ARBITER_MAX_STARVE_S * MSEC_PER_SEC)
+
+/* Held uplinks check back this often, a window can end early with a fix */
+#define HOLD_RECHECK_MS 1000
+
+#define BLOCKED_FLAGS (NRF_MODEM_GNSS_PVT_FLAG_DEADLINE_MISSED | NRF_MODEM_GNSS_PVT_FLAG_NOT_ENOUGH_WINDOW_TIME)
+
+BUILD_ASSERT(CONFIG_RADIO_ARBITER_UPLINK_DELAY_S <= CONFIG_RADIO_ARBITER_WINDOW_S,
+             "Uplinks are never held longer than a window anyway");
+
+enum window_end
+{
+    WINDOW_END_FIX,
+    WINDOW_END_SLEEP,
+    WINDOW_END_TIMEOUT,
+    WINDOW_END_UPLINK,
+    WINDOW_END_SLEEP_MODE,
+};
+
+static const char *const window_end_names[] = {
+    [WINDOW_END_FIX] = "fix",
+    [WINDOW_END_SLEEP] = "search ended",
+    [WINDOW_END_TIMEOUT] = "window timeout",
+    [WINDOW_END_UPLINK] = "uplink waiting",
+    [WINDOW_END_SLEEP_MODE] = "PSM/eDRX granted",
+};
+
+/* Uptimes in ms compared modulo 2^32, 0 means unset */
+static struct
+{
+    bool sleep_mode;    // PSM or eDRX granted, GNSS gets idle time on its own
+    bool searching;
+    bool fixed;         // the search ended with a fix
+    uint32_t blocked_since;
+    bool window_open;
+    uint32_t window_opened;
+    uint32_t window_closed;
+    bool uplink_pending;
+    uint32_t uplink_since; // held since, only during a window
+    uint32_t keepalive_due;
+} state;
+static struct k_spinlock state_lock;
+static struct radio_arbiter_stats stats;
+
+static void arbiter_work_fn(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(arbiter_work, arbiter_work_fn);
+
+static uint32_t now_ms(void)
+{
+    return MAX(k_uptime_get_32(), 1);
+}
+
+static int32_t since(uint32_t now, uint32_t then)
+{
+    return then == 0 ? 0 : (int32_t)(now - then);
+}
+
+enum action
+{
+    ACTION_NONE,
+    ACTION_OPEN,
+    ACTION_CLOSE,
+};
+
+/* Call with state_lock held. Decides what to do now, and returns the time in ms until
+ * the decision can change without an event, or -1 if only an event can change it.
+ */
+static int32_t arbiter_decide(uint32_t now, enum action *action, bool *forced, enum window_end *end)
+{
+    *action = ACTION_NONE;
+
+    if (state.window_open)
+    {
+        int32_t left = WINDOW_MS - since(now, state.window_opened);
+        int32_t uplink_left = state.uplink_since != 0 ? UPLINK_DELAY_MS - since(now, state.uplink_since) : left;
+
+        *action = ACTION_CLOSE;
+        if (!state.searching)
+        {
+            *end = state.fixed ? WINDOW_END_FIX : WINDOW_END_SLEEP;
+        }
+        else if (state.sleep_mode)
+        {
+            *end = WINDOW_END_SLEEP_MODE;
+        }
+        else if (left <= 0)
+        {
+            *end = WINDOW_END_TIMEOUT;
+        }
+        else if (uplink_left <= 0)
+        {
+            *end = WINDOW_END_UPLINK;
+        }
+        else
+        {
+            *action = ACTION_NONE;
+            return MIN(left, uplink_left);
+        }
+        return -1;
+    }
+
+    if (!state.searching || state.blocked_since == 0)
+    {
+        return -1;
+    }
+
+    int32_t starved = since(now, state.blocked_since);
+    int32_t threshold = state.sleep_mode ? STARVE_MS : 0;
+    int32_t gap_left = state.window_closed != 0 ? GAP_MS - since(now, state.window_closed) : 0;
+
+    if (gap_left > 0)
+    {
+        return gap_left;
+    }
+    if (starved >= MAX_STARVE_MS)
+    {
+        *action = ACTION_OPEN;
+        *forced = state.uplink_pending;
+        return -1;
+    }
+    if (starved < threshold)
+    {
+        return threshold - starved;
+    }
+
+    /* Let queued uplinks out first, and keep the keepalive out of the window */
+    if (!state.uplink_pending &&
+        (state.keepalive_due == 0 || (int32_t)(state.keepalive_due - now) > WINDOW_MS))
+    {
+        *action = ACTION_OPEN;
+        *forced = false;
+        return -1;
+    }
+
+    /* The queue draining and the ping going out kick the work item. Look again when the
+     * ping is due too, rather than only once starved.
+     */
+    if (state.keepalive_due != 0 && (int32_t)(state.keepalive_due - now) > 0)
+    {
+        return MIN(MAX_STARVE_MS - starved, (int32_t)(state.keepalive_due - now));
+    }
+    return MAX_STARVE_MS - starved;
+}
+
+/* The modem calls run on the work item without the lock, nothing else opens or closes windows */
+static void window_open(uint32_t now, bool forced)
+{
+    int err = nrf_modem_gnss_prio_mode_enable();
+    k_spinlock_key_t key = k_spin_lock(&state_lock);
+    uint32_t starved_ms = since(now, state.blocked_since);
+
+    if (err)
+    {
+        /* Try again after a gap rather than in a loop */
+        state.window_closed = now;
+    }
+    else
+    {
+        state.window_open = true;
+        state.window_opened = now;
+        stats.windows++;
+        stats.windows_forced += forced;
+        stats.starved_max_ms = MAX(stats.starved_max_ms, starved_ms);
+    }
+    k_spin_unlock(&state_lock, key);
+
+    if (err)
+    {
+        LOG_ERR("Failed to give GNSS priority: %d", err);
+        return;
+    }
+    LOG_INF("GNSS window opened, blocked for %u ms%s", starved_ms, forced ? ", uplinks held" : "");
+}
+
+static void window_close(uint32_t now, enum window_end end)
+{
+    int err = nrf_modem_gnss_prio_mode_disable();
+    k_spinlock_key_t key = k_spin_lock(&state_lock);
+    uint32_t open_ms = since(now, state.window_opened);
+
+    state.window_open = false;
+    state.window_closed = now;
+    /* Starvation counts again from the next blocked frame */
+    state.blocked_since = 0;
+    stats.windows_fixed += (end == WINDOW_END_FIX);
+    k_spin_unlock(&state_lock, key);
+
+    if (err)
+    {
+        /* The modem may have dropped priority by itself, it is released either way */
+        LOG_DBG("Failed to drop GNSS priority: %d", err);
+    }
+    LOG_INF("GNSS window closed after %u ms (%s)", open_ms, window_end_names[end]);
+    LOG_INF("Arbiter: %u windows, %u forced, %u with fix, %u uplinks delayed, max %u ms",
+            stats.windows, stats.windows_forced, stats.windows_fixed,
+            stats.uplinks_delayed, stats.uplink_delay_max_ms);
+}
+
+static void arbiter_work_fn(struct k_work *work)
+{
+    uint32_t now = now_ms();
+    enum action action;
+    enum window_end end = WINDOW_END_TIMEOUT;
+    bool forced = false;
+    int32_t next_ms;
+    k_spinlock_key_t key = k_spin_lock(&state_lock);
+
+    next_ms = arbiter_decide(now, &action, &forced, &end);
+    k_spin_unlock(&state_lock, key);
+
+    switch (action)
+    {
+    case ACTION_OPEN:
+        window_open(now, forced);
+        break;
+    case ACTION_CLOSE:
+        window_close(now, end);
+        break;
+    default:
+        break;
+    }
+
+    /* After acting, decide again for the next deadline (window end, gap end) */
+    if (action != ACTION_NONE)
+    {
+        k_work_reschedule(&arbiter_work, K_NO_WAIT);
+    }
+    else if (next_ms >= 0)
+    {
+        k_work_reschedule(&arbiter_work, K_MSEC(MAX(next_ms, 1)));
+    }
+}
+
+static void arbiter_kick(void)
+{
+    k_work_reschedule(&arbiter_work, K_NO_WAIT);
+}
+
+void radio_arbiter_gnss_pvt(const struct nrf_modem_gnss_pvt_data_frame *pvt)
+{
+    uint32_t now = now_ms();
+    k_spinlock_key_t key = k_spin_lock(&state_lock);
+    bool kick = false;
+
+    if (pvt->flags & NRF_MODEM_GNSS_PVT_FLAG_FIX_VALID)
+    {
+        /* Periodic GNSS goes to sleep after this, let LTE have the radio back now */
+        kick = state.window_open;
+        state.fixed = true;
+        state.searching = false;
+        state.blocked_since = 0;
+    }
+    else
+    {
+        state.searching = true;
+        state.fixed = false;
+        if ((pvt->flags & BLOCKED_FLAGS) && state.blocked_since == 0)
+        {
+            state.blocked_since = now;
+            kick = true;
+        }
+    }
+    k_spin_unlock(&state_lock, key);
+
+    if (kick)
+    {
+        arbiter_kick();
+    }
+}
+
+void radio_arbiter_gnss_search(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&state_lock);
+
+    state.searching = true;
+    state.fixed = false;
+    state.blocked_since = 0;
+    k_spin_unlock(&state_lock, key);
+}
+
+void radio_arbiter_gnss_sleep(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&state_lock);
+
+    state.searching = false;
+    state.blocked_since = 0;
+    k_spin_unlock(&state_lock, key);
+    arbiter_kick();
+}
+
+void radio_arbiter_lte_update(bool psm, bool edrx)
+{
+    k_spinlock_key_t key = k_spin_lock(&state_lock);
+    bool sleep_mode = psm || edrx;
+    bool changed = sleep_mode != state.sleep_mode;
+
+    state.sleep_mode = sleep_mode;
+    k_spin_unlock(&state_lock, key);
+
+    if (changed)
+    {
+        LOG_INF("LTE idle mode %s, GNSS windows %s", sleep_mode ? "granted" : "lost",
+                sleep_mode ? "only when starved" : "on demand");
+        arbiter_kick();
+    }
+}
+
+int radio_arbiter_uplink_hold_ms(bool uplink_pending, int keepalive_ms)
+{
+    uint32_t now = now_ms();
+    k_spinlock_key_t key = k_spin_lock(&state_lock);
+    int hold_ms = 0;
+    bool kick = false;
+    uint32_t keepalive_due = keepalive_ms < 0 ? 0 : MAX(now + (uint32_t)keepalive_ms, 1);
+    bool waiting = !state.window_open && state.searching && state.blocked_since != 0;
+
+    /* A blocked search may have waited for the queue or the keepalive, decide again once
+     * either is out of the way. The keepalive only moves by a few ms between calls until
+     * the ping went out.
+     */
+    if (waiting && ((state.uplink_pending && !uplink_pending) ||
+                    (keepalive_due == 0) != (state.keepalive_due == 0) ||
+                    abs((int32_t)(keepalive_due - state.keepalive_due)) > HOLD_RECHECK_MS))
+    {
+        kick = true;
+    }
+
+    /* Negative when no keepalive is scheduled, 0 leaves nothing to keep out of a window */
+    state.keepalive_due = keepalive_due;
+    state.uplink_pending = uplink_pending;
+    if (uplink_pending && state.window_open)
+    {
+        if (state.uplink_since == 0)
+        {
+            state.uplink_since = now;
+            stats.uplinks_delayed++;
+            kick = true; // the window now has an uplink deadline
+        }
+        hold_ms = MIN(WINDOW_MS - since(now, state.window_opened),
+                      UPLINK_DELAY_MS - since(now, state.uplink_since));
+        hold_ms = CLAMP(hold_ms, 1, HOLD_RECHECK_MS);
+    }
+    else if (state.uplink_since != 0)
+    {
+        uint32_t delay_ms = since(now, state.uplink_since);
+
+        stats.uplink_delay_max_ms = MAX(stats.uplink_delay_max_ms, delay_ms);
+        stats.uplink_delay_total_ms += delay_ms;
+        state.uplink_since = 0;
+    }
+    k_spin_unlock(&state_lock, key);
+
+    if (kick)
+    {
+        arbiter_kick();
+    }
+    return hold_ms;
+}
+
+const struct radio_arbiter_stats *radio_arbiter_stats_get(void)
+{
+    return &stats;
+}
@@ -0,0 +1,61 @@
+#ifndef _RADIO_ARBITER_H_
+#define _RADIO_ARBITER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <nrf_modem_gnss.h>
+
+/* LTE and GNSS share one radio. GNSS only gets time while LTE is idle, so without
+ * PSM or eDRX a search can starve. The arbiter decides when GNSS gets priority
+ * (nrf_modem_gnss_prio_mode_enable()), in windows of at most CONFIG_RADIO_ARBITER_WINDOW_S:
+ *   - a window opens once GNSS has been blocked for CONFIG_RADIO_ARBITER_STARVE_S,
+ *     right away while the network grants neither PSM nor eDRX;
+ *   - it waits for queued uplinks and an imminent keepalive, unless GNSS has been
+ *     blocked for CONFIG_RADIO_ARBITER_MAX_STARVE_S;
+ *   - uplinks queued during a window wait at most CONFIG_RADIO_ARBITER_UPLINK_DELAY_S,
+ *     then the window closes;
+ *   - LTE gets at least CONFIG_RADIO_ARBITER_GAP_S between windows.
+ */
+
+struct radio_arbiter_stats
+{
+    uint32_t windows;
+    uint32_t windows_forced;     // opened with uplinks waiting, GNSS starved too long
+    uint32_t windows_fixed;      // ended by a fix
+    uint32_t starved_max_ms;     // longest GNSS was blocked before a window opened
+    uint32_t uplinks_delayed;    // times queued uplinks were held for a window
+    uint32_t uplink_delay_max_ms;
+    uint32_t uplink_delay_total_ms;
+};
+
+/**@brief Account a PVT frame. Safe from the GNSS event handler.
+ */
+void radio_arbiter_gnss_pvt(const struct nrf_modem_gnss_pvt_data_frame *pvt);
+
+/**@brief GNSS woke up for a search. Safe from the GNSS event handler.
+ */
+void radio_arbiter_gnss_search(void);
+
+/**@brief GNSS went to sleep, after a fix or a timeout. Safe from the GNSS event handler.
+ */
+void radio_arbiter_gnss_sleep(void);
+
+/**@brief The idle modes the network granted changed.
+ */
+void radio_arbiter_lte_update(bool psm, bool edrx);
+
+/**@brief Ask whether the MQTT thread may send now. Call before poll() and before
+ * handling the queue.
+ * @param uplink_pending Publishes or calls are queued.
+ * @param keepalive_ms Time until the next keepalive is due, negative when there is none.
+ * @return How long queued uplinks must still wait for a GNSS window in ms, 0 to send now.
+ * At most a second, ask again then.
+ */
+int radio_arbiter_uplink_hold_ms(bool uplink_pending, int keepalive_ms);
+
+/**@brief Get the window and delay counters.
+ */
+const struct radio_arbiter_stats *radio_arbiter_stats_get(void);
+
+#endif /* _RADIO_ARBITER_H_ */
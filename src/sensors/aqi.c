@@ -0,0 +1,32 @@
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/sensor.h>
+#include <zephyr/logging/log.h>
+
+#include "bme680.h"
+#include "../datatypes/datatypes.h"
+#include "../timesync/timesync.h"
+
+/* Sample processing, kept apart from the driver calls in bme680.c so recorded
+ * samples can be fed through it off-target (replay/).
+ */
+
+extern device_shadow_t g_device_state;
+LOG_MODULE_REGISTER(bme680_module, LOG_LEVEL_INF);
+
+void aqi_sample_process(const struct sensor_value values[AQI_CHAN_COUNT])
+{
+    const struct sensor_value *temp = &values[AQI_CHAN_TEMP];
+    const struct sensor_value *press = &values[AQI_CHAN_PRESS];
+    const struct sensor_value *humidity = &values[AQI_CHAN_HUMIDITY];
+    const struct sensor_value *gas_res = &values[AQI_CHAN_GAS_RES];
+
+    LOG_INF("T: %d.%02d C; P: %d.%02d kPa; H: %d.%02d %% humid; G: %d.%02d ohms",
+            temp->val1, temp->val2, press->val1, press->val2,
+            humidity->val1, humidity->val2, gas_res->val1,
+            gas_res->val2);
+    g_device_state.temperature = temp->val1;
+    g_device_state.pressure = press->val1;
+    g_device_state.relative_humidity = humidity->val1;
+    g_device_state.gas_res = gas_res->val1;
+    g_device_state.env_stamp = timesync_stamp();
+}
@@ -5,17 +5,18 @@
 #include <zephyr/drivers/sensor.h>
 #include <drivers/bme68x_iaq.h>
 #include "bme680.h"
-#include "../datatypes/datatypes.h"
+#include "../trace/trace.h"
 
 #include <zephyr/logging/log.h>
 
-extern device_shadow_t g_device_state;
-LOG_MODULE_REGISTER(bme680_module, LOG_LEVEL_INF);
+LOG_MODULE_DECLARE(bme680_module);
+
+static atomic_t sample_interval_ms = ATOMIC_INIT(SENSOR_SAMPLE_INTERVAL_MS);
 
 int aqi_thread(void)
 {
     const struct device *const dev = DEVICE_DT_GET_ONE(bosch_bme680); // under the i2c2 node in the thingy91 common .dts
-    struct sensor_value temp, press, humidity, gas_res;
+    struct sensor_value values[AQI_CHAN_COUNT];
 
     if (!device_is_ready(dev))
     {
@@ -26,25 +27,30 @@ int aqi_thread(void)
     while (1)
     {
         sensor_sample_fetch(dev);
-        sensor_channel_get(dev, SENSOR_CHAN_AMBIENT_TEMP, &temp); // deg c
-        sensor_channel_get(dev, SENSOR_CHAN_PRESS, &press);       // kPa
-        sensor_channel_get(dev, SENSOR_CHAN_HUMIDITY, &humidity); // % rel humidity
-        sensor_channel_get(dev, SENSOR_CHAN_GAS_RES, &gas_res);   // gas sensor resistance in ohms (lower = more pollutants)
-
-        LOG_INF("T: %d.%02d C; P: %d.%02d kPa; H: %d.%02d %% humid; G: %d.%02d ohms",
-                temp.val1, temp.val2, press.val1, press.val2,
-                humidity.val1, humidity.val2, gas_res.val1,
-                gas_res.val2);
-        g_device_state.temperature = temp.val1;
-        g_device_state.pressure = press.val1;
-        g_device_state.relative_humidity = humidity.val1;
-        g_device_state.gas_res = gas_res.val1;
-
-        k_sleep(K_MSEC(SENSOR_SAMPLE_INTERVAL_MS));
+        sensor_channel_get(dev, SENSOR_CHAN_AMBIENT_TEMP, &values[AQI_CHAN_TEMP]);
+        sensor_channel_get(dev, SENSOR_CHAN_PRESS, &values[AQI_CHAN_PRESS]);
+        sensor_channel_get(dev, SENSOR_CHAN_HUMIDITY, &values[AQI_CHAN_HUMIDITY]);
+        sensor_channel_get(dev, SENSOR_CHAN_GAS_RES, &values[AQI_CHAN_GAS_RES]);
+
+#if defined(CONFIG_TRACE_CAPTURE)
+        trace_record_aqi(values);
+#endif
+        aqi_sample_process(values);
+
+        k_sleep(K_MSEC(atomic_get(&sample_interval_ms)));
     }
 
     return 0;
 }
 
-K_THREAD_DEFINE(aqi_thread_id, STACKSIZE, aqi_thread, NULL, NULL, NULL,
+K_THREAD_DEFINE(aqi_thread_id, AQI_THREAD_STACKSIZE, aqi_thread, NULL, NULL, NULL,
                 AQI_THREAD_PRIORITY, 0, 0);
+
+void aqi_interval_set(uint32_t interval_ms)
+{
+    /* Cut the current sleep short so the new interval starts now */
+    if (atomic_set(&sample_interval_ms, interval_ms) != interval_ms)
+    {
+        k_wakeup(aqi_thread_id);
+    }
+}
@@ -1,8 +1,28 @@
 #ifndef _BME680_H_
-#define _BME680_H
+#define _BME680_H_
 
-#define STACKSIZE 1024
+#include <zephyr/drivers/sensor.h>
+
+#define AQI_THREAD_STACKSIZE 1024
 #define AQI_THREAD_PRIORITY 8
 #define SENSOR_SAMPLE_INTERVAL_MS 20000
 
+/* Channels read from the BME680 on every sample, in this order */
+enum aqi_chan
+{
+    AQI_CHAN_TEMP,     // deg c
+    AQI_CHAN_PRESS,    // kPa
+    AQI_CHAN_HUMIDITY, // % rel humidity
+    AQI_CHAN_GAS_RES,  // gas sensor resistance in ohms (lower = more pollutants)
+    AQI_CHAN_COUNT
+};
+
+/**@brief Log one sample and store it in the device state.
+ */
+void aqi_sample_process(const struct sensor_value values[AQI_CHAN_COUNT]);
+
+/**@brief Change the sampling interval. A changed interval starts with a sample right away.
+ */
+void aqi_interval_set(uint32_t interval_ms);
+
 #endif /* _BME680_H_ */
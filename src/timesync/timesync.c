@@ -0,0 +1,137 @@
+#include <errno.h>
+#include <time.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/timeutil.h>
+
+#include "timesync.h"
+
+LOG_MODULE_REGISTER(timesync, LOG_LEVEL_INF);
+
+/* Fixes closer together than this only check the clock; the ms resolution of both
+ * clocks would swamp a drift measured over a shorter span.
+ */
+#define DRIFT_MIN_SPAN_MS (10 * 60 * MSEC_PER_SEC)
+/* A larger apparent drift is a clock step (e.g. a leap second), not drift */
+#define DRIFT_MAX_PPB 500000
+/* Weight of a new drift measurement, 1/DRIFT_FILTER */
+#define DRIFT_FILTER 4
+/* Network time only overrides GNSS time that is older than this */
+#define GNSS_HOLDOVER_MS (24 * 60 * 60 * MSEC_PER_SEC)
+
+static const char *const source_names[] = {
+    [TIMESYNC_SOURCE_NONE] = "none",
+    [TIMESYNC_SOURCE_NETWORK] = "network",
+    [TIMESYNC_SOURCE_GNSS] = "GNSS",
+};
+
+/* UTC = anchor_utc_ms + elapsed uptime corrected by drift_ppb */
+static struct k_spinlock timesync_lock;
+static enum timesync_source source;
+static int64_t anchor_uptime_ms;
+static int64_t anchor_utc_ms;
+static int32_t drift_ppb;
+static bool drift_valid;
+
+/* Call with timesync_lock held */
+static int64_t utc_at(int64_t uptime_ms)
+{
+    int64_t elapsed = uptime_ms - anchor_uptime_ms;
+
+    return anchor_utc_ms + elapsed + elapsed * drift_ppb / NSEC_PER_SEC;
+}
+
+/* Call with timesync_lock held */
+static void anchor_set(enum timesync_source src, int64_t uptime_ms, int64_t utc_ms)
+{
+    if (source != src)
+    {
+        LOG_INF("Clock set from %s", source_names[src]);
+    }
+    source = src;
+    anchor_uptime_ms = uptime_ms;
+    anchor_utc_ms = utc_ms;
+}
+
+int64_t timesync_gnss_utc_ms(const struct nrf_modem_gnss_datetime *datetime)
+{
+    struct tm tm = {
+        .tm_year = datetime->year - 1900,
+        .tm_mon = datetime->month - 1,
+        .tm_mday = datetime->day,
+        .tm_hour = datetime->hour,
+        .tm_min = datetime->minute,
+        .tm_sec = datetime->seconds,
+    };
+
+    return timeutil_timegm64(&tm) * MSEC_PER_SEC + datetime->ms;
+}
+
+void timesync_pvt_update(const struct nrf_modem_gnss_datetime *datetime)
+{
+    int64_t utc_ms = timesync_gnss_utc_ms(datetime);
+    int64_t now = k_uptime_get();
+    k_spinlock_key_t key = k_spin_lock(&timesync_lock);
+
+    if (source != TIMESYNC_SOURCE_GNSS)
+    {
+        anchor_set(TIMESYNC_SOURCE_GNSS, now, utc_ms);
+    }
+    else if (now - anchor_uptime_ms >= DRIFT_MIN_SPAN_MS)
+    {
+        int64_t span = now - anchor_uptime_ms;
+        int32_t error_ms = (int32_t)(utc_ms - utc_at(now));
+        int64_t measured = (utc_ms - anchor_utc_ms - span) * NSEC_PER_SEC / span;
+
+        if (measured > DRIFT_MAX_PPB || measured < -DRIFT_MAX_PPB)
+        {
+            LOG_WRN("Clock stepped by %d ms", error_ms);
+        }
+        else
+        {
+            drift_ppb = drift_valid ? drift_ppb + ((int32_t)measured - drift_ppb) / DRIFT_FILTER : (int32_t)measured;
+            drift_valid = true;
+            LOG_INF("Clock error %d ms over %u s, drift %d ppb",
+                    error_ms, (uint32_t)(span / MSEC_PER_SEC), drift_ppb);
+        }
+        anchor_set(TIMESYNC_SOURCE_GNSS, now, utc_ms);
+    }
+    k_spin_unlock(&timesync_lock, key);
+}
+
+void timesync_network_update(int64_t utc_ms)
+{
+    int64_t now = k_uptime_get();
+    k_spinlock_key_t key = k_spin_lock(&timesync_lock);
+
+    if (source != TIMESYNC_SOURCE_GNSS || now - anchor_uptime_ms >= GNSS_HOLDOVER_MS)
+    {
+        anchor_set(TIMESYNC_SOURCE_NETWORK, now, utc_ms);
+    }
+    k_spin_unlock(&timesync_lock, key);
+}
+
+int timesync_to_utc_ms(int64_t stamp, int64_t *utc_ms)
+{
+    k_spinlock_key_t key = k_spin_lock(&timesync_lock);
+    int err = -EAGAIN;
+
+    if (source != TIMESYNC_SOURCE_NONE)
+    {
+        *utc_ms = utc_at(stamp);
+        err = 0;
+    }
+    k_spin_unlock(&timesync_lock, key);
+    return err;
+}
+
+enum timesync_source timesync_source_get(void)
+{
+    return source;
+}
+
+int32_t timesync_drift_ppb(void)
+{
+    return drift_ppb;
+}
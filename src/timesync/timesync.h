@@ -0,0 +1,69 @@
+#ifndef _TIMESYNC_H_
+#define _TIMESYNC_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <zephyr/kernel.h>
+#include <nrf_modem_gnss.h>
+
+/* Maps uptime to UTC. GNSS fixes set the clock and measure the drift of the
+ * uptime clock between them; with CONFIG_TIMESYNC_NETWORK the modem's network time
+ * sets it until the first fix.
+ *
+ * Samples are stamped with the 64-bit uptime in ms (timesync_stamp()), the offset from
+ * the boot epoch, and only converted to UTC when they are reported. A sample taken
+ * before the clock was set still gets its UTC time once it is, however old it is.
+ */
+
+enum timesync_source
+{
+    TIMESYNC_SOURCE_NONE,
+    TIMESYNC_SOURCE_NETWORK,
+    TIMESYNC_SOURCE_GNSS,
+};
+
+/**@brief Stamp a sample, cheap enough for any context. Never 0, which marks a field that
+ * was never sampled; the uptime is 0 right at boot.
+ */
+static inline int64_t timesync_stamp(void)
+{
+    int64_t stamp = k_uptime_get();
+
+    return stamp != 0 ? stamp : 1;
+}
+
+/**@brief Convert the date and time of a fix to UTC in ms since 1970.
+ */
+int64_t timesync_gnss_utc_ms(const struct nrf_modem_gnss_datetime *datetime);
+
+/**@brief Set the clock from the date and time of a valid fix.
+ */
+void timesync_pvt_update(const struct nrf_modem_gnss_datetime *datetime);
+
+/**@brief Set the clock from network time, ignored once GNSS has set it recently.
+ * @param utc_ms UTC in ms since 1970 at the moment of the call.
+ */
+void timesync_network_update(int64_t utc_ms);
+
+/**@brief Read network time from the modem and pass it to timesync_network_update().
+ * Only with CONFIG_TIMESYNC_NETWORK.
+ * @return 0, or a negative error if the modem has no network time yet.
+ */
+int timesync_network_query(void);
+
+/**@brief Convert a stamp to UTC in ms since 1970.
+ * @return 0, or -EAGAIN if the clock has not been set yet.
+ */
+int timesync_to_utc_ms(int64_t stamp, int64_t *utc_ms);
+
+/**@brief What set the clock last, TIMESYNC_SOURCE_NONE before it is set.
+ */
+enum timesync_source timesync_source_get(void);
+
+/**@brief Estimated drift of the uptime clock against GNSS time, in parts per billion.
+ * Positive when uptime runs slow.
+ */
+int32_t timesync_drift_ppb(void);
+
+#endif /* _TIMESYNC_H_ */
@@ -0,0 +1,49 @@
+#include <errno.h>
+#include <time.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/timeutil.h>
+#include <nrf_modem_at.h>
+
+#include "timesync.h"
+
+LOG_MODULE_DECLARE(timesync);
+
+/* Quarter hours per the 3GPP time zone field */
+#define TZ_UNIT_S (15 * 60)
+
+int timesync_network_query(void)
+{
+    int year, month, day, hour, minute, second, tz;
+    struct tm tm;
+    int64_t utc_s;
+    int ret;
+
+    /* Local time and zone, e.g. +CCLK: "24/05/17,13:41:05+08" */
+    ret = nrf_modem_at_scanf("AT+CCLK?", "+CCLK: \"%d/%d/%d,%d:%d:%d%d\"",
+                             &year, &month, &day, &hour, &minute, &second, &tz);
+    if (ret != 7)
+    {
+        return ret < 0 ? ret : -EBADMSG;
+    }
+
+    /* The modem counts from its 1980 default until the network sends the time */
+    if (year < 20 || year >= 80)
+    {
+        return -EAGAIN;
+    }
+
+    tm = (struct tm){
+        .tm_year = year + 100,
+        .tm_mon = month - 1,
+        .tm_mday = day,
+        .tm_hour = hour,
+        .tm_min = minute,
+        .tm_sec = second,
+    };
+    utc_s = timeutil_timegm64(&tm) - tz * TZ_UNIT_S;
+
+    timesync_network_update(utc_s * MSEC_PER_SEC);
+    return 0;
+}
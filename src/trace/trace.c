@@ -0,0 +1,216 @@
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "trace.h"
+
+LOG_MODULE_REGISTER(trace, LOG_LEVEL_INF);
+
+#define AQI_PAYLOAD_LEN (AQI_CHAN_COUNT * 2 * sizeof(int32_t))
+#define VARINT_MAX_LEN 5
+
+static size_t payload_len(enum trace_type type)
+{
+    switch (type)
+    {
+    case TRACE_PVT:
+        return sizeof(struct nrf_modem_gnss_pvt_data_frame);
+    case TRACE_AQI:
+        return AQI_PAYLOAD_LEN;
+    case TRACE_SOC:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+int trace_reader_init(struct trace_reader *r, const uint8_t *buf, size_t len)
+{
+    if (len < TRACE_HDR_LEN || memcmp(buf, TRACE_MAGIC, 4) != 0 || buf[4] != TRACE_VERSION)
+    {
+        return -EINVAL;
+    }
+    if (sys_get_le16(&buf[5]) != sizeof(struct nrf_modem_gnss_pvt_data_frame))
+    {
+        return -ENOTSUP;
+    }
+
+    r->buf = buf;
+    r->len = len;
+    r->pos = TRACE_HDR_LEN;
+    r->time_ms = 0;
+    r->started = false;
+    return 0;
+}
+
+int trace_read(struct trace_reader *r, struct trace_record *rec)
+{
+    uint32_t delta_ms = 0;
+    size_t len;
+
+    if (r->pos == r->len)
+    {
+        return -ENODATA;
+    }
+
+    rec->type = r->buf[r->pos++];
+    len = payload_len(rec->type);
+    if (len == 0)
+    {
+        return -EBADMSG;
+    }
+
+    for (int shift = 0; shift < 7 * VARINT_MAX_LEN; shift += 7)
+    {
+        if (r->pos == r->len)
+        {
+            return -EBADMSG;
+        }
+        uint8_t b = r->buf[r->pos++];
+        delta_ms |= (uint32_t)(b & 0x7f) << shift;
+        if (!(b & 0x80))
+        {
+            break;
+        }
+    }
+
+    if (r->len - r->pos < len)
+    {
+        return -EBADMSG;
+    }
+
+    /* The first record defines time 0 */
+    r->time_ms = r->started ? r->time_ms + delta_ms : 0;
+    r->started = true;
+    rec->time_ms = r->time_ms;
+    rec->data = &r->buf[r->pos];
+    rec->len = len;
+    r->pos += len;
+    return 0;
+}
+
+void trace_aqi_get(const struct trace_record *rec, struct sensor_value values[AQI_CHAN_COUNT])
+{
+    for (int i = 0; i < AQI_CHAN_COUNT; i++)
+    {
+        values[i].val1 = (int32_t)sys_get_le32(&rec->data[i * 8]);
+        values[i].val2 = (int32_t)sys_get_le32(&rec->data[i * 8 + 4]);
+    }
+}
+
+#if defined(CONFIG_TRACE_CAPTURE)
+
+static uint8_t trace_buf[CONFIG_TRACE_BUFFER_SIZE];
+static size_t trace_len;
+static uint32_t last_record_ms;
+static bool full_logged;
+static struct k_spinlock trace_lock;
+
+static void header_write(void)
+{
+    memcpy(trace_buf, TRACE_MAGIC, 4);
+    trace_buf[4] = TRACE_VERSION;
+    sys_put_le16(sizeof(struct nrf_modem_gnss_pvt_data_frame), &trace_buf[5]);
+    trace_len = TRACE_HDR_LEN;
+}
+
+/* Reserve room for a record and write its type and timestamp, NULL if the buffer is full */
+static uint8_t *record_start(enum trace_type type)
+{
+    uint32_t now_ms = k_uptime_get_32();
+    uint32_t delta_ms = trace_len > TRACE_HDR_LEN ? now_ms - last_record_ms : 0;
+    size_t len = payload_len(type);
+
+    if (trace_len == 0)
+    {
+        header_write();
+    }
+
+    if (sizeof(trace_buf) - trace_len < 1 + VARINT_MAX_LEN + len)
+    {
+        if (!full_logged)
+        {
+            LOG_WRN("Trace buffer full, dropping records");
+            full_logged = true;
+        }
+        return NULL;
+    }
+
+    last_record_ms = now_ms;
+    trace_buf[trace_len++] = type;
+    do
+    {
+        trace_buf[trace_len++] = (delta_ms & 0x7f) | (delta_ms > 0x7f ? 0x80 : 0);
+        delta_ms >>= 7;
+    } while (delta_ms > 0);
+
+    trace_len += len;
+    return &trace_buf[trace_len - len];
+}
+
+void trace_record_pvt(const struct nrf_modem_gnss_pvt_data_frame *pvt)
+{
+    k_spinlock_key_t key = k_spin_lock(&trace_lock);
+    uint8_t *p = record_start(TRACE_PVT);
+
+    if (p != NULL)
+    {
+        memcpy(p, pvt, sizeof(*pvt));
+    }
+    k_spin_unlock(&trace_lock, key);
+}
+
+void trace_record_aqi(const struct sensor_value values[AQI_CHAN_COUNT])
+{
+    k_spinlock_key_t key = k_spin_lock(&trace_lock);
+    uint8_t *p = record_start(TRACE_AQI);
+
+    if (p != NULL)
+    {
+        for (int i = 0; i < AQI_CHAN_COUNT; i++)
+        {
+            sys_put_le32(values[i].val1, &p[i * 8]);
+            sys_put_le32(values[i].val2, &p[i * 8 + 4]);
+        }
+    }
+    k_spin_unlock(&trace_lock, key);
+}
+
+void trace_record_soc(uint8_t soc)
+{
+    k_spinlock_key_t key = k_spin_lock(&trace_lock);
+    uint8_t *p = record_start(TRACE_SOC);
+
+    if (p != NULL)
+    {
+        *p = soc;
+    }
+    k_spin_unlock(&trace_lock, key);
+}
+
+const uint8_t *trace_data_get(size_t *len)
+{
+    k_spinlock_key_t key = k_spin_lock(&trace_lock);
+
+    if (trace_len == 0)
+    {
+        header_write();
+    }
+    *len = trace_len;
+    k_spin_unlock(&trace_lock, key);
+    return trace_buf;
+}
+
+void trace_clear(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&trace_lock);
+
+    trace_len = 0;
+    full_logged = false;
+    k_spin_unlock(&trace_lock, key);
+}
+
+#endif /* CONFIG_TRACE_CAPTURE */
@@ -0,0 +1,83 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <nrf_modem_gnss.h>
+#include <zephyr/drivers/sensor.h>
+
+#include "../sensors/bme680.h"
+
+/* Binary trace of the raw inputs of the GNSS, sensor and fuel gauge paths, so they can be
+ * replayed off-target (see replay/).
+ *
+ * Header: "T91T", version:u8, sizeof(struct nrf_modem_gnss_pvt_data_frame):u16
+ * Record: type:u8, ms since the previous record:LEB128 varint, payload
+ *   TRACE_PVT  the raw frame, as laid out by the capturing target
+ *   TRACE_AQI  AQI_CHAN_COUNT * (val1:i32 val2:i32)
+ *   TRACE_SOC  percentage:u8
+ * Integers are little endian.
+ */
+
+#define TRACE_MAGIC "T91T"
+#define TRACE_VERSION 1
+#define TRACE_HDR_LEN 7
+
+enum trace_type
+{
+    TRACE_PVT = 1,
+    TRACE_AQI = 2,
+    TRACE_SOC = 3,
+};
+
+struct trace_record
+{
+    enum trace_type type;
+    uint32_t time_ms; // since the first record
+    const uint8_t *data;
+    size_t len;
+};
+
+struct trace_reader
+{
+    const uint8_t *buf;
+    size_t len;
+    size_t pos;
+    uint32_t time_ms;
+    bool started;
+};
+
+/**@brief Check the trace header and start reading after it.
+ * @return 0, -EINVAL if this is not a trace, -ENOTSUP if it was captured with
+ * another PVT frame layout than this build's.
+ */
+int trace_reader_init(struct trace_reader *r, const uint8_t *buf, size_t len);
+
+/**@brief Read the next record.
+ * @return 0, -ENODATA at the end of the trace, -EBADMSG if it is truncated or corrupt.
+ */
+int trace_read(struct trace_reader *r, struct trace_record *rec);
+
+/**@brief Decode a TRACE_AQI record.
+ */
+void trace_aqi_get(const struct trace_record *rec, struct sensor_value values[AQI_CHAN_COUNT]);
+
+/**@brief Append a record to the capture buffer. Safe from interrupt context (the
+ * GNSS event handler). Once the buffer is full, records are dropped.
+ * Only with CONFIG_TRACE_CAPTURE.
+ */
+void trace_record_pvt(const struct nrf_modem_gnss_pvt_data_frame *pvt);
+void trace_record_aqi(const struct sensor_value values[AQI_CHAN_COUNT]);
+void trace_record_soc(uint8_t soc);
+
+/**@brief The captured trace, header included.
+ */
+const uint8_t *trace_data_get(size_t *len);
+
+/**@brief Drop everything captured so far.
+ */
+void trace_clear(void);
+
+#endif /* _TRACE_H_ */
@@ -0,0 +1,249 @@
+#include <errno.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/util.h>
+
+#include "trip.h"
+#include "../geo/geo.h"
+
+LOG_MODULE_REGISTER(trip, LOG_LEVEL_INF);
+
+/* Shorter steps between fixes are position noise, not movement */
+#define TRIP_MIN_STEP_M 10
+/* Steps are summed in dm, whole metres would lose half a metre per step */
+#define MIN_STEP_DM2 ((int64_t)TRIP_MIN_STEP_M * 10 * TRIP_MIN_STEP_M * 10)
+
+#define STOP_MIN_MS ((int64_t)CONFIG_TRIP_STOP_MIN_S * MSEC_PER_SEC)
+#define END_MS ((int64_t)CONFIG_TRIP_END_S * MSEC_PER_SEC)
+
+BUILD_ASSERT(CONFIG_TRIP_STOP_MIN_S < CONFIG_TRIP_END_S, "A stop that ends the trip is never counted");
+
+#define TRIP_FIELD_SIZE(name, bytes, is_signed) bytes,
+static const uint8_t field_bytes[] = {TRIP_SUMMARY_FIELDS(TRIP_FIELD_SIZE)};
+#undef TRIP_FIELD_SIZE
+
+#define TRIP_FIELD_SIGNED(name, bytes, is_signed) is_signed,
+static const bool field_signed[] = {TRIP_SUMMARY_FIELDS(TRIP_FIELD_SIGNED)};
+#undef TRIP_FIELD_SIGNED
+
+/* Everything a trip needs, whatever its length */
+static struct
+{
+    bool has_fix;
+    bool active;
+    bool stopped;               // resting before a trip, or in a stop that may not count yet
+    struct trip_fix last;
+    struct trip_fix stop;       // where and when the stop began
+    int64_t stop_distance_dm;   // trip distance when the stop began
+    int32_t step_lat;           // where the distance was summed up to
+    int32_t step_lon;
+    int64_t start_ms;
+    int32_t start_lat;
+    int32_t start_lon;
+    int64_t distance_dm;
+    uint32_t max_speed_cms;
+    uint32_t stops;
+    int64_t stopped_ms;
+    int64_t longest_stop_ms;
+    uint32_t fixes;
+} trip;
+static struct k_spinlock trip_lock;
+
+/* The summary of the last trip, handed to the callback from the work queue */
+static struct trip_summary pending;
+static trip_summary_cb_t summary_cb;
+static void summary_work_fn(struct k_work *work);
+static K_WORK_DEFINE(summary_work, summary_work_fn);
+
+static uint32_t fix_distance_m(const struct trip_fix *a, const struct trip_fix *b)
+{
+    return geo_distance_m(a->lat, a->lon, b->lat, b->lon);
+}
+
+static void trip_start(const struct trip_fix *at)
+{
+    trip.active = true;
+    trip.start_ms = at->utc_ms;
+    trip.start_lat = at->lat;
+    trip.start_lon = at->lon;
+    trip.step_lat = at->lat;
+    trip.step_lon = at->lon;
+    trip.distance_dm = 0;
+    trip.max_speed_cms = 0;
+    trip.stops = 0;
+    trip.stopped_ms = 0;
+    trip.longest_stop_ms = 0;
+    trip.fixes = 1;
+}
+
+/* The trip ends where the current stop began */
+static void trip_end(struct trip_summary *summary)
+{
+    int64_t duration_ms = trip.stop.utc_ms - trip.start_ms;
+    int64_t moving_ms = duration_ms - trip.stopped_ms;
+    int64_t distance_m = trip.stop_distance_dm / 10;
+    int64_t *v = summary->values;
+
+    v[TRIP_FIELD_VERSION] = TRIP_SUMMARY_VERSION;
+    v[TRIP_FIELD_START_S] = trip.start_ms / MSEC_PER_SEC;
+    v[TRIP_FIELD_DURATION_S] = duration_ms / MSEC_PER_SEC;
+    v[TRIP_FIELD_DISTANCE_M] = distance_m;
+    v[TRIP_FIELD_MAX_SPEED_CMS] = trip.max_speed_cms;
+    v[TRIP_FIELD_AVG_SPEED_CMS] = moving_ms > 0 ? distance_m * 100 * MSEC_PER_SEC / moving_ms : 0;
+    v[TRIP_FIELD_STOPS] = trip.stops;
+    v[TRIP_FIELD_STOPPED_S] = trip.stopped_ms / MSEC_PER_SEC;
+    v[TRIP_FIELD_LONGEST_STOP_S] = trip.longest_stop_ms / MSEC_PER_SEC;
+    v[TRIP_FIELD_FIXES] = trip.fixes;
+    v[TRIP_FIELD_START_LAT] = trip.start_lat;
+    v[TRIP_FIELD_START_LON] = trip.start_lon;
+    v[TRIP_FIELD_END_LAT] = trip.stop.lat;
+    v[TRIP_FIELD_END_LON] = trip.stop.lon;
+
+    trip.active = false;
+}
+
+/* Call with trip_lock held. Returns true if the fix ended a trip. */
+static bool trip_update(const struct trip_fix *fix, struct trip_summary *summary)
+{
+    bool ended = false;
+    bool stop_began = false;
+
+    if (!trip.has_fix)
+    {
+        trip.has_fix = true;
+        trip.stopped = true;
+        trip.stop = *fix;
+        trip.last = *fix;
+        return false;
+    }
+    if (fix->utc_ms <= trip.last.utc_ms)
+    {
+        return false;
+    }
+
+    /* No fixes for a while and no movement in between: stopped since the last one */
+    if (!trip.stopped && fix->utc_ms - trip.last.utc_ms >= END_MS &&
+        fix_distance_m(&trip.last, fix) <= CONFIG_TRIP_STOP_RADIUS_M)
+    {
+        trip.stopped = true;
+        trip.stop = trip.last;
+        trip.stop_distance_dm = trip.distance_dm;
+    }
+
+    if (trip.stopped)
+    {
+        if (fix->speed_cms >= CONFIG_TRIP_MOVING_SPEED_CMS ||
+            fix_distance_m(&trip.stop, fix) > CONFIG_TRIP_STOP_RADIUS_M)
+        {
+            if (!trip.active)
+            {
+                trip_start(&trip.last);
+            }
+            else
+            {
+                int64_t dwell_ms = trip.last.utc_ms - trip.stop.utc_ms;
+
+                if (dwell_ms >= STOP_MIN_MS)
+                {
+                    trip.stops++;
+                    trip.stopped_ms += dwell_ms;
+                    trip.longest_stop_ms = MAX(trip.longest_stop_ms, dwell_ms);
+                }
+            }
+            trip.stopped = false;
+        }
+        else if (trip.active && fix->utc_ms - trip.stop.utc_ms >= END_MS)
+        {
+            trip_end(summary);
+            /* Moving back and forth within a stop, e.g. on a speed glitch */
+            ended = summary->values[TRIP_FIELD_DISTANCE_M] > CONFIG_TRIP_STOP_RADIUS_M;
+        }
+    }
+    else if (fix->speed_cms < CONFIG_TRIP_MOVING_SPEED_CMS)
+    {
+        trip.stopped = true;
+        trip.stop = *fix;
+        stop_began = true;
+    }
+
+    if (trip.active)
+    {
+        int64_t step_dm2 = geo_distance_sq_dm2(trip.step_lat, trip.step_lon, fix->lat, fix->lon);
+
+        if (step_dm2 >= MIN_STEP_DM2)
+        {
+            trip.distance_dm += geo_isqrt64(step_dm2);
+            trip.step_lat = fix->lat;
+            trip.step_lon = fix->lon;
+        }
+        trip.max_speed_cms = MAX(trip.max_speed_cms, fix->speed_cms);
+        trip.fixes++;
+    }
+    if (stop_began)
+    {
+        trip.stop_distance_dm = trip.distance_dm;
+    }
+    trip.last = *fix;
+    return ended;
+}
+
+static void summary_work_fn(struct k_work *work)
+{
+    struct trip_summary summary;
+    k_spinlock_key_t key = k_spin_lock(&trip_lock);
+
+    summary = pending;
+    k_spin_unlock(&trip_lock, key);
+
+    LOG_INF("Trip ended: %u m in %u s, %u stops, max %u cm/s",
+            (uint32_t)summary.values[TRIP_FIELD_DISTANCE_M], (uint32_t)summary.values[TRIP_FIELD_DURATION_S],
+            (uint32_t)summary.values[TRIP_FIELD_STOPS], (uint32_t)summary.values[TRIP_FIELD_MAX_SPEED_CMS]);
+    if (summary_cb != NULL)
+    {
+        summary_cb(&summary);
+    }
+}
+
+void trip_init(trip_summary_cb_t cb)
+{
+    summary_cb = cb;
+}
+
+void trip_fix_update(const struct trip_fix *fix)
+{
+    k_spinlock_key_t key = k_spin_lock(&trip_lock);
+    bool ended = trip_update(fix, &pending);
+
+    k_spin_unlock(&trip_lock, key);
+
+    if (ended)
+    {
+        k_work_submit(&summary_work);
+    }
+}
+
+int trip_summary_encode(const struct trip_summary *summary, uint8_t *buf, size_t size)
+{
+    size_t pos = 0;
+
+    if (size < TRIP_SUMMARY_LEN)
+    {
+        return -ENOMEM;
+    }
+
+    for (int i = 0; i < TRIP_FIELD_COUNT; i++)
+    {
+        int64_t value = summary->values[i];
+
+        /* Unsigned fields saturate instead of wrapping */
+        if (!field_signed[i])
+        {
+            value = CLAMP(value, 0, (int64_t)BIT64(8 * field_bytes[i]) - 1);
+        }
+        for (uint8_t b = 0; b < field_bytes[i]; b++)
+        {
+            buf[pos++] = (uint8_t)((uint64_t)value >> (8 * b));
+        }
+    }
+    return TRIP_SUMMARY_LEN;
+}
@@ -0,0 +1,54 @@
+#ifndef _TRIP_H_
+#define _TRIP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Trips built on the device from every valid fix, so the backend gets exact distance,
+ * speed and stops instead of reconstructing them from sparse reports. Each fix updates
+ * a constant-size state:
+ *   - a trip starts once a fix is faster than CONFIG_TRIP_MOVING_SPEED_CMS or further
+ *     than CONFIG_TRIP_STOP_RADIUS_M from where the device was resting;
+ *   - distance is summed between fixes, ignoring steps under TRIP_MIN_STEP_M (jitter);
+ *   - a stop starts with a slow fix and lasts while fixes stay slow and within
+ *     CONFIG_TRIP_STOP_RADIUS_M of it; it counts once it lasted CONFIG_TRIP_STOP_MIN_S;
+ *   - a stop of CONFIG_TRIP_END_S ends the trip at the start of that stop. A gap
+ *     without fixes counts as a stop if the device did not move during it.
+ * The summary (layout in trip_schema.h) is passed to the callback at trip end.
+ */
+
+#include "trip_schema.h"
+
+/* One fix, fixed point */
+struct trip_fix
+{
+    int64_t utc_ms;
+    int32_t lat;         // micro-degrees
+    int32_t lon;
+    uint32_t speed_cms;  // horizontal speed
+};
+
+/* Values indexed by enum trip_field */
+struct trip_summary
+{
+    int64_t values[TRIP_FIELD_COUNT];
+};
+
+/**@brief Called from the system work queue when a trip ends.
+ */
+typedef void (*trip_summary_cb_t)(const struct trip_summary *summary);
+
+/**@brief Set the callback, before the first fix.
+ */
+void trip_init(trip_summary_cb_t cb);
+
+/**@brief Account a valid fix. Safe from the GNSS event handler.
+ */
+void trip_fix_update(const struct trip_fix *fix);
+
+/**@brief Write the summary record.
+ * @return TRIP_SUMMARY_LEN, or -ENOMEM if size is smaller.
+ */
+int trip_summary_encode(const struct trip_summary *summary, uint8_t *buf, size_t size);
+
+#endif /* _TRIP_H_ */
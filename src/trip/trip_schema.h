@@ -0,0 +1,39 @@
+#ifndef _TRIP_SCHEMA_H_
+#define _TRIP_SCHEMA_H_
+
+/* Layout of the trip summary record (see trip.h), shared by the device encoder
+ * (trip.c) and anything decoding it. No dependencies so it can be included from
+ * host code too.
+ *
+ * Fields are little endian, in this order, X(name, bytes, is_signed):
+ */
+#define TRIP_SUMMARY_FIELDS(X) \
+    X(VERSION, 1, 0)        /* TRIP_SUMMARY_VERSION */ \
+    X(START_S, 4, 0)        /* UTC in s since 1970 */ \
+    X(DURATION_S, 4, 0)     /* start to the beginning of the stop that ended the trip */ \
+    X(DISTANCE_M, 4, 0)     /* summed between fixes */ \
+    X(MAX_SPEED_CMS, 2, 0)  /* highest speed the receiver reported, cm/s */ \
+    X(AVG_SPEED_CMS, 2, 0)  /* distance over the time not spent in stops, cm/s */ \
+    X(STOPS, 2, 0)          /* stops of at least CONFIG_TRIP_STOP_MIN_S */ \
+    X(STOPPED_S, 4, 0)      /* dwell time of all stops */ \
+    X(LONGEST_STOP_S, 4, 0) \
+    X(FIXES, 2, 0)          /* fixes the summary was built from, saturates */ \
+    X(START_LAT, 4, 1)      /* micro-degrees */ \
+    X(START_LON, 4, 1) \
+    X(END_LAT, 4, 1) \
+    X(END_LON, 4, 1)
+
+#define TRIP_FIELD_ENUM(name, bytes, is_signed) TRIP_FIELD_##name,
+enum trip_field
+{
+    TRIP_SUMMARY_FIELDS(TRIP_FIELD_ENUM)
+    TRIP_FIELD_COUNT
+};
+#undef TRIP_FIELD_ENUM
+
+#define TRIP_FIELD_BYTES(name, bytes, is_signed) (bytes) +
+#define TRIP_SUMMARY_LEN (TRIP_SUMMARY_FIELDS(TRIP_FIELD_BYTES) 0)
+
+#define TRIP_SUMMARY_VERSION 1
+
+#endif /* _TRIP_SCHEMA_H_ */